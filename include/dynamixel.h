@@ -50,6 +50,14 @@ int dxl_get_highbyte(int word);
 
 
 ////////// packet communication methods ///////////////////////
+// dxl_tx_packet() only starts the transfer and returns immediately,
+// dxl_rx_packet() never blocks and leaves COMM_RXWAITING as result
+// as long as the packet is in flight.
+// The blocking methods (dxl_txrx_packet(), dxl_packet_txrx(), dxl_lock()
+// and the high communication methods) wait for the bus interrupts. With
+// interrupts disabled, e.g. in an interrupt handler, they poll the UART
+// and the timeout timer instead, so a transaction takes as long as with
+// interrupts but other interrupts are delayed for that time.
 void dxl_tx_packet(void);
 void dxl_rx_packet(void);
 void dxl_txrx_packet(void);
@@ -64,6 +72,109 @@ int dxl_get_result(void);
 #define COMM_RXTIMEOUT		(6)
 #define COMM_RXCORRUPT		(7)
 
+// Called in interrupt context whenever a transaction has ended.
+typedef void (*dxl_complete_callback)(void);
+void dxl_set_complete_callback(dxl_complete_callback callback);
+
+
+// Status return level of a device (control table address 16). The
+// driver only waits for the status packets the device actually sends.
+// PING and READ are always answered.
+void dxl_set_status_return_level(int id, int level);
+int dxl_get_status_return_level(int id);
+#define STATUS_RETURN_NONE	(0)
+#define STATUS_RETURN_READ	(1)
+#define STATUS_RETURN_ALL	(2)
+
+
+//////////// timeout methods //////////////////////////////////
+// Time a device may take from the end of the instruction packet to
+// the start of its status packet. The value only applies to the next
+// transaction, afterwards DXL_RETURN_TIMEOUT_US applies again, so it
+// is set while holding the bus.
+#define DXL_RETURN_TIMEOUT_US	(1000)
+void dxl_set_return_timeout(unsigned int timeout_us);
+// Time in us from the end of the instruction packet to the first byte
+// of the status packet of the last transaction, 0 if none arrived.
+unsigned int dxl_get_return_time(void);
+
+
+//////////// error accounting methods ///////////////////////
+// Every failed transaction and every error bit of a status packet
+// is counted per device when the transaction ends. The counters wrap
+// around, so consumers report the difference to an earlier snapshot.
+// The first DXL_ERROR_DEVICES-1 devices with errors get their own
+// counters, the errors of all further devices are collected in the
+// last entry with the id BROADCAST_ID.
+#define DXL_ERROR_DEVICES		(8)
+// Error classes, the error bits of the status packet come first
+// (ERRBIT_x == 1 << DXL_ERROR_x).
+#define DXL_ERROR_VOLTAGE		(0)
+#define DXL_ERROR_ANGLE			(1)
+#define DXL_ERROR_OVERHEAT		(2)
+#define DXL_ERROR_RANGE			(3)
+#define DXL_ERROR_CHECKSUM		(4)
+#define DXL_ERROR_OVERLOAD		(5)
+#define DXL_ERROR_INSTRUCTION	(6)
+#define DXL_ERROR_TXFAIL		(7)
+#define DXL_ERROR_TXERROR		(8)
+#define DXL_ERROR_RXTIMEOUT		(9)
+#define DXL_ERROR_RXCORRUPT		(10)
+#define DXL_ERROR_CLASSES		(11)
+
+typedef struct {
+	unsigned char id;
+	unsigned short count[DXL_ERROR_CLASSES];
+} dxl_error_counts;
+
+// Copies the counters of entry index in [0;DXL_ERROR_DEVICES),
+// returns 0 if no errors have been counted in this entry yet.
+int dxl_get_error_counts(int index, dxl_error_counts *counts);
+void dxl_reset_error_counts(void);
+
+
+//////////// packet builder methods ///////////////////////////
+// Builds the instruction packet in place: the parameters are written
+// through a cursor and the checksum is summed up on the way. The caller
+// holds the bus (dxl_lock()) and writes at most MAXNUM_TXPARAM parameters.
+typedef struct {
+	unsigned char *cursor;
+	unsigned char checksum;
+} dxl_packet;
+
+void dxl_packet_begin(dxl_packet *packet, int id, int instruction);
+
+static inline void dxl_packet_put(dxl_packet *packet, unsigned char value)
+{
+	// The byte is stored first, so the compiler may keep cursor and
+	// checksum in registers although the byte store aliases them
+	unsigned char *cursor = packet->cursor;
+	unsigned char checksum = packet->checksum;
+	*cursor = value;
+	packet->cursor = cursor + 1;
+	packet->checksum = checksum + value;
+}
+
+static inline void dxl_packet_put_word(dxl_packet *packet, unsigned short value)
+{
+	dxl_packet_put(packet, (unsigned char)(value & 0xFF));
+	dxl_packet_put(packet, (unsigned char)(value >> 8));
+}
+
+void dxl_packet_tx(dxl_packet *packet);
+void dxl_packet_txrx(dxl_packet *packet);
+
+
+//////////// bus arbitration methods //////////////////////////
+// The main program holds the bus with dxl_lock() (may be nested) from
+// building a packet until its result has been read. Interrupt handlers
+// only use dxl_isr_try_lock(), which fails while the main program holds
+// or waits for the bus.
+void dxl_lock(void);
+void dxl_unlock(void);
+int dxl_isr_try_lock(void);
+void dxl_isr_unlock(void);
+
 
 //////////// high communication methods ///////////////////////
 void dxl_ping(int id);
@@ -44,6 +44,15 @@
 ///Symbolic definition for right motor id
 #define MOTOR_RIGHT 12
 
+///Diameter of the wheels in mm, used by the odometry
+#define WHEEL_DIAMETER_MM	52
+///Distance between the wheels in mm, used by the odometry
+#define WHEEL_TRACK_MM		120
+///Time between two odometry samples in ms, also the period of the wheel speed controller
+#define ODOMETRY_PERIOD_MS	20
+///Wheel speed in um/s per speed unit
+#define WHEEL_SPEED_UNIT_UM_S	((int32_t)(MOTOR_RPM_PER_SPEED_UNIT * 3.14159265 * WHEEL_DIAMETER_MM / 60.0 * 1000.0 + 0.5))
+
 ///Maximum allowed speed in percentage. Used for adaptive speed calculation.
 #define MAX_SPEED_IN_PERCENTAGE 100ul
 ///Minimum allowed speed in percentage. Used for adaptive speed calculation.
@@ -80,6 +89,7 @@ void set_state(int new_state);
 - Set interrupt callback function fr start button
 - Activate interrupts globally
 - Set the motors to wheel mode
+- Start the odometry (see #motor_odometry_get) and the closed-loop differential drive (see #motor_drive_set)
 - Set serial communication through zigbee.
 */
 void firmware_init(void);
@@ -123,6 +133,16 @@ void firmware_init(){
 	// Set motors to wheel mode
 	motor_set_mode(254, MOTOR_WHEEL_MODE);
 	
+	// Answer only reads, so speed updates do not wait for a status packet
+	motor_set_status_return_level(MOTOR_LEFT, STATUS_RETURN_READ);
+	motor_set_status_return_level(MOTOR_RIGHT, STATUS_RETURN_READ);
+	
+	// Integrate the pose from the wheel speeds in the background
+	motor_init();
+	motor_odometry_start(MOTOR_LEFT, MOTOR_RIGHT, WHEEL_DIAMETER_MM, WHEEL_TRACK_MM, ODOMETRY_PERIOD_MS);
+	// The wheel speeds are controlled and written in the background as well
+	motor_drive_start(MOTOR_DRIVE_KP, MOTOR_DRIVE_KI);
+	
 	// Set serial communication through ZigBee
 	serial_set_zigbee();
 	
@@ -136,8 +156,8 @@ void controller_run(void) {
 	//Speeds to be managed by the control logic, without taking into account speed adaption
 	int speed_left = 0, speed_right = 0;
 	
-	//Speeds applied to the motors after adaptive speed calculation
-	uint16_t speed_l, speed_r;
+	//Speeds applied to the motors after adaptive speed calculation, positive values drive forward
+	int16_t speed_l, speed_r;
 	
 	//Speed offset, to make sure initially heading slightly to the right and finally slightly to the left
 	int offset = 10;
@@ -252,12 +272,16 @@ void controller_run(void) {
 		speed = MIN_SPEED_IN_PERCENTAGE;
 		
 		//Calculate motors speed
-		speed_l = (uint16_t) ((speed_left<<2) * (uint32_t)speed / 100ul);
-		speed_r = (uint16_t) ((speed_right<<2) * (uint32_t)speed / 100ul);
+		speed_l = (int16_t) ((speed_left<<2) * (uint32_t)speed / 100ul);
+		speed_r = (int16_t) ((speed_right<<2) * (uint32_t)speed / 100ul);
+		if (direction_left == MOTOR_CW)		//the left wheel drives forward counterclockwise
+			speed_l = -speed_l;
+		if (direction_right == MOTOR_CCW)	//the right wheel drives forward clockwise
+			speed_r = -speed_r;
 		
-		//Apply motors speed and direction
-		motor_set_speed_dir(MOTOR_LEFT, speed_l, direction_left);
-		motor_set_speed_dir(MOTOR_RIGHT, speed_r, direction_right);
+		//Apply forward speed (mm/s) and rotation (mrad/s), the wheels are updated by the differential drive
+		motor_drive_set((int16_t)((speed_l + speed_r) * WHEEL_SPEED_UNIT_UM_S / 2000),
+			(int16_t)((speed_r - speed_l) * WHEEL_SPEED_UNIT_UM_S / WHEEL_TRACK_MM));
 
 	}//close main loop
 }//close main function
@@ -265,8 +289,10 @@ void controller_run(void) {
 
 */
 void reset_state() {
-	if (BTN_START_PRESSED)
+	if (BTN_START_PRESSED) {
 		state = 0;
+		motor_odometry_reset();		//the pose is measured from the start position
+	}
 }
 
 
@@ -29,13 +29,16 @@
 	a simple harmonic oscillator with an #amplitude, #frequency, #phase shift and #offset. As the
 	sinusoidal motor position signals differs depending on the movement direction and the motor position,
 	the former arrays contain the values with respect to both of them. Given the former information the
-	motor position can be updated with a new position. This is done in the function #update_motor_position.
-	In order to limit the traffic on the motor bus the position is only updated every certain time interval
-	(#CONF_MOTOR_UPDATE_POSITION_INTERVAL).
+	motor positions are sampled as keyframes every #CONF_MOTOR_KEYFRAME_INTERVAL in the function #update_motor_position.
+	The trajectory streamer of the motor library interpolates between the keyframes and sends the positions to the
+	motors from its timer interrupt every #CONF_MOTOR_UPDATE_POSITION_INTERVAL, thus the timing of the control loop
+	does not affect the movement. The control loop only keeps the keyframe buffers filled.
 	
 	In order to set the right position at the right time the timing has to be precise. Thus the 8-bit timer 0
 	is used to generate an interrupt at 1 kHz frequency. In that interrupt #timer0_compare_match the global variable
-	#global_elapsed_time is incremented. This variable now provides a timestamp in milliseconds precision.
+	#global_elapsed_time is incremented. This variable now provides a timestamp in milliseconds precision. The same
+	interrupt samples the state of the robot for the binary telemetry stream (see #telemetry_sample), which the main loop
+	sends over the serial connection.
 	
 	The main application logic is provided in the #main method. At the beginning several firmware functions are called
 	to initialize motors, sensors, serial connection, timer and I/O. Then the motors are positioned in a defined center
@@ -46,16 +49,16 @@
 	the noise induced by movement. In a third step it is checked whether the autonomous mode is activated and the
 	movement direction is calculated from the sensor inputs in case (#execute_autonomous_movement). Then it is checked
 	whether the movement direction has changed since the last time. If this is the case the robot moves its motors to the
-	center position and atomically update the global movement direction. Also a flag is set to make sure that the motor
-	positions get updated immediately despite the former mentioned interval. Finally the motor positions are updated
-	as former described.
+	center position and atomically update the global movement direction. Then the trajectory streamer is restarted and
+	the keyframes are generated as former described.
 	
-	In remote-controlled mode the movement direction is set with commands over the serial communication line. The callback
-	function #serial_receive_data is called whenever a new character is received. Depending on the command it sets the
-	global movement release, the global movement direction or a few other parameters. See the description of the callback
-	function for more information. For safety reasons another way to set the movement release is by pressing the start
-	button on the controller. Pressing it executes another callback	function #btn_press_start in order to set or remove
-	the release.
+	In remote-controlled mode the movement direction is set over the serial communication line with the binary protocol
+	of frame.h, e.g. with the tool tools/frame_tool.c. The received requests are executed at the beginning of each
+	control loop cycle. They read or write values by their ids (CONF_VALUE_*), e.g. the global movement release, the
+	global movement direction, the motor positions or the sensor values. See the description of the handler functions
+	#remote_get_value and #remote_set_value for more information. For safety reasons another way to set the movement
+	release is by pressing the start button on the controller. Pressing it executes another callback function
+	#btn_press_start in order to set or remove the release.
 	
 	In non-autonomous mode the movement direction is set depending on the sensor inputs and a simple logic. By default the
 	robot moves forward. In case it comes close to an obstacle in front it changes its movement direction to the right until
@@ -69,23 +72,58 @@
 	<a name="main_logic"><img src="2_nonwheel_overall.png" width="652" height="1275" alt="Overview of Squid's application logic"></a>
 	
 */
-#include <stdio.h>
 #include <math.h>
 #include <util/atomic.h>
+#include <avr/pgmspace.h>
 
 #include "../macro.h"
 #include "../sensor.h"
 #include "../motor.h"
 #include <dynamixel.h>
 #include "../serial.h"
+#include "../frame.h"
+#include "../telemetry.h"
+#include "../log.h"
 #include "../serialzigbee.h"
 #include "../io.h"
 #include "../timer.h"
 
 /// Number of motors.
 #define CONF_NUMBER_OF_MOTORS				6
-/// Delay between motor position updates in order to reduce motor bus traffic.
+/// Delay between motor position updates sent by the trajectory streamer in ms.
 #define CONF_MOTOR_UPDATE_POSITION_INTERVAL	20
+/// Time between two keyframes of the motor position signal in ms.
+#define CONF_MOTOR_KEYFRAME_INTERVAL			50
+/// Duration in ms of the movement to the center position, 0 for the fastest movement in which all motors arrive together.
+#define CONF_MOTOR_CENTER_DURATION			0
+/// Minimum time in ms between two reports of motor errors on the serial interface.
+#define CONF_ERROR_REPORT_INTERVAL			1000
+/// Time in ms between two load samples of the legs.
+#define CONF_LEG_LOAD_INTERVAL				20
+/// Load of a leg above which the robot stops to protect the motors.
+#define CONF_LEG_STALL_LOAD					800
+/// Rise of the load of a leg above its recent level which is taken as a collision.
+#define CONF_LEG_COLLISION_RISE				300
+
+/// Value id of the movement release, see #remote_set_value.
+#define CONF_VALUE_RELEASE					0
+/// Value id of the movement direction, see #remote_set_value.
+#define CONF_VALUE_MOVEMENT					1
+/// Value id of the autonomous mode release, see #remote_set_value.
+#define CONF_VALUE_AUTONOMOUS				2
+/// Value id of the ZigBee connection release, see #remote_set_value.
+#define CONF_VALUE_ZIGBEE					3
+/// Value id of the position of the first motor, the other motors follow (read-only, see #remote_get_value).
+#define CONF_VALUE_POSITION					10
+/// Value id of the front sensor (read-only, see #remote_get_value).
+#define CONF_VALUE_SENSOR_FRONT				20
+/// Value id of the left sensor (read-only, see #remote_get_value).
+#define CONF_VALUE_SENSOR_LEFT				21
+/// Value id of the right sensor (read-only, see #remote_get_value).
+#define CONF_VALUE_SENSOR_RIGHT				22
+
+/// Time between two records of the telemetry stream in ms, see #telemetry_sample.
+#define CONF_TELEMETRY_PERIOD				50
 
 /// Number of different possible movement directions.
 #define CONF_NUMBER_OF_MOVEMENTS				4
@@ -147,6 +185,12 @@ static volatile uint8_t global_use_zigbee = 0;
 static volatile uint32_t global_elapsed_time = 0;
 /// Global movement direction.
 static volatile uint8_t global_movement_type = CONF_MOVEMENT_FORWARD;
+/// Index of the last leg which has been blocked, 0xFF if none.
+static volatile uint8_t global_blocked_leg = 0xFF;
+/// Averages of the front, left and right sensor for the telemetry stream, updated once per control loop cycle.
+static volatile uint16_t global_sensor_avg[3] = {0, 0, 0};
+/// Setpoints of the motors for the telemetry stream, 0xFFFF if not streamed.
+static volatile uint16_t global_setpoints[CONF_NUMBER_OF_MOTORS];
 		
 /// Array of IDs of the motors to control.
 static const uint8_t ids[CONF_NUMBER_OF_MOTORS] = {6, 1, 3, 8, 2, 5};
@@ -157,7 +201,7 @@ static const uint8_t ids[CONF_NUMBER_OF_MOTORS] = {6, 1, 3, 8, 2, 5};
 	The motor position signal is a sinusoidal signal of the type
 	\f$ position(t) = A * cos(2 \pi f t +  \theta) + off \f$.
  */
-static const uint16_t amplitude[CONF_NUMBER_OF_MOVEMENTS][CONF_NUMBER_OF_MOTORS] =
+static const uint16_t amplitude[CONF_NUMBER_OF_MOVEMENTS][CONF_NUMBER_OF_MOTORS] PROGMEM =
   {
     {120 / 2,       44 / 2,        512/2 - 20,    512/2 - 20,    44 / 2,        120 / 2},
     {120 / 2,       44 / 2,        512/2 - 20,    512/2 - 20,    44 / 2,        120 / 2},
@@ -171,7 +215,7 @@ static const uint16_t amplitude[CONF_NUMBER_OF_MOVEMENTS][CONF_NUMBER_OF_MOTORS]
 	The motor position signal is a sinusoidal signal of the type
 	\f$ position(t) = A * cos(2 \pi f t +  \theta) + off \f$.
  */
-static const const float frequency[CONF_NUMBER_OF_MOVEMENTS][CONF_NUMBER_OF_MOTORS] =
+static const float frequency[CONF_NUMBER_OF_MOVEMENTS][CONF_NUMBER_OF_MOTORS] PROGMEM =
   { 
     {1,   1,   1,   1,   1,   1},
     {1,   1,   1,   1,   1,   1},
@@ -185,7 +229,7 @@ static const const float frequency[CONF_NUMBER_OF_MOVEMENTS][CONF_NUMBER_OF_MOTO
 	The motor position signal is a sinusoidal signal of the type
 	\f$ position(t) = A * cos(2 \pi f t +  \theta) + off \f$.
  */
-static const const float phase[CONF_NUMBER_OF_MOVEMENTS][CONF_NUMBER_OF_MOTORS] =
+static const float phase[CONF_NUMBER_OF_MOVEMENTS][CONF_NUMBER_OF_MOTORS] PROGMEM =
   {
     {M_PI/3,   M_PI/3,   0,        M_PI,     M_PI/3,   M_PI/3},
     {M_PI/3,   M_PI/3,   M_PI,     0,        M_PI/3,   M_PI/3},
@@ -199,7 +243,7 @@ static const const float phase[CONF_NUMBER_OF_MOVEMENTS][CONF_NUMBER_OF_MOTORS]
 	The motor position signal is a sinusoidal signal of the type
 	\f$ position(t) = A * cos(2 \pi f t +  \theta) + off \f$.
  */														
-const uint16_t offset[CONF_NUMBER_OF_MOVEMENTS][CONF_NUMBER_OF_MOTORS] = 
+const uint16_t offset[CONF_NUMBER_OF_MOVEMENTS][CONF_NUMBER_OF_MOTORS] PROGMEM = 
   {
     {630,               556 + 50 - 70,     512/2+20,          512/2+20,          556 + 50 - 70,     630},
     {630,               556 + 50 - 70,     512/2+20,          512/2+20,          556 + 50 - 70,     630 },
@@ -207,137 +251,106 @@ const uint16_t offset[CONF_NUMBER_OF_MOVEMENTS][CONF_NUMBER_OF_MOTORS] =
     {(995-540)/2+540,   (512-480)/2+480,   (512-350)/2+350,   (512-350)/2+350,   (512-480)/2+480,   (995-540)/2+540}
   };
 
-/** Callback function for receiving serial data.
-	\details This callback function is used to react on external commands sent over the serial communication line. It is executed
-	whenever a character has been received. The transfered character is read by the _serial_read()_ function and interpreted.
-	A reception of a character is indicated by flashing the #LED_RXD LED.
-	
-	The following commands are currently implemented
-    - 'p': Debug command to print current motor positions.
-    - 'o': Debug command to print current sensor values.
-    - 'w': Change movement direction to forward (set #global_release and #global_movement_type = #CONF_MOVEMENT_FORWARD).
-    - 's': Change movement direction to backward (set #global_release and #global_movement_type = #CONF_MOVEMENT_BACKWARD).
-    - 'a': Change movement direction to left (set #global_release and #global_movement_type = #CONF_MOVEMENT_LEFT).
-    - 'd': Change movement direction to right (set #global_release and #global_movement_type = #CONF_MOVEMENT_RIGHT).
-    - 'q': Stop or start movement (toggling #global_release).
-    - 'z': Change between Zigbee and wired serial connection (toggling #global_use_zigbee).
-    - 'r': Change between autonomous or remote-controlled mode (toggling #global_release_autonomous).
+/** Handler function to read a value over the serial connection.
+	\details This handler function is called by _frame_poll()_ in the main loop for each value of a
+	_FRAME_COMMAND_GET_ request (see frame.h). The following values can be read:
+	- #CONF_VALUE_RELEASE, #CONF_VALUE_MOVEMENT, #CONF_VALUE_AUTONOMOUS and #CONF_VALUE_ZIGBEE (see #remote_set_value).
+	- #CONF_VALUE_POSITION + _i_: Present position of the motor _ids[i]_, -1 if it could not be read.
+	- #CONF_VALUE_SENSOR_FRONT, #CONF_VALUE_SENSOR_LEFT, #CONF_VALUE_SENSOR_RIGHT: Present value of the front, left
+	and right sensor.
+	\param[in]	id		Id of the value.
+	\param[out]	value	The value.
+	\returns _FRAME_STATUS_OK_ in case of success, _FRAME_STATUS_UNKNOWN_ if there is no such value.
  */
-void serial_receive_data(void){
-	// Toggle receive LED
-	LED_TOGGLE(LED_RXD);
-	// Receive data
-	unsigned char data = 0;
-	serial_read(&data, 1);
-	
-	switch (data)
+uint8_t remote_get_value(const uint8_t id, int16_t * value)
+{
+	uint16_t position = 0;
+	switch (id)
 	{
-		// Output motor positions
-		case 'p':
-		{
-			// Stop robot
-			global_release = 0;
-			// Print positions of all motors for debugging
-			printf("\nPositions of motors:\n");
-			for (uint16_t i=0; i<CONF_NUMBER_OF_MOTORS; i++) {
-				uint16_t v = motor_get_position(ids[i]);
-				printf("Motor %d position is %u\n", ids[i], v);
-			}
+		case CONF_VALUE_RELEASE:
+			*value = global_release;
 			break;
-		}
-		
-		// Output sensor positions
-		case 'o':
-		{
-			// Stop robot
-			global_release = 0;
-			// Print values of all sensors for debugging
-			uint16_t dist_front = sensor_read(CONF_SENSOR_FRONT, SENSOR_DISTANCE);
-			uint16_t dist_left = sensor_read(CONF_SENSOR_LEFT, SENSOR_IR);
-			uint16_t dist_right = sensor_read(CONF_SENSOR_RIGHT, SENSOR_IR);
-			printf("Sensors: Front: %3u, Left: %3u, Right: %3u.\n", dist_front, dist_left, dist_right);
+		case CONF_VALUE_MOVEMENT:
+			*value = global_movement_type;
 			break;
-		}
-		
-		// Forward
-		case 'w':
-		{
-			// Start robot and move forwards
-			global_release = 1;
-			global_movement_type = CONF_MOVEMENT_FORWARD;
-			printf("Going forward.\n");
+		case CONF_VALUE_AUTONOMOUS:
+			*value = global_release_autonomous;
 			break;
-		}
-		
-		// Backward
-		case 's':
-		{
-			// Start robot and move backwards
-			global_release = 1;
-			global_movement_type = CONF_MOVEMENT_BACKWARD;
-			printf("Going backward.\n");
+		case CONF_VALUE_ZIGBEE:
+			*value = global_use_zigbee;
 			break;
-		}
-		
-		// Left
-		case 'a':
-		{
-			// Start robot and move to the left side
-			global_release = 1;
-			global_movement_type = CONF_MOVEMENT_LEFT;
-			printf("Going left.\n");
+		case CONF_VALUE_SENSOR_FRONT:
+			*value = sensor_read(CONF_SENSOR_FRONT, SENSOR_DISTANCE);
 			break;
-		}
-		
-		// Right
-		case 'd':
-		{
-			// Start robot and move to the right side
-			global_release = 1;
-			global_movement_type = CONF_MOVEMENT_RIGHT;
-			printf("Going right.\n");			
+		case CONF_VALUE_SENSOR_LEFT:
+			*value = sensor_read(CONF_SENSOR_LEFT, SENSOR_IR);
 			break;
-		}
-	
-		// Start or stop
-		case 'q':
-		{
-			// Start or stop robot
-			global_release ^= 1;
+		case CONF_VALUE_SENSOR_RIGHT:
+			*value = sensor_read(CONF_SENSOR_RIGHT, SENSOR_IR);
 			break;
-		}
-		
-		// Enable ZigBee
-		case 'z':
-		{
-			global_use_zigbee ^= 1;
-			if (global_use_zigbee)
-			{
-				// Enable ZigBee connection
-				serial_set_zigbee();
-				printf("Using ZigBee connection.\n");
-			}
+		default:
+			if (id < CONF_VALUE_POSITION || id >= CONF_VALUE_POSITION + CONF_NUMBER_OF_MOTORS)
+				return FRAME_STATUS_UNKNOWN;
+			if (motor_read_word(ids[id - CONF_VALUE_POSITION], PRESENT_POSITION_L, &position) == COMM_RXSUCCESS)
+				*value = position;
 			else
-			{
-				// Enable wired connection
-				serial_set_wire();
-				printf("Using wired connection.\n");
-			}
+				*value = -1;
 			break;
-		}
-		
-		// Enable/disable autonomous control
-		case 'r':
-		{
-			// Enable or disable autonomous control mode
-			global_release_autonomous ^= 1;
-			if (global_release_autonomous)
-				printf("Autonomous control mode activated.\n");
-			else
-				printf("Autonomous control mode deactivated.\n");
+	}
+	return FRAME_STATUS_OK;
+}
+
+/** Handler function to write a value over the serial connection.
+	\details This handler function is called by _frame_poll()_ in the main loop for each value of a
+	_FRAME_COMMAND_SET_ request (see frame.h). Several values are written with one request, e.g. the movement direction
+	and the movement release to start walking. The following values can be written:
+	- #CONF_VALUE_RELEASE: Start (1) or stop (0) the movement (#global_release).
+	- #CONF_VALUE_MOVEMENT: Movement direction, one of #CONF_MOVEMENT_FORWARD, #CONF_MOVEMENT_BACKWARD,
+	#CONF_MOVEMENT_RIGHT or #CONF_MOVEMENT_LEFT (#global_movement_type).
+	- #CONF_VALUE_AUTONOMOUS: Autonomous (1) or remote-controlled (0) mode (#global_release_autonomous).
+	- #CONF_VALUE_ZIGBEE: ZigBee (1) or wired (0) serial connection (#global_use_zigbee). The reply is already sent
+	over the new connection.
+	\param[in]	id		Id of the value.
+	\param[in]	value	The new value.
+	\returns _FRAME_STATUS_OK_ in case of success, _FRAME_STATUS_RANGE_ if the value is invalid,
+	_FRAME_STATUS_READ_ONLY_ or _FRAME_STATUS_UNKNOWN_ if the value can not be written.
+ */
+uint8_t remote_set_value(const uint8_t id, const int16_t value)
+{
+	// Motor positions and sensor values
+	if ((id >= CONF_VALUE_POSITION && id < CONF_VALUE_POSITION + CONF_NUMBER_OF_MOTORS)
+		|| (id >= CONF_VALUE_SENSOR_FRONT && id <= CONF_VALUE_SENSOR_RIGHT))
+		return FRAME_STATUS_READ_ONLY;
+	switch (id)
+	{
+		case CONF_VALUE_MOVEMENT:
+			if (value < 0 || value >= CONF_NUMBER_OF_MOVEMENTS)
+				return FRAME_STATUS_RANGE;
+			global_movement_type = value;
+			return FRAME_STATUS_OK;
+		case CONF_VALUE_RELEASE:
+		case CONF_VALUE_AUTONOMOUS:
+		case CONF_VALUE_ZIGBEE:
 			break;
-		}
+		default:
+			return FRAME_STATUS_UNKNOWN;
 	}
+	// The other values are switches
+	if (value != 0 && value != 1)
+		return FRAME_STATUS_RANGE;
+	if (id == CONF_VALUE_RELEASE)
+		global_release = value;
+	else if (id == CONF_VALUE_AUTONOMOUS)
+		global_release_autonomous = value;
+	else
+	{
+		global_use_zigbee = value;
+		if (global_use_zigbee)
+			serial_set_zigbee();
+		else
+			serial_set_wire();
+	}
+	return FRAME_STATUS_OK;
 }
 
 /** Callback function for pressing the start button.
@@ -352,33 +365,38 @@ void btn_press_start(void)
 }
 
 /** Update of the motor position with a sinusoidal signal.
-	\details \param[in]	time_in_ms		Current time \f$ t \f$.
+	\details \param[in]	stream_time		Time of the keyframe in the time base of the trajectory streamer (see _motor_stream_time()_).
+	\param[in]	time_in_ms		Time \f$ t \f$ of the position signal.
 	\param[in]	movement_type	Definition of the movement direction. 
-	\details This functions updates the motor position depending on the current movement direction and time
-	with a sinusoidal signal of the type \f[ position(t) = A * cos(2 \pi f t +  \theta) + off. \f]
+	\details This functions appends a keyframe to the trajectory of each motor with a sinusoidal signal of the type
+	\f[ position(t) = A * cos(2 \pi f t +  \theta) + off. \f]
 	Depending on the movement direction different parameter sets for #amplitude \f$ A \f$, #frequency \f$ f \f$,
-	#phase shift \f$ \theta \f$ and #offset \f$ off \f$ are used.
-	In order to reduce motor bus traffic all motors are controlled at the same time.
+	#phase shift \f$ \theta \f$ and #offset \f$ off \f$ are used. The parameter tables are stored in flash and read
+	with the _pgm_read_*()_ functions.
+	The trajectory streamer interpolates between the keyframes and sets the moving speed of each motor to the speed
+	of the interpolated signal, so that the motors follow the signal smoothly.
  */
-void update_motor_position(uint16_t time_in_ms, uint8_t movement_type) {
+void update_motor_position(uint16_t stream_time, uint32_t time_in_ms, uint8_t movement_type) {
 	if (movement_type < CONF_NUMBER_OF_MOVEMENTS)
 	{
-		uint16_t pos[CONF_NUMBER_OF_MOTORS];
 		// Generate position signal for each motor
 		for (int i=0; i<CONF_NUMBER_OF_MOTORS; i++)
 		{
-			float c = cos(2 * M_PI * frequency[movement_type][i] * (float)time_in_ms / 1000 + phase[movement_type][i]);
-			pos[i] = amplitude[movement_type][i]*c + offset[movement_type][i];
+			// There is no pgm_read_float() in avr-libc 1.6, the floats are copied
+			float f, theta;
+			memcpy_P(&f, &frequency[movement_type][i], sizeof(f));
+			memcpy_P(&theta, &phase[movement_type][i], sizeof(theta));
+			float x = 2 * M_PI * f * (float)time_in_ms / 1000 + theta;
+			uint16_t pos = pgm_read_word(&amplitude[movement_type][i])*cos(x) + pgm_read_word(&offset[movement_type][i]);
+			motor_stream_push(i, stream_time, pos);
 		}
-		// Send motor position signal to all motors at once
-		motor_sync_move(CONF_NUMBER_OF_MOTORS, ids, pos, MOTOR_MOVE_NON_BLOCKING);		
 	}
 }
 
 /** Output compare callback function for timer 0.
 	This output compare callback function of timer 0 is called at 1 kHz and used to generate a precise global timer
-	#global_elapsed_time in milliseconds units. Based on this timer the motor positions are accurately controlled
-	in #CONF_MOTOR_UPDATE_POSITION_INTERVAL intervals by calling #update_motor_position.
+	#global_elapsed_time in milliseconds units. Based on this timer the position signal of the motors is generated
+	by calling #update_motor_position.
  */
 void timer0_compare_match(void)
 {
@@ -393,6 +411,39 @@ void timer0_compare_match(void)
 	// Toggle live bit every second
 	if (!(global_elapsed_time % 1000))
 		LED_TOGGLE(LED_AUX);
+	// Sample the telemetry signals
+	telemetry_tick();
+}
+
+/** Callback function of the telemetry stream.
+	\details This callback function is called by the timer interrupt right before the telemetry signals are sampled
+	every #CONF_TELEMETRY_PERIOD ms. It copies the setpoints of the trajectory streamer to #global_setpoints.
+	The records contain #global_elapsed_time, #global_sensor_avg, #global_setpoints, #global_release,
+	#global_release_autonomous and #global_movement_type in this order and are decoded on the PC with:
+\code
+telemetry_decode -d /dev/ttyUSB0 -l time:u32,sensor:u16*3,setpoint:u16*6,release:u8,autonomous:u8,movement:u8
+\endcode
+ */
+void telemetry_sample(void)
+{
+	for (uint8_t i = 0; i < CONF_NUMBER_OF_MOTORS; i++)
+		global_setpoints[i] = motor_stream_setpoint(i);
+}
+
+/** Callback function of the load monitor.
+	\details \param[in]	index	Index of the leg in #ids.
+	\param[in]	events	New events of the leg.
+	This callback function is called in interrupt context whenever a leg stalls or hits an obstacle. It clears the
+	movement release #global_release, so the control loop stops the gait, and remembers the leg for a message.
+ */
+void leg_blocked(const uint8_t index, const uint8_t events)
+{
+	(void)events;
+	if (global_release)
+	{
+		global_release = 0;
+		global_blocked_leg = index;
+	}
 }
 
 /** Helper function to calculate simple moving average.
@@ -455,7 +506,7 @@ int execute_autonomous_movement(uint8_t movement_type, uint16_t * dist_front_buf
 		// Reset sensor buffer with correct values
 		for (uint8_t i = 0; i < CONF_SENSOR_FRONT_NUMBER_OF_SAMPLES; i++)
 			dist_front_buffer[i] = CONF_SENSOR_FRONT_MAX_PROXIMITY;
-		printf("Going right, sensor: %.0f.\n", dist_front_avg);
+		LOG1(LOG_SQUID_GOING_RIGHT, (int16_t)(dist_front_avg + 0.5));
 		return CONF_MOVEMENT_RIGHT;
 	}
 	else if ((movement_type == CONF_MOVEMENT_LEFT || movement_type == CONF_MOVEMENT_RIGHT) &&
@@ -464,17 +515,17 @@ int execute_autonomous_movement(uint8_t movement_type, uint16_t * dist_front_buf
 		// Reset sensor buffer with correct values
 		for (uint8_t i = 0; i < CONF_SENSOR_FRONT_NUMBER_OF_SAMPLES; i++)
 			dist_front_buffer[i] = CONF_SENSOR_FRONT_MIN_PROXIMITY;
-		printf("Going forward, sensor: %.0f.\n", dist_front_avg);
+		LOG1(LOG_SQUID_GOING_FORWARD, (int16_t)(dist_front_avg + 0.5));
 		return CONF_MOVEMENT_FORWARD;
 	}
 	else if (movement_type == CONF_MOVEMENT_LEFT && dist_left_avg > CONF_SENSOR_LEFT_MAX_PROXIMITY)
 	{
-		printf("Found left wall, sensor: %.0f.\n", dist_left_avg);
+		LOG1(LOG_SQUID_LEFT_WALL, (int16_t)(dist_left_avg + 0.5));
 		return CONF_MOVEMENT_RIGHT;
 	}
 	else if (movement_type == CONF_MOVEMENT_RIGHT && dist_right_avg > CONF_SENSOR_RIGHT_MAX_PROXIMITY)
 	{
-		printf("Found right wall, sensor: %.0f.\n", dist_right_avg);
+		LOG1(LOG_SQUID_RIGHT_WALL, (int16_t)(dist_right_avg + 0.5));
 		return CONF_MOVEMENT_LEFT;
 	}
 	else
@@ -487,29 +538,45 @@ int execute_autonomous_movement(uint8_t movement_type, uint16_t * dist_front_buf
 	I/O and the sensors. Then the motors are placed in the center position for starting and the non-ending
 	control loop is executed.
 	
-	Here to begin with the global variables (e.g. #global_release,
+	Here to begin with the received requests are executed (see #remote_set_value) and the global variables (e.g. #global_release,
 	#global_movement_type and #global_elapsed_time) are copied in an atomic block to local
 	variables in order to avoid race conditions. Then the sensor values are read and a simple moving average of
 	the recent sensors values is formed (see #calc_simple_moving_avg). This is done to reduce the noise induced
 	by the movement. In the next part it is checked whether the robot is actually allowed to move. In autonomous
 	mode (Squid II) the sensors are now evaluated in order to generate the necessary movement direction
 	(see #execute_autonomous_movement). In non-autonomous mode (Squid I) this procedure is skipped since the
-	movement direction is given externally (see #serial_receive_data). In case the position is to be changed
-	the robot moves into its center position as at the start. Then in the last step the motor positions are updated
+	movement direction is given externally (see #remote_set_value). In case the position is to be changed
+	the robot moves into its center position as at the start. This movement is tracked in the background, the sensors
+	are still evaluated until it has finished. Then in the last step the motor positions are updated
 	to form the movement (see #update_motor_position). At the end of each control loop cycle the current motor status
-	is printed out to report any motor errors.
+	is logged to report any motor errors (see log.h).
 	
 	A <a href="#main_logic">schematic activity diagram</a> of the function is provided before.
 	
 	\returns The return value is not used, since the main function never ends.
  */
 int main() {	
-	// Initialize motor
+	// Initialize motor and start tracking of motor movements
 	dxl_initialize(0, 1);
+	motor_init();
+	// Learn the read timeouts, so an unplugged leg does not stall the control loop
+	motor_read_policy read_policy = {MOTOR_TIMEOUT_ADAPTIVE, 0};
+	motor_set_read_policy(MOTOR_BROADCAST_ID, &read_policy);
 	// Initialize serial connection and activate ZigBee
 	serial_initialize(57600);
 	serial_set_zigbee();
-	serial_set_rx_callback(&serial_receive_data);
+	// Execute remote requests in the main loop, the receive interrupt only stores them
+	frame_init(&serial_read, &serial_write, &remote_get_value, &remote_set_value);
+	// Send the log messages as ids, they are printed by tools/log_decode.c
+	log_init(&serial_write);
+	// Stream the state of the robot, the records are sampled by the timer interrupt
+	telemetry_add(&global_elapsed_time, sizeof(global_elapsed_time));
+	telemetry_add(global_sensor_avg, sizeof(global_sensor_avg));
+	telemetry_add(global_setpoints, sizeof(global_setpoints));
+	telemetry_add(&global_release, sizeof(global_release));
+	telemetry_add(&global_release_autonomous, sizeof(global_release_autonomous));
+	telemetry_add(&global_movement_type, sizeof(global_movement_type));
+	telemetry_start(CONF_TELEMETRY_PERIOD, &serial_write, &telemetry_sample);
 	// Initialize timer
 	uint8_t timer = 0;
 	timer_set_interrupt(timer, TIT_OUTPUT_COMPARE_MATCH_A, &timer0_compare_match);
@@ -524,13 +591,24 @@ int main() {
 	sensor_init(CONF_SENSOR_RIGHT, SENSOR_IR);
 	// Enable global interrupts
 	sei();
+	// Look for the motors and watch them in the background
+	motor_scan(0, MOTOR_BROADCAST_ID - 1, MOTOR_SCAN_TIMEOUT_US);
+	for (int i = 0; i < CONF_NUMBER_OF_MOTORS; i++)
+		if (motor_registry_find(ids[i]) < 0)
+			LOG1(LOG_SQUID_MOTOR_MISSING, ids[i]);
+	motor_set_presence_check(1, NULL);
+	// Stop when a leg hits something
+	motor_load_start(CONF_NUMBER_OF_MOTORS, ids, CONF_LEG_LOAD_INTERVAL, CONF_LEG_STALL_LOAD, CONF_LEG_COLLISION_RISE, &leg_blocked);
 	// Center motor position
 	const uint16_t center_pos[CONF_NUMBER_OF_MOTORS] = {512, 512, 512, 512, 512, 512};
-	motor_sync_move(CONF_NUMBER_OF_MOTORS, ids, center_pos, MOTOR_MOVE_BLOCKING);
+	motor_move_wait(motor_sync_move_timed(CONF_NUMBER_OF_MOTORS, ids, center_pos, CONF_MOTOR_CENTER_DURATION));
 	// Declare local variables
 	uint8_t release = 0, release_autonomous = 0;
-	uint32_t elapsed_time = 0, last_elapsed_time = 0;
+	uint32_t elapsed_time = 0, keyframe_time = 0;
+	uint16_t keyframe_stream_time = 0;
+	uint8_t streaming = 0;
 	uint8_t movement_type = 0, last_movement_type = 0;
+	motor_move_handle center_move = MOTOR_MOVE_INVALID;
 	// Variables to calculate simple moving average
 	uint16_t dist_front_buffer[CONF_SENSOR_FRONT_NUMBER_OF_SAMPLES];
 	double dist_front_avg = 0;
@@ -541,6 +619,12 @@ int main() {
 	uint8_t dist_front_buffer_pointer = 0, dist_left_buffer_pointer = 0, dist_right_buffer_pointer = 0;
 	while(1)
 	{
+		// Execute received requests and indicate them by the receive LED
+		if (frame_poll() > 0)
+			LED_TOGGLE(LED_RXD);
+		// Send the sampled telemetry records
+		telemetry_poll();
+		
 		// Copy global variables in an atomic blocks to avoid race conditions
 		ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
 		{
@@ -557,6 +641,13 @@ int main() {
 			&dist_left_buffer_pointer, sensor_read(CONF_SENSOR_LEFT, SENSOR_DISTANCE), dist_left_avg);
 		dist_right_avg = calc_simple_moving_avg(dist_right_buffer, CONF_SENSOR_RIGHT_NUMBER_OF_SAMPLES,
 			&dist_right_buffer_pointer, sensor_read(CONF_SENSOR_RIGHT, SENSOR_DISTANCE), dist_right_avg);
+		// Publish the averages for the telemetry stream
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+		{
+			global_sensor_avg[0] = dist_front_avg + 0.5;
+			global_sensor_avg[1] = dist_left_avg + 0.5;
+			global_sensor_avg[2] = dist_right_avg + 0.5;
+		}
 
 		// Check for release to move
 		if (release)
@@ -582,27 +673,58 @@ int main() {
 			// Check for turn and execute in case
 			if (movement_type != last_movement_type)
 			{
-				// Go to center position
-				motor_sync_move(CONF_NUMBER_OF_MOTORS, ids, center_pos, MOTOR_MOVE_BLOCKING);
-				// Reset timer
-				timer_reset(timer);
-				// Update position immediately
-				last_elapsed_time = 0;
+				motor_stream_stop();
+				streaming = 0;
+				// Go to center position with all legs arriving together, the sensors are still read meanwhile
+				center_move = motor_sync_move_timed(CONF_NUMBER_OF_MOTORS, ids, center_pos, CONF_MOTOR_CENTER_DURATION);
 				// Store current value
 				last_movement_type = movement_type;
 			}
 			
-			// Check for position update and execute in case
-			if ((elapsed_time - last_elapsed_time) > CONF_MOTOR_UPDATE_POSITION_INTERVAL)
+			// Check if center position has been reached
+			if (center_move != MOTOR_MOVE_INVALID)
+			{
+				if (motor_move_finished(center_move))
+				{
+					center_move = MOTOR_MOVE_INVALID;
+					// Reset timer
+					timer_reset(timer);
+				}
+			}
+			else
 			{
-				update_motor_position((uint16_t)elapsed_time, movement_type);
-				// Store current time
-				last_elapsed_time = elapsed_time;
-			}					
+				// Start the trajectory with the current position signal
+				if (!streaming)
+				{
+					streaming = motor_stream_start(CONF_NUMBER_OF_MOTORS, ids, CONF_MOTOR_UPDATE_POSITION_INTERVAL);
+					keyframe_stream_time = motor_stream_time();
+					keyframe_time = elapsed_time;
+				}
+				// Keep the keyframe buffers filled, the motors are updated in the background
+				while (streaming && motor_stream_free(0) > 0)
+				{
+					update_motor_position(keyframe_stream_time, keyframe_time, movement_type);
+					keyframe_stream_time += CONF_MOTOR_KEYFRAME_INTERVAL;
+					keyframe_time += CONF_MOTOR_KEYFRAME_INTERVAL;
+				}
+			}
+		}
+		// Stop the motors at their current setpoint
+		else if (streaming)
+		{
+			motor_stream_stop();
+			streaming = 0;
+		}
+		
+		// Report a blocked leg once
+		if (global_blocked_leg != 0xFF)
+		{
+			LOG1(LOG_SQUID_LEG_BLOCKED, ids[global_blocked_leg]);
+			global_blocked_leg = 0xFF;
 		}
 		
-		// Print motor errors
-		PrintErrorCode();
+		// Log new motor errors
+		motor_report_errors(CONF_ERROR_REPORT_INTERVAL);
 	}	
 	return 0;
 } 
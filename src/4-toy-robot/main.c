@@ -18,12 +18,14 @@
 #include <util/atomic.h>
 #include <stdlib.h>
 #include <string.h>
+#include <avr/pgmspace.h>
 
 #include "../macro.h"
 #include "../sensor.h"
 #include "../motor.h"
 #include <dynamixel.h>
 #include "../serial.h"
+#include "../log.h"
 #include "../error.h"
 #include "../serialzigbee.h"
 #include "../io.h"
@@ -43,6 +45,12 @@
 #define CONF_MOTOR_STILL	1
 #define CONF_MOTOR_MOVE2	2
 #define CONF_MOTOR_STILL2	8
+/// Minimum time in ms between two reports of motor errors
+#define CONF_ERROR_REPORT_INTERVAL	1000
+/// Time in ms between two load samples of the jaws
+#define CONF_JAW_LOAD_INTERVAL		10
+/// Load of a jaw above which it is blocked by a finger
+#define CONF_JAW_STALL_LOAD			400
 
 /// motor1 midt position
 #define CONF_MOTOR_STILL_OPEN		512
@@ -76,8 +84,8 @@ static volatile uint32_t global_elapsed_time = 0;
 #define CONF_TEXT_NUMBER_OF_CHARS	30
 #define CONF_TEXT_NUMBER_WIN_ROUND	4
 
-///An array containing the text to show user win (random select.)
-const char text_win_round[CONF_TEXT_NUMBER_WIN_ROUND][CONF_TEXT_NUMBER_OF_CHARS] = {
+///An array containing the text to show user win (random select.), stored in flash
+const char text_win_round[CONF_TEXT_NUMBER_WIN_ROUND][CONF_TEXT_NUMBER_OF_CHARS] PROGMEM = {
                                                                                      "Good job!",
 									                                                 "You got me!",
 									                                                 "Well done!",
@@ -85,8 +93,8 @@ const char text_win_round[CONF_TEXT_NUMBER_WIN_ROUND][CONF_TEXT_NUMBER_OF_CHARS]
 															                       };
 
 #define CONF_TEXT_NUMBER_LOST_ROUND	4
-///An array containing the text to show shark win (random select.)
-const char text_lost_round[CONF_TEXT_NUMBER_LOST_ROUND][CONF_TEXT_NUMBER_OF_CHARS] = {
+///An array containing the text to show shark win (random select.), stored in flash
+const char text_lost_round[CONF_TEXT_NUMBER_LOST_ROUND][CONF_TEXT_NUMBER_OF_CHARS] PROGMEM = {
                                                                                        "Haha, I owned you!",
 																                       "How did that bite feel?",
 																                       "Did I injure you?",
@@ -131,7 +139,7 @@ uint8_t calc_score_and_check_for_win(uint8_t * hum_points, uint8_t * comp_points
 		LED_ON(LED_MANAGE);
 	if (*hum_points > 3)
 	{
-		printf("Congratz! You win!\n");
+		printf_P(PSTR("Congratz! You win!\n"));
 		*hum_points = 0;
 		*comp_points = 0;
 		res = 1;
@@ -144,20 +152,20 @@ uint8_t calc_score_and_check_for_win(uint8_t * hum_points, uint8_t * comp_points
 		LED_ON(LED_TXD);
 	if (*comp_points > 3)
 	{
-		printf("I owned you!\n");
+		printf_P(PSTR("I owned you!\n"));
 		*hum_points = 0;
 		*comp_points = 0;
 		res = 1;
 	}
 	return res;
 }
-// prints one of 4 random text, when one part wins
+// prints one of 4 random text, when one part wins (text_array is in flash)
 void print_random_text(const char * text_array, uint8_t array_size)
 {
 	uint8_t index = (random() % array_size) * CONF_TEXT_NUMBER_OF_CHARS;
 	char text[CONF_TEXT_NUMBER_OF_CHARS];
-	strncpy(text, &text_array[index], CONF_TEXT_NUMBER_OF_CHARS);
-	printf("%s \n", text);
+	strncpy_P(text, &text_array[index], CONF_TEXT_NUMBER_OF_CHARS);
+	printf_P(PSTR("%s \n"), text);
 }
 
 int main() {
@@ -176,8 +184,12 @@ int main() {
 
 	// Initialize other stuff		
 	dxl_initialize(0,1);
+	/// track motor movements in the background
+	motor_init();
 	/// sets seriel speed uart rs232
 	serial_initialize(57600);
+	/// the serial connection is the text terminal of the game, log frames would garble it, so motor errors are discarded
+	log_init(NULL);
 
 	sensor_init(CONF_SENSOR_FINGER, SENSOR_IR);
 	sensor_init(CONF_BUTTON_BITE, SENSOR_TOUCH);
@@ -188,7 +200,7 @@ int main() {
 	/// Activate general interrupts
 	sei();
 
-	printf("\n\nWelcome to SharkBite!\n\nPress start to begin new game.\n");
+	printf_P(PSTR("\n\nWelcome to SharkBite!\n\nPress start to begin new game.\n"));
 
 	/// Open mouth on shark one
 	const uint8_t ids[CONF_MOTOR_NUMBER] = {CONF_MOTOR_STILL, CONF_MOTOR_MOVE, CONF_MOTOR_STILL2, CONF_MOTOR_MOVE2};
@@ -197,6 +209,10 @@ int main() {
 
 	motor_sync_move(CONF_MOTOR_NUMBER, ids, pos, MOTOR_MOVE_BLOCKING);
 
+	/// Watch the load of both jaws in the background, a blocked jaw has bitten a finger
+	const uint8_t jaws[2] = {CONF_MOTOR_MOVE, CONF_MOTOR_MOVE2};
+	motor_load_start(2, jaws, CONF_JAW_LOAD_INTERVAL, CONF_JAW_STALL_LOAD, 0, NULL);
+
 	/// Wait for start button to begin
 	while (!BTN_START_PRESSED);
 
@@ -255,8 +271,14 @@ int main() {
 			{
 				// Give motor command to close mouth only once
 				if (!bite_request_old)
+				{
+					motor_load_event(0);	//forget events of the open mouth
 					motor_move(CONF_MOTOR_MOVE, CONF_MOTOR_MOVE_CLOSE, MOTOR_MOVE_NON_BLOCKING);
+				}
 				_delay_ms(15);
+				// A jaw which is blocked before it is closed has caught the finger
+				if (motor_load_event(0) & MOTOR_LOAD_EVENT_STALL)
+					bitten = 1;
 				uint16_t p = motor_get_position(CONF_MOTOR_MOVE);
 				uint16_t dist = 0;
 				// Calculate distance between current position and goal position
@@ -288,8 +310,13 @@ int main() {
 			{
 				// Give motor command to close mouth only once
 				if (!bite_request2_old)
+				{
+					motor_load_event(1);
 					motor_move(CONF_MOTOR_MOVE2, CONF_MOTOR_MOVE2_CLOSE, MOTOR_MOVE_NON_BLOCKING);
+				}
 				_delay_ms(15);
+				if (motor_load_event(1) & MOTOR_LOAD_EVENT_STALL)
+					bitten2 = 1;
 				uint16_t p = motor_get_position(CONF_MOTOR_MOVE2);
 				uint16_t dist = 0;
 				if (p > CONF_MOTOR_MOVE2_CLOSE)
@@ -323,14 +350,14 @@ int main() {
 			/// If there is a request to bite or the finger has been removed
 			if (bite_request || finger_in_old)
 			{
-				printf("Come on! Don't be a chicken!\n");
+				printf_P(PSTR("Come on! Don't be a chicken!\n"));
 				future_timestamp = get_random_future_timestamp(elapsed_time);
 			}
 		}
 		// If the button has been pressed without any reason!
 		if ((bitten & !last_bitten || bitten2 & !last_bitten2) & !bite_request)
 		{
-			printf("Don't touch me!\n");
+			printf_P(PSTR("Don't touch me!\n"));
 		}
 
 		// Do scoring and check for end of game
@@ -340,7 +367,7 @@ int main() {
 			future_timestamp2 = 0;
 			bite_request = 0;
 			bite_request2 = 0;
-			printf("\nPress start to begin new game.\n");
+			printf_P(PSTR("\nPress start to begin new game.\n"));
 			// Wait for start button to begin
 			while (!BTN_START_PRESSED);
 		}			
@@ -350,8 +377,8 @@ int main() {
 		bite_request2_old = bite_request2;
 		finger_in_old = finger_in;
 
-		// Print motor errors
-		PrintErrorCode();
+		// Log new motor errors, discarded as long as the logging has no write function
+		motor_report_errors(CONF_ERROR_REPORT_INTERVAL);
 	}
 	return 0;
 }
@@ -0,0 +1,297 @@
+/*! \file dxl_hal.c
+    \brief Hardware abstraction layer of the Dynamixel bus driver for the CM-510 (declaration part, see dxl_hal.h for an interface description).
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <stddef.h>
+#include "dxl_hal.h"
+#include "timer.h"
+
+/// \private Mask for the transmit ring buffer indices.
+#define DXL_HAL_TX_MASK			(DXL_HAL_TX_BUFFER_SIZE - 1)
+/// \private Mask for the receive ring buffer indices.
+#define DXL_HAL_RX_MASK			(DXL_HAL_RX_BUFFER_SIZE - 1)
+
+/// \private Duration of one tick of the time base timer in microseconds (prescaler 64).
+#define DXL_HAL_TIMER_TICK_US	(64000000ul / F_CPU)
+/// \private Interrupt flag register of the time base timer.
+#define DXL_HAL_TIMER_FLAGS		TIFR3
+
+/// \private Switch the bus transceiver to transmit.
+#define DIR_TXD		PORTE &= ~0x08, PORTE |= 0x04
+/// \private Switch the bus transceiver to receive.
+#define DIR_RXD		PORTE &= ~0x04, PORTE |= 0x08
+
+/// \private Transmit ring buffer.
+static volatile unsigned char gbDxlTxBuffer[DXL_HAL_TX_BUFFER_SIZE];
+/// \private Read position of the transmit ring buffer.
+static volatile uint8_t gbDxlTxHead = 0;
+/// \private Write position of the transmit ring buffer.
+static volatile uint8_t gbDxlTxTail = 0;
+
+/// \private Receive ring buffer.
+static volatile unsigned char gbDxlRxBuffer[DXL_HAL_RX_BUFFER_SIZE];
+/// \private Read position of the receive ring buffer.
+static volatile uint8_t gbDxlRxHead = 0;
+/// \private Write position of the receive ring buffer.
+static volatile uint8_t gbDxlRxTail = 0;
+
+/// \private Upper 16 bits of the time base.
+static volatile uint16_t gwDxlTimeHigh = 0;
+
+/// \private Transmit complete callback.
+static volatile dxl_hal_callback tx_callback = NULL;
+/// \private Receive callback.
+static volatile dxl_hal_callback rx_callback = NULL;
+/// \private Timeout callback.
+static volatile dxl_hal_callback timeout_callback = NULL;
+
+/// \private Overflow callback of the time base timer.
+static void dxl_hal_timer_overflow(void)
+{
+	gwDxlTimeHigh++;
+}
+
+/// \private Compare match callback of the time base timer.
+static void dxl_hal_timer_timeout(void)
+{
+	dxl_hal_callback callback = timeout_callback;
+	dxl_hal_cancel_timeout();
+	if (callback != NULL)
+		callback();
+}
+
+int dxl_hal_open(int devIndex, float baudrate)
+{
+	unsigned short divisor = (unsigned short)(2000000.0 / baudrate) - 1;
+	(void)devIndex;
+
+	// Dynamixel communication using UART0
+	// set UART register A
+	// Bit 6: USART Transmit Complete (cleared by writing one)
+	// Bit 1: Double The USART Transmission Speed
+	UCSR0A = 0b01000010;
+	// set UART register B
+	// bit7: enable rx interrupt
+	// bit4: enable rx
+	// bit3: enable tx
+	// Transmit interrupts are only enabled while a packet is sent.
+	UCSR0B = 0b10011000;
+	// set UART register C
+	// bit2,bit1: data size(11 = 8bit)
+	UCSR0C = 0b00000110;
+
+	// initialize buffers
+	gbDxlTxHead = gbDxlTxTail = 0;
+	gbDxlRxHead = gbDxlRxTail = 0;
+
+	// set baudrate
+	UBRR0H = (unsigned char)(divisor >> 8);
+	UBRR0L = (unsigned char)(divisor & 0xFF);
+
+	// Transceiver direction pins are outputs, default direction is receive
+	DDRE |= 0x0C;
+	DIR_RXD;
+
+	// Start free-running time base
+	gwDxlTimeHigh = 0;
+	timer_set_interrupt(DXL_HAL_TIMER, TIT_OVERFLOW, &dxl_hal_timer_overflow);
+	return timer_init(DXL_HAL_TIMER, TOM_NORMAL, TPS_DIV_64, 0) == TIMER_ERROR_SUCCESS;
+}
+
+void dxl_hal_close(void)
+{
+	UCSR0B = 0;
+	dxl_hal_cancel_timeout();
+	timer_set_interrupt(DXL_HAL_TIMER, TIT_OVERFLOW, NULL);
+	timer_disable(DXL_HAL_TIMER);
+}
+
+void dxl_hal_clear(void)
+{
+	DXL_HAL_ATOMIC
+	{
+		gbDxlRxHead = gbDxlRxTail;
+	}
+}
+
+int dxl_hal_tx(const unsigned char *pPacket, int numPacket)
+{
+	int count;
+	uint8_t tail = gbDxlTxTail;
+	uint8_t used;
+
+	DXL_HAL_ATOMIC
+	{
+		used = (uint8_t)(tail - gbDxlTxHead) & DXL_HAL_TX_MASK;
+	}
+	if (numPacket > DXL_HAL_TX_BUFFER_SIZE - 1 - used)
+		return 0;
+
+	// Copy packet into the ring, only the interrupt reads from it
+	for (count = 0; count < numPacket; count++)
+	{
+		gbDxlTxBuffer[tail] = pPacket[count];
+		tail = (tail + 1) & DXL_HAL_TX_MASK;
+	}
+
+	DXL_HAL_ATOMIC
+	{
+		gbDxlTxTail = tail;
+		if (!bit_is_set(UCSR0B, UDRIE0))
+		{
+			// Start transmission: clear transmit complete flag and enable transmit interrupts
+			DIR_TXD;
+			UCSR0A |= _BV(TXC0);
+			UCSR0B |= _BV(UDRIE0) | _BV(TXCIE0);
+		}
+	}
+	return count;
+}
+
+int dxl_hal_rx(unsigned char *pPacket, int numPacket)
+{
+	int count = 0;
+	uint8_t head = gbDxlRxHead;
+
+	while (count < numPacket && head != gbDxlRxTail)
+	{
+		pPacket[count++] = gbDxlRxBuffer[head];
+		head = (head + 1) & DXL_HAL_RX_MASK;
+	}
+	gbDxlRxHead = head;
+	return count;
+}
+
+void dxl_hal_set_tx_callback(const dxl_hal_callback callback)
+{
+	DXL_HAL_ATOMIC
+	{
+		tx_callback = callback;
+	}
+}
+
+void dxl_hal_set_rx_callback(const dxl_hal_callback callback)
+{
+	DXL_HAL_ATOMIC
+	{
+		rx_callback = callback;
+	}
+}
+
+void dxl_hal_set_timeout(uint16_t time_us, const dxl_hal_callback callback)
+{
+	uint16_t now = 0;
+	DXL_HAL_ATOMIC
+	{
+		timeout_callback = callback;
+		timer_get(DXL_HAL_TIMER, &now);
+		timer_set_value(DXL_HAL_TIMER, TVT_OUTPUT_COMPARE_A, now + time_us / DXL_HAL_TIMER_TICK_US + 1);
+		// Discard a compare match which happened before
+		DXL_HAL_TIMER_FLAGS = _BV(OCF3A);
+		timer_set_interrupt(DXL_HAL_TIMER, TIT_OUTPUT_COMPARE_MATCH_A, &dxl_hal_timer_timeout);
+	}
+}
+
+void dxl_hal_cancel_timeout(void)
+{
+	timer_set_interrupt(DXL_HAL_TIMER, TIT_OUTPUT_COMPARE_MATCH_A, NULL);
+	timeout_callback = NULL;
+}
+
+uint32_t dxl_hal_get_time(void)
+{
+	uint16_t low = 0, high;
+	DXL_HAL_ATOMIC
+	{
+		timer_get(DXL_HAL_TIMER, &low);
+		high = gwDxlTimeHigh;
+		// Account for an overflow which has not been handled yet
+		if (bit_is_set(DXL_HAL_TIMER_FLAGS, TOV3) && low < 0x8000)
+			high++;
+	}
+	return (((uint32_t)high << 16) | low) * DXL_HAL_TIMER_TICK_US;
+}
+
+/// \private Function to send the next byte of the transmit ring, called when the data register is empty.
+static void dxl_hal_tx_next(void)
+{
+	if (gbDxlTxHead != gbDxlTxTail)
+	{
+		UDR0 = gbDxlTxBuffer[gbDxlTxHead];
+		gbDxlTxHead = (gbDxlTxHead + 1) & DXL_HAL_TX_MASK;
+	}
+	else
+		UCSR0B &= ~_BV(UDRIE0);
+}
+
+/// \private Function to switch the bus back to receive, called when the transmission is complete.
+static void dxl_hal_tx_end(void)
+{
+	if (gbDxlTxHead != gbDxlTxTail)
+		return;
+	UCSR0B &= ~_BV(TXCIE0);
+	DIR_RXD;
+	if (tx_callback != NULL)
+		tx_callback();
+}
+
+/// \private Function to store a received byte in the receive ring.
+static void dxl_hal_rx_next(void)
+{
+	unsigned char data = UDR0;
+	uint8_t next = (gbDxlRxTail + 1) & DXL_HAL_RX_MASK;
+	if (next != gbDxlRxHead)
+	{
+		gbDxlRxBuffer[gbDxlRxTail] = data;
+		gbDxlRxTail = next;
+	}
+	if (rx_callback != NULL)
+		rx_callback();
+}
+
+void dxl_hal_poll(void)
+{
+	// The interrupts do the work while they are enabled
+	if (bit_is_set(SREG, SREG_I))
+		return;
+	if (bit_is_set(UCSR0B, UDRIE0) && bit_is_set(UCSR0A, UDRE0))
+		dxl_hal_tx_next();
+	if (bit_is_set(UCSR0B, TXCIE0) && bit_is_set(UCSR0A, TXC0))
+	{
+		// The flag is only cleared automatically when the interrupt is executed
+		UCSR0A |= _BV(TXC0);
+		dxl_hal_tx_end();
+	}
+	if (bit_is_set(UCSR0A, RXC0))
+		dxl_hal_rx_next();
+	if (bit_is_set(TIMSK3, TOIE3) && bit_is_set(DXL_HAL_TIMER_FLAGS, TOV3))
+	{
+		DXL_HAL_TIMER_FLAGS = _BV(TOV3);
+		dxl_hal_timer_overflow();
+	}
+	if (bit_is_set(TIMSK3, OCIE3A) && bit_is_set(DXL_HAL_TIMER_FLAGS, OCF3A))
+	{
+		DXL_HAL_TIMER_FLAGS = _BV(OCF3A);
+		dxl_hal_timer_timeout();
+	}
+}
+
+/// \private Data register empty interrupt: send next byte of the transmit ring.
+ISR(USART0_UDRE_vect)
+{
+	dxl_hal_tx_next();
+}
+
+/// \private Transmit complete interrupt: switch the bus back to receive.
+ISR(USART0_TX_vect)
+{
+	dxl_hal_tx_end();
+}
+
+/// \private Receive complete interrupt: store byte in the receive ring.
+ISR(USART0_RX_vect)
+{
+	dxl_hal_rx_next();
+}
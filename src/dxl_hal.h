@@ -0,0 +1,113 @@
+/*! \file dxl_hal.h
+    \brief Hardware abstraction layer of the Dynamixel bus driver.
+	\author Hans-Peter Wolf
+	\copyright GNU Public License V3
+	\date 2012
+
+	\file dxl_hal.h
+	\details This file declares the byte level interface between the Dynamixel protocol driver (dynamixel.c) and the
+	hardware. It follows the structure of the hardware abstraction layer of the Robotis Dynamixel SDK, but all
+	transfers are interrupt-driven: #dxl_hal_tx only queues the bytes in a transmit ring buffer which is drained by
+	the data register empty interrupt, received bytes are stored in a receive ring buffer by the receive interrupt and
+	the protocol driver is notified by callback functions. Timeouts are generated by a timer compare match interrupt,
+	thus the CPU is free while a packet is in flight.
+
+	Two implementations of this interface exist:
+	- dxl_hal.c: The CM-510 implementation using UART0 of the ATmega2561 and timer #DXL_HAL_TIMER as time base.
+	- dxl_hal_host.c: A Linux host implementation with a virtual bus of simulated motors, see dxl_hal_host.h.
+ */
+#ifndef _DXL_HAL_HEADER
+#define _DXL_HAL_HEADER
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef __AVR__
+#include <util/atomic.h>
+/// Macro to execute the following block without being interrupted by the bus interrupts.
+#define DXL_HAL_ATOMIC		ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+#else
+/// Macro to execute the following block without being interrupted by the bus interrupts.
+#define DXL_HAL_ATOMIC
+#endif
+
+/// Timer used as time base for the bus timeouts (see timer.h).
+#define DXL_HAL_TIMER			3
+
+/// Size of the transmit ring buffer in bytes. Must be a power of two.
+#define DXL_HAL_TX_BUFFER_SIZE	256
+/// Size of the receive ring buffer in bytes. Must be a power of two.
+#define DXL_HAL_RX_BUFFER_SIZE	128
+
+/// Bus event callback function definition.
+typedef void (*dxl_hal_callback)(void);
+
+/** Function to open the bus device.
+	\param[in]	devIndex	Device index (unused on the CM-510).
+	\param[in]	baudrate	Real baudrate in bits per second (e.g. 1000000).
+	\returns The function returns 1 in case of success and 0 otherwise.
+ */
+int dxl_hal_open(int devIndex, float baudrate);
+
+/// Function to close the bus device.
+void dxl_hal_close(void);
+
+/// Function to discard all bytes in the receive ring buffer.
+void dxl_hal_clear(void);
+
+/** Function to queue bytes for transmission.
+	The bytes are copied into the transmit ring buffer and sent by the transmit interrupt. The function returns
+	immediately. As soon as the last byte has left the shift register the bus direction is switched back to receive
+	and the callback registered with #dxl_hal_set_tx_callback is called.
+	\param[in]	pPacket		Bytes to send.
+	\param[in]	numPacket	Number of bytes to send.
+	\returns The number of bytes queued. This is 0 if the bytes do not fit into the transmit ring buffer.
+ */
+int dxl_hal_tx(const unsigned char *pPacket, int numPacket);
+
+/** Function to read received bytes from the receive ring buffer.
+	\param[out]	pPacket		Buffer for the received bytes.
+	\param[in]	numPacket	Maximum number of bytes to read.
+	\returns The number of bytes read.
+ */
+int dxl_hal_rx(unsigned char *pPacket, int numPacket);
+
+/** Function to register the transmit complete callback.
+	\param[in]	callback	Function called (in interrupt context) when a transmission has been completed.
+ */
+void dxl_hal_set_tx_callback(const dxl_hal_callback callback);
+
+/** Function to register the receive callback.
+	\param[in]	callback	Function called (in interrupt context) whenever a byte has been received.
+ */
+void dxl_hal_set_rx_callback(const dxl_hal_callback callback);
+
+/** Function to arm the timeout.
+	\param[in]	time_us		Time in microseconds after which the callback is called. A pending timeout is replaced.
+	\param[in]	callback	Function called (in interrupt context) when the timeout expires.
+ */
+void dxl_hal_set_timeout(uint16_t time_us, const dxl_hal_callback callback);
+
+/// Function to cancel a pending timeout.
+void dxl_hal_cancel_timeout(void);
+
+/** Function to service the bus by polling while interrupts are disabled.
+	The transfers, the callbacks and the timeout are driven by interrupts. If the interrupts are disabled, the
+	protocol driver calls this function while it waits, which does the work of the pending interrupts instead. It
+	does nothing while interrupts are enabled.
+ */
+void dxl_hal_poll(void);
+
+/** Function to get the time base of the bus.
+	\returns A free-running time stamp in microseconds.
+ */
+uint32_t dxl_hal_get_time(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
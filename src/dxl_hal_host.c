@@ -0,0 +1,509 @@
+/*! \file dxl_hal_host.c
+    \brief Virtual Dynamixel bus for running the bus driver on a Linux host (declaration part, see dxl_hal.h and dxl_hal_host.h for an interface description).
+ */
+
+#include <stddef.h>
+#include <string.h>
+#include <dynamixel.h>
+#include "dxl_hal.h"
+#include "dxl_hal_host.h"
+#include "motor_control_table.h"
+
+/// \private Control table address of the id.
+#define HOST_ID					3
+/// \private Control table address of the return delay time.
+#define HOST_RETURN_DELAY_TIME	5
+/// \private Control table address of the CW angle limit (low byte).
+#define HOST_CW_ANGLE_LIMIT_L	6
+/// \private Control table address of the CCW angle limit (low byte).
+#define HOST_CCW_ANGLE_LIMIT_L	8
+/// \private Control table address of the status return level.
+#define HOST_STATUS_RETURN_LEVEL	16
+
+/// \private Maximum speed of an AX-12 in position units per second (114 rpm).
+#define HOST_MAX_SPEED_UNITS	2334ull
+/// \private Speed value corresponding to #HOST_MAX_SPEED_UNITS.
+#define HOST_MAX_SPEED_VALUE	1023ull
+
+/// \private Number of addressable devices on the bus.
+#define HOST_DEVICE_AMOUNT		BROADCAST_ID
+
+/// \private AX-12 factory defaults of the control table.
+static const unsigned char host_default_table[DXL_HAL_HOST_TABLE_SIZE] = {
+	12, 0, 0x18, 1, 1, 250, 0, 0, 0xFF, 0x03,		// 0-9: model, firmware, id, baud, return delay, angle limits
+	0, 70, 60, 140, 0xFF, 0x03, 2, 36, 36, 0,		// 10-19: limits, max torque, status return level, alarms
+	0, 0, 0, 0, 0, 0, 1, 1, 32, 32,					// 20-29: torque enable, led, compliance
+	0x00, 0x02, 0, 0, 0xFF, 0x03, 0x00, 0x02, 0, 0,	// 30-39: goal position, moving speed, torque limit, present position/speed
+	0, 0, 120, 32, 0, 0, 0, 0, 32, 0				// 40-49: present load/voltage/temperature, registered, moving, lock, punch
+};
+
+/// \private Simulated motor.
+typedef struct {
+	/// Set if the motor is attached to the bus.
+	unsigned char present;
+	/// Control table.
+	unsigned char table[DXL_HAL_HOST_TABLE_SIZE];
+	/// Registered write (address followed by data) of a REG_WRITE instruction.
+	unsigned char reg_data[DXL_HAL_HOST_TABLE_SIZE + 1];
+	/// Length of the registered write including the address, 0 if none.
+	unsigned char reg_length;
+	/// Fraction of a position unit travelled, in units * ns.
+	unsigned long long motion_remainder;
+} host_device;
+
+/// \private Simulated motors by id.
+static host_device host_devices[HOST_DEVICE_AMOUNT];
+
+/// \private Virtual time in ns.
+static unsigned long long host_time_ns = 0;
+/// \private Transmission time of one byte in ns.
+static unsigned long long host_byte_time_ns = 10000;
+/// \private Bus statistics.
+static dxl_hal_host_stats host_stats;
+
+/// \private Receive ring buffer.
+static unsigned char host_rx_buffer[DXL_HAL_RX_BUFFER_SIZE];
+/// \private Read position of the receive ring buffer.
+static unsigned int host_rx_head = 0;
+/// \private Write position of the receive ring buffer.
+static unsigned int host_rx_tail = 0;
+
+/// \private Bytes waiting for transmission.
+static unsigned char host_tx_buffer[DXL_HAL_TX_BUFFER_SIZE];
+/// \private Number of bytes waiting for transmission.
+static int host_tx_length = 0;
+/// \private Set while the bus is processing a transmission (callbacks may queue more bytes).
+static int host_tx_busy = 0;
+
+/// \private Transmit complete callback.
+static dxl_hal_callback tx_callback = NULL;
+/// \private Receive callback.
+static dxl_hal_callback rx_callback = NULL;
+/// \private Timeout callback, _NULL_ if no timeout is pending.
+static dxl_hal_callback timeout_callback = NULL;
+/// \private Virtual time of the pending timeout in ns.
+static unsigned long long host_timeout_ns = 0;
+
+/// \private Internal function to read a word from a control table.
+static unsigned int host_get_word(const unsigned char * table, unsigned char address)
+{
+	return table[address] | (table[address + 1] << 8);
+}
+
+/// \private Internal function to write a word to a control table.
+static void host_set_word(unsigned char * table, unsigned char address, unsigned int value)
+{
+	table[address] = value & 0xFF;
+	table[address + 1] = (value >> 8) & 0xFF;
+}
+
+/// \private Internal function to move the simulated motors for a certain time.
+static void host_update_motion(unsigned long long elapsed_ns)
+{
+	int id;
+	for (id = 0; id < HOST_DEVICE_AMOUNT; id++)
+	{
+		host_device * d = &host_devices[id];
+		if (!d->present)
+			continue;
+		unsigned char * t = d->table;
+		unsigned int speed = host_get_word(t, MOVING_SPEED_L);
+		unsigned int position = host_get_word(t, PRESENT_POSITION_L);
+		unsigned long long steps;
+		if (host_get_word(t, HOST_CW_ANGLE_LIMIT_L) == 0 && host_get_word(t, HOST_CCW_ANGLE_LIMIT_L) == 0)
+		{
+			// Wheel mode: bit 10 is the direction (1 = CW = decreasing position)
+			unsigned int value = speed & 0x3FF;
+			d->motion_remainder += HOST_MAX_SPEED_UNITS * value * elapsed_ns / HOST_MAX_SPEED_VALUE;
+			steps = d->motion_remainder / 1000000000ull;
+			d->motion_remainder %= 1000000000ull;
+			if (speed & 0x400)
+				position = (position + 1024 - (unsigned int)(steps % 1024)) % 1024;
+			else
+				position = (position + (unsigned int)(steps % 1024)) % 1024;
+			host_set_word(t, PRESENT_SPEED_L, speed & 0x7FF);
+			t[MOVING] = value != 0;
+		}
+		else
+		{
+			// Joint mode: move towards goal position, speed 0 means maximum speed
+			unsigned int goal = host_get_word(t, GOAL_POSITION_L);
+			unsigned int value = (speed & 0x3FF) ? (speed & 0x3FF) : HOST_MAX_SPEED_VALUE;
+			if (!t[TORQUE_ENABLE] || goal == position)
+			{
+				d->motion_remainder = 0;
+				host_set_word(t, PRESENT_SPEED_L, 0);
+				t[MOVING] = 0;
+				continue;
+			}
+			d->motion_remainder += HOST_MAX_SPEED_UNITS * value * elapsed_ns / HOST_MAX_SPEED_VALUE;
+			steps = d->motion_remainder / 1000000000ull;
+			d->motion_remainder %= 1000000000ull;
+			if (goal > position)
+			{
+				position = (steps >= goal - position) ? goal : position + (unsigned int)steps;
+				host_set_word(t, PRESENT_SPEED_L, value);
+			}
+			else
+			{
+				position = (steps >= position - goal) ? goal : position - (unsigned int)steps;
+				host_set_word(t, PRESENT_SPEED_L, value | 0x400);
+			}
+			t[MOVING] = position != goal;
+			if (position == goal)
+				d->motion_remainder = 0;
+		}
+		host_set_word(t, PRESENT_POSITION_L, position);
+	}
+}
+
+/// \private Internal function to advance the virtual time, firing a pending timeout on the way.
+static void host_wait_until(unsigned long long time_ns)
+{
+	while (host_time_ns < time_ns)
+	{
+		unsigned long long next = time_ns;
+		dxl_hal_callback callback = timeout_callback;
+		if (callback != NULL && host_timeout_ns < next)
+			next = host_timeout_ns > host_time_ns ? host_timeout_ns : host_time_ns;
+		host_update_motion(next - host_time_ns);
+		host_time_ns = next;
+		if (callback != NULL && host_timeout_ns <= host_time_ns)
+		{
+			timeout_callback = NULL;
+			callback();
+		}
+	}
+}
+
+/// \private Internal function to write data to a control table including side effects.
+static unsigned char host_write_table(uint8_t id, const unsigned char * data, unsigned char length)
+{
+	host_device * d = &host_devices[id];
+	unsigned char address = data[0];
+	unsigned char i;
+	if (length < 2 || address + length - 1 > DXL_HAL_HOST_TABLE_SIZE)
+		return ERRBIT_RANGE;
+	for (i = 1; i < length; i++)
+	{
+		unsigned char a = address + i - 1;
+		// Read-only area and model/firmware are not written
+		if (a < HOST_ID || (a >= PRESENT_POSITION_L && a <= MOVING))
+			continue;
+		d->table[a] = data[i];
+		// Writing the goal position enables the torque
+		if (a == GOAL_POSITION_L || a == GOAL_POSITION_H)
+			d->table[TORQUE_ENABLE] = 1;
+	}
+	// Change of id moves the motor on the bus
+	if (d->table[HOST_ID] != id)
+	{
+		uint8_t new_id = d->table[HOST_ID];
+		if (new_id < HOST_DEVICE_AMOUNT && !host_devices[new_id].present)
+		{
+			host_devices[new_id] = *d;
+			d->present = 0;
+		}
+		else
+			d->table[HOST_ID] = id;
+	}
+	return 0;
+}
+
+/// \private Internal function to execute an instruction on a simulated motor.
+/// \returns The number of status packet parameters or -1 if no status packet is sent.
+static int host_execute(uint8_t id, unsigned char instruction, const unsigned char * param, unsigned char num_param,
+	unsigned char * response, unsigned char * error)
+{
+	host_device * d = &host_devices[id];
+	unsigned char level = d->table[HOST_STATUS_RETURN_LEVEL];
+	*error = 0;
+	switch (instruction)
+	{
+		case INST_PING:
+			return 0;
+
+		case INST_READ:
+			if (num_param != 2 || param[0] + param[1] > DXL_HAL_HOST_TABLE_SIZE || param[1] > MAXNUM_RXPARAM)
+			{
+				*error = ERRBIT_RANGE;
+				return level >= 1 ? 0 : -1;
+			}
+			memcpy(response, &d->table[param[0]], param[1]);
+			return level >= 1 ? param[1] : -1;
+
+		case INST_WRITE:
+			*error = host_write_table(id, param, num_param);
+			break;
+
+		case INST_REG_WRITE:
+			if (num_param < 2 || num_param > sizeof(d->reg_data))
+				*error = ERRBIT_RANGE;
+			else
+			{
+				memcpy(d->reg_data, param, num_param);
+				d->reg_length = num_param;
+				d->table[REGISTERED] = 1;
+			}
+			break;
+
+		case INST_ACTION:
+			if (d->reg_length)
+				host_write_table(id, d->reg_data, d->reg_length);
+			d->reg_length = 0;
+			d->table[REGISTERED] = 0;
+			break;
+
+		case INST_RESET:
+			memcpy(d->table, host_default_table, DXL_HAL_HOST_TABLE_SIZE);
+			d->table[HOST_ID] = id;
+			d->reg_length = 0;
+			break;
+
+		default:
+			*error = ERRBIT_INSTRUCTION;
+			break;
+	}
+	return level >= 2 ? 0 : -1;
+}
+
+/// \private Internal function to send a status packet from a simulated motor.
+static void host_respond(uint8_t id, unsigned char error, const unsigned char * param, unsigned char num_param)
+{
+	unsigned char packet[MAXNUM_RXPARAM + 6];
+	unsigned char i, length = num_param + 6, checksum = 0;
+	packet[0] = 0xFF;
+	packet[1] = 0xFF;
+	packet[2] = id;
+	packet[3] = num_param + 2;
+	packet[4] = error;
+	memcpy(&packet[5], param, num_param);
+	for (i = 2; i < length - 1; i++)
+		checksum += packet[i];
+	packet[length - 1] = ~checksum;
+
+	// Wait for the return delay time (2 us per unit)
+	host_wait_until(host_time_ns + host_devices[id].table[HOST_RETURN_DELAY_TIME] * 2000ull);
+	for (i = 0; i < length; i++)
+	{
+		unsigned int next = (host_rx_tail + 1) % DXL_HAL_RX_BUFFER_SIZE;
+		host_wait_until(host_time_ns + host_byte_time_ns);
+		if (next != host_rx_head)
+		{
+			host_rx_buffer[host_rx_tail] = packet[i];
+			host_rx_tail = next;
+		}
+		if (rx_callback != NULL)
+			rx_callback();
+	}
+	host_stats.rx_packets++;
+	host_stats.rx_bytes += length;
+	host_stats.busy_time_us += (uint32_t)(length * host_byte_time_ns / 1000);
+}
+
+/// \private Internal function to deliver one instruction packet to the simulated motors.
+static void host_dispatch(const unsigned char * packet, int length)
+{
+	unsigned char response[MAXNUM_RXPARAM];
+	unsigned char error, checksum = 0;
+	uint8_t id = packet[2];
+	unsigned char instruction = packet[4];
+	const unsigned char * param = &packet[5];
+	unsigned char num_param = packet[3] - 2;
+	int i, num_response;
+
+	for (i = 2; i < length; i++)
+		checksum += packet[i];
+
+	if (id == BROADCAST_ID)
+	{
+		if (checksum != 0xFF)
+			return;
+		if (instruction == INST_SYNC_WRITE)
+		{
+			// Parameters: address, length per motor, then (id, data...) for each motor
+			unsigned char data[DXL_HAL_HOST_TABLE_SIZE + 1];
+			unsigned char block = param[1] + 1;
+			if (num_param < 2 || param[1] > DXL_HAL_HOST_TABLE_SIZE)
+				return;
+			for (i = 2; i + block <= num_param; i += block)
+			{
+				if (param[i] >= HOST_DEVICE_AMOUNT || !host_devices[param[i]].present)
+					continue;
+				data[0] = param[0];
+				memcpy(&data[1], &param[i + 1], param[1]);
+				host_write_table(param[i], data, block);
+			}
+		}
+		else
+		{
+			for (i = 0; i < HOST_DEVICE_AMOUNT; i++)
+				if (host_devices[i].present)
+					host_execute((uint8_t)i, instruction, param, num_param, response, &error);
+		}
+		return;
+	}
+
+	if (id >= HOST_DEVICE_AMOUNT || !host_devices[id].present)
+		return;
+	if (checksum != 0xFF)
+	{
+		host_respond(id, ERRBIT_CHECKSUM, NULL, 0);
+		return;
+	}
+	num_response = host_execute(id, instruction, param, num_param, response, &error);
+	if (num_response >= 0)
+		host_respond(id, error, response, (unsigned char)num_response);
+}
+
+int dxl_hal_open(int devIndex, float baudrate)
+{
+	(void)devIndex;
+	if (baudrate <= 0)
+		return 0;
+	host_byte_time_ns = (unsigned long long)(10000000000.0 / baudrate);
+	host_rx_head = host_rx_tail = 0;
+	host_tx_length = 0;
+	timeout_callback = NULL;
+	return 1;
+}
+
+void dxl_hal_close(void)
+{
+	timeout_callback = NULL;
+}
+
+void dxl_hal_clear(void)
+{
+	host_rx_head = host_rx_tail;
+}
+
+int dxl_hal_tx(const unsigned char *pPacket, int numPacket)
+{
+	unsigned char packet[DXL_HAL_TX_BUFFER_SIZE];
+	int length, start, end;
+
+	if (numPacket > DXL_HAL_TX_BUFFER_SIZE - 1 - host_tx_length)
+		return 0;
+	memcpy(&host_tx_buffer[host_tx_length], pPacket, numPacket);
+	host_tx_length += numPacket;
+	// Bytes queued by a callback are sent by the outer call
+	if (host_tx_busy)
+		return numPacket;
+
+	host_tx_busy = 1;
+	while (host_tx_length > 0)
+	{
+		length = host_tx_length;
+		memcpy(packet, host_tx_buffer, length);
+		host_tx_length = 0;
+
+		host_wait_until(host_time_ns + length * host_byte_time_ns);
+		host_stats.tx_bytes += length;
+		host_stats.busy_time_us += (uint32_t)(length * host_byte_time_ns / 1000);
+		if (tx_callback != NULL)
+			tx_callback();
+
+		// Deliver every complete instruction packet
+		for (start = 0; start + 5 < length; start = end)
+		{
+			if (packet[start] != 0xFF || packet[start + 1] != 0xFF)
+			{
+				end = start + 1;
+				continue;
+			}
+			end = start + packet[start + 3] + 4;
+			if (end > length)
+				break;
+			host_stats.tx_packets++;
+			host_dispatch(&packet[start], end - start);
+		}
+		// Nobody answered: let a pending timeout expire
+		if (host_tx_length == 0 && timeout_callback != NULL)
+			host_wait_until(host_timeout_ns);
+	}
+	host_tx_busy = 0;
+	return numPacket;
+}
+
+int dxl_hal_rx(unsigned char *pPacket, int numPacket)
+{
+	int count = 0;
+	while (count < numPacket && host_rx_head != host_rx_tail)
+	{
+		pPacket[count++] = host_rx_buffer[host_rx_head];
+		host_rx_head = (host_rx_head + 1) % DXL_HAL_RX_BUFFER_SIZE;
+	}
+	return count;
+}
+
+void dxl_hal_set_tx_callback(const dxl_hal_callback callback)
+{
+	tx_callback = callback;
+}
+
+void dxl_hal_set_rx_callback(const dxl_hal_callback callback)
+{
+	rx_callback = callback;
+}
+
+void dxl_hal_set_timeout(uint16_t time_us, const dxl_hal_callback callback)
+{
+	host_timeout_ns = host_time_ns + time_us * 1000ull;
+	timeout_callback = callback;
+}
+
+void dxl_hal_cancel_timeout(void)
+{
+	timeout_callback = NULL;
+}
+
+void dxl_hal_poll(void)
+{
+	// The virtual bus is driven by the calls of the driver, not by interrupts
+}
+
+uint32_t dxl_hal_get_time(void)
+{
+	return (uint32_t)(host_time_ns / 1000);
+}
+
+int dxl_hal_host_add_device(uint8_t id)
+{
+	if (id >= HOST_DEVICE_AMOUNT)
+		return 0;
+	memset(&host_devices[id], 0, sizeof(host_device));
+	memcpy(host_devices[id].table, host_default_table, DXL_HAL_HOST_TABLE_SIZE);
+	host_devices[id].table[HOST_ID] = id;
+	host_devices[id].present = 1;
+	return 1;
+}
+
+void dxl_hal_host_remove_device(uint8_t id)
+{
+	if (id < HOST_DEVICE_AMOUNT)
+		host_devices[id].present = 0;
+}
+
+unsigned char * dxl_hal_host_get_table(uint8_t id)
+{
+	if (id >= HOST_DEVICE_AMOUNT || !host_devices[id].present)
+		return NULL;
+	return host_devices[id].table;
+}
+
+void dxl_hal_host_advance(uint32_t time_us)
+{
+	host_wait_until(host_time_ns + time_us * 1000ull);
+}
+
+void dxl_hal_host_get_stats(dxl_hal_host_stats * stats)
+{
+	if (stats != NULL)
+		*stats = host_stats;
+}
+
+void dxl_hal_host_reset_stats(void)
+{
+	memset(&host_stats, 0, sizeof(host_stats));
+}
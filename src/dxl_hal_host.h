@@ -0,0 +1,92 @@
+/*! \file dxl_hal_host.h
+    \brief Virtual Dynamixel bus for running the bus driver on a Linux host.
+	\author Team Kick-Ass
+	\copyright GNU Public License V3
+	\date 2012
+
+	\file dxl_hal_host.h
+	\details The host implementation of the hardware abstraction layer (dxl_hal_host.c) replaces UART0 of the CM-510 by a
+	virtual half-duplex bus with simulated AX-12 motors. Every byte on the bus advances a virtual clock by its transmission
+	time at the configured baudrate and the simulated motors answer after their configured return delay. Thus
+	throughput and latency of the driver and the motor layer can be measured off-target and deterministically.
+	The simulated motors implement the control table including a simple motion model (goal position, moving speed
+	and wheel mode).
+
+	The driver is built on the host without the AVR specific parts, e.g.:
+\code
+gcc -I include src/dynamixel.c src/dxl_hal_host.c my_program.c
+\endcode
+	The motor layer (motor.c) additionally needs the replacements of the AVR headers in tools/host, see
+	tools/motor_hosttest.c.
+
+	\par Example:
+\code
+dxl_hal_host_add_device(1);
+dxl_initialize(0, 1);
+uint32_t start = dxl_hal_get_time();
+dxl_read_word(1, PRESENT_POSITION_L);
+printf("Read took %lu us.\n", dxl_hal_get_time() - start);
+\endcode
+ */
+#ifndef _DXL_HAL_HOST_HEADER
+#define _DXL_HAL_HOST_HEADER
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Size of the simulated control table in bytes.
+#define DXL_HAL_HOST_TABLE_SIZE		50
+
+/// Bus statistics of the virtual bus.
+typedef struct {
+	/// Number of packets sent by the driver.
+	uint32_t tx_packets;
+	/// Number of bytes sent by the driver.
+	uint32_t tx_bytes;
+	/// Number of status packets sent by the simulated motors.
+	uint32_t rx_packets;
+	/// Number of bytes sent by the simulated motors.
+	uint32_t rx_bytes;
+	/// Time in us the bus was occupied by transmissions.
+	uint32_t busy_time_us;
+} dxl_hal_host_stats;
+
+/** Function to attach a simulated motor to the virtual bus.
+	The control table of the motor is set to the AX-12 factory defaults.
+	\param[in]	id		Id of the motor in the range [0;253].
+	\returns The function returns 1 in case of success and 0 if the id is invalid.
+ */
+int dxl_hal_host_add_device(uint8_t id);
+
+/** Function to detach a simulated motor from the virtual bus.
+	\param[in]	id		Id of the motor.
+ */
+void dxl_hal_host_remove_device(uint8_t id);
+
+/** Function to access the control table of a simulated motor.
+	\param[in]	id		Id of the motor.
+	\returns Pointer to the #DXL_HAL_HOST_TABLE_SIZE bytes of the control table or _NULL_ if no such motor is attached.
+ */
+unsigned char * dxl_hal_host_get_table(uint8_t id);
+
+/** Function to let time pass on the virtual bus without any traffic.
+	\param[in]	time_us		Time in microseconds.
+ */
+void dxl_hal_host_advance(uint32_t time_us);
+
+/** Function to read the bus statistics.
+	\param[out]	stats	Pointer to the statistics to fill.
+ */
+void dxl_hal_host_get_stats(dxl_hal_host_stats * stats);
+
+/// Function to reset the bus statistics.
+void dxl_hal_host_reset_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,650 @@
+/*! \file dynamixel.c
+    \brief Interrupt-driven Dynamixel protocol 1.0 driver (declaration part, see dynamixel.h for an interface description).
+	\author Team Kick-Ass
+	\copyright GNU Public License V3
+	\date 2012
+
+	\file dynamixel.c
+	\details This file replaces the prebuilt Robotis library (libdynamixel.a) and implements the same interface. In contrast
+	to the Robotis implementation the packet transfer is fully interrupt-driven:
+	- _dxl_tx_packet()_ builds the instruction packet, hands it to the transmit ring buffer of the hardware abstraction
+	layer (dxl_hal.h) and returns immediately.
+	- The status packet is assembled byte by byte by a state machine which runs in the receive interrupt. A timer
+	compare match interrupt ends the transaction with _COMM_RXTIMEOUT_ if the motor does not answer in time.
+	- _dxl_rx_packet()_ does not block. It only updates the communication result, which stays _COMM_RXWAITING_ as
+	long as the packet is in flight.
+
+	The blocking functions (_dxl_txrx_packet()_, _dxl_read_word()_, ...) are thin wrappers which wait for the
+	end of the transaction. Background tasks running in interrupt context may share the bus with the main program:
+	they acquire it with _dxl_isr_try_lock()_, start a transaction with _dxl_tx_packet()_ and are notified by the
+	callback registered with _dxl_set_complete_callback()_ when it has ended.
+
+	The driver builds for the CM-510 (dxl_hal.c) and for a Linux host with a virtual bus (dxl_hal_host.c).
+ */
+
+#include <stddef.h>
+#include <string.h>
+#include <dynamixel.h>
+#include "dxl_hal.h"
+
+/// \private Position of the id in a packet.
+#define ID					(2)
+/// \private Position of the length in a packet.
+#define LENGTH				(3)
+/// \private Position of the instruction in an instruction packet.
+#define INSTRUCTION			(4)
+/// \private Position of the error in a status packet.
+#define ERRBIT				(4)
+/// \private Position of the first parameter in a packet.
+#define PARAMETER			(5)
+
+/// \private Additional bytes allowed for the status packet before a timeout occurs.
+#define DXL_TIMEOUT_MARGIN_BYTES	10
+/// \private Additional bytes allowed after the return timeout for the first byte of the status packet.
+#define DXL_START_MARGIN_BYTES		2
+
+/// \private Instruction packet under construction or in flight.
+static unsigned char gbInstructionPacket[MAXNUM_TXPARAM+10] = {0};
+/// \private Last received status packet.
+static volatile unsigned char gbStatusPacket[MAXNUM_RXPARAM+10] = {0};
+/// \private Expected length of the status packet, 0 if no status packet is expected.
+static volatile unsigned char gbRxPacketLength = 0;
+/// \private Number of status packet bytes received so far.
+static volatile unsigned char gbRxGetLength = 0;
+/// \private Result of the last transaction.
+static volatile unsigned char gbCommStatus = COMM_RXSUCCESS;
+/// \private Set as long as a transaction is in flight.
+static volatile unsigned char giBusUsing = 0;
+/// \private Transmission time of one byte in us (including margin).
+static unsigned int gwByteTime_us = 0;
+/// \private Return timeout of the next transaction in us.
+static unsigned int gwNextReturnTimeout_us = DXL_RETURN_TIMEOUT_US;
+/// \private Return timeout of the running transaction in us.
+static unsigned int gwReturnTimeout_us = DXL_RETURN_TIMEOUT_US;
+/// \private Time stamp of the end of the instruction packet in us.
+static volatile uint32_t gdwTxEndTime = 0;
+/// \private Return time of the last transaction in us, 0 if no status packet has arrived.
+static volatile unsigned int gwReturnTime_us = 0;
+/// \private Number of (nested) bus locks of the main program.
+static volatile unsigned char gbLockMain = 0;
+/// \private Set while an interrupt handler holds the bus.
+static volatile unsigned char gbLockIsr = 0;
+/// \private Status return level of each device, two bits per id. Stored as difference to #STATUS_RETURN_ALL, so
+/// that the default of the devices is zero.
+static unsigned char gbStatusReturnLevel[(BROADCAST_ID + 3) / 4] = {0};
+/// \private Callback called whenever a transaction has ended.
+static volatile dxl_complete_callback complete_callback = NULL;
+/// \private Error counters of the devices.
+static volatile dxl_error_counts gErrorCounts[DXL_ERROR_DEVICES];
+/// \private Number of used entries of #gErrorCounts.
+static volatile unsigned char gbErrorDevices = 0;
+
+/// \private Internal function to find the error counters of a device, called with interrupts disabled.
+static volatile dxl_error_counts * dxl_error_entry(unsigned char id)
+{
+	unsigned char i;
+
+	for (i = 0; i < gbErrorDevices; i++)
+		if (gErrorCounts[i].id == id)
+			return &gErrorCounts[i];
+	// The last entry collects the errors of all further devices
+	if (gbErrorDevices == DXL_ERROR_DEVICES)
+		return &gErrorCounts[DXL_ERROR_DEVICES - 1];
+	if (gbErrorDevices == DXL_ERROR_DEVICES - 1)
+		id = BROADCAST_ID;
+	gErrorCounts[gbErrorDevices].id = id;
+	return &gErrorCounts[gbErrorDevices++];
+}
+
+/// \private Internal function to count the errors of the transaction which has just ended, called with interrupts disabled.
+static void dxl_count_errors(unsigned char status)
+{
+	volatile dxl_error_counts *entry;
+	unsigned char errors, i;
+
+	switch (status)
+	{
+		case COMM_RXSUCCESS:
+			// Hot path: nothing to do for a status packet without error bits
+			errors = gbRxPacketLength ? gbStatusPacket[ERRBIT] & 0x7F : 0;
+			if (errors == 0)
+				return;
+			entry = dxl_error_entry(gbInstructionPacket[ID]);
+			for (i = 0; errors; i++, errors >>= 1)
+				if (errors & 1)
+					entry->count[i]++;
+			return;
+		case COMM_TXFAIL:		i = DXL_ERROR_TXFAIL;		break;
+		case COMM_TXERROR:		i = DXL_ERROR_TXERROR;		break;
+		case COMM_RXTIMEOUT:	i = DXL_ERROR_RXTIMEOUT;	break;
+		case COMM_RXCORRUPT:	i = DXL_ERROR_RXCORRUPT;	break;
+		default:
+			return;
+	}
+	dxl_error_entry(gbInstructionPacket[ID])->count[i]++;
+}
+
+/// \private Internal function to reject a transaction which could not be started.
+static void dxl_tx_fail(unsigned char status)
+{
+	gbCommStatus = status;
+	DXL_HAL_ATOMIC
+	{
+		dxl_count_errors(status);
+	}
+}
+
+/// \private Internal function to end the running transaction.
+static void dxl_finish(unsigned char status)
+{
+	dxl_complete_callback callback = complete_callback;
+	dxl_hal_cancel_timeout();
+	dxl_count_errors(status);
+	gbCommStatus = status;
+	giBusUsing = 0;
+	if (callback != NULL)
+		callback();
+}
+
+/// \private Timeout callback, called in interrupt context.
+static void dxl_timeout(void)
+{
+	if (giBusUsing)
+		dxl_finish(gbRxGetLength == 0 ? COMM_RXTIMEOUT : COMM_RXCORRUPT);
+}
+
+/// \private Transmit complete callback, called in interrupt context.
+static void dxl_tx_complete(void)
+{
+	if (!giBusUsing)
+		return;
+	if (gbRxPacketLength == 0)
+		dxl_finish(COMM_RXSUCCESS);		// no status packet expected
+	else
+	{
+		// A device which does not answer at all is detected after the return timeout
+		gdwTxEndTime = dxl_hal_get_time();
+		dxl_hal_set_timeout(gwReturnTimeout_us + DXL_START_MARGIN_BYTES * gwByteTime_us, &dxl_timeout);
+	}
+}
+
+/// \private Status packet state machine, called in interrupt context whenever bytes have been received.
+static void dxl_rx_receive(void)
+{
+	unsigned char data, i, checksum;
+
+	while (dxl_hal_rx(&data, 1) == 1)
+	{
+		// Ignore bytes which do not belong to a transaction
+		if (!giBusUsing || gbRxPacketLength == 0)
+			continue;
+
+		switch (gbRxGetLength)
+		{
+			case 0:
+			case 1:
+				// Header (0xFF 0xFF), skip anything else
+				if (data == 0xFF)
+				{
+					// First byte: measure the return time and allow for the rest of the packet
+					if (gwReturnTime_us == 0)
+					{
+						gwReturnTime_us = (unsigned int)(dxl_hal_get_time() - gdwTxEndTime);
+						dxl_hal_set_timeout((gbRxPacketLength + DXL_TIMEOUT_MARGIN_BYTES) * gwByteTime_us, &dxl_timeout);
+					}
+					gbStatusPacket[gbRxGetLength++] = data;
+				}
+				else
+					gbRxGetLength = 0;
+			break;
+
+			case ID:
+				// Additional header bytes are allowed
+				if (data == 0xFF)
+					break;
+				if (data != gbInstructionPacket[ID])
+				{
+					dxl_finish(COMM_RXCORRUPT);
+					break;
+				}
+				gbStatusPacket[gbRxGetLength++] = data;
+			break;
+
+			case LENGTH:
+				if (data < 2 || data > MAXNUM_RXPARAM + 2)
+				{
+					dxl_finish(COMM_RXCORRUPT);
+					break;
+				}
+				gbStatusPacket[gbRxGetLength++] = data;
+			break;
+
+			default:
+				gbStatusPacket[gbRxGetLength++] = data;
+				// Complete packet received?
+				if (gbRxGetLength == gbStatusPacket[LENGTH] + 4)
+				{
+					checksum = 0;
+					for (i = ID; i < gbRxGetLength; i++)
+						checksum += gbStatusPacket[i];
+					dxl_finish(checksum == 0xFF ? COMM_RXSUCCESS : COMM_RXCORRUPT);
+				}
+			break;
+		}
+	}
+}
+
+int dxl_initialize( int devIndex, int baudnum )
+{
+	float baudrate = 2000000.0f / (float)(baudnum + 1);
+
+	if (dxl_hal_open(devIndex, baudrate) == 0)
+		return 0;
+	// Twelve bit times per byte leave a margin for gaps between bytes
+	gwByteTime_us = (unsigned int)(12000000.0f / baudrate) + 1;
+	dxl_hal_set_tx_callback(&dxl_tx_complete);
+	dxl_hal_set_rx_callback(&dxl_rx_receive);
+
+	gbCommStatus = COMM_RXSUCCESS;
+	giBusUsing = 0;
+	return 1;
+}
+
+void dxl_terminate()
+{
+	dxl_hal_set_tx_callback(NULL);
+	dxl_hal_set_rx_callback(NULL);
+	dxl_hal_close();
+}
+
+void dxl_set_status_return_level( int id, int level )
+{
+	int i;
+
+	if (level < STATUS_RETURN_NONE || level > STATUS_RETURN_ALL)
+		return;
+	if (id == BROADCAST_ID)
+	{
+		for (i = 0; i < BROADCAST_ID; i++)
+			dxl_set_status_return_level(i, level);
+		return;
+	}
+	if (id < 0 || id > BROADCAST_ID)
+		return;
+	gbStatusReturnLevel[id >> 2] &= ~(0x03 << ((id & 0x03) * 2));
+	gbStatusReturnLevel[id >> 2] |= (STATUS_RETURN_ALL - level) << ((id & 0x03) * 2);
+}
+
+int dxl_get_status_return_level( int id )
+{
+	if (id < 0 || id >= BROADCAST_ID)
+		return STATUS_RETURN_ALL;
+	return STATUS_RETURN_ALL - ((gbStatusReturnLevel[id >> 2] >> ((id & 0x03) * 2)) & 0x03);
+}
+
+void dxl_set_complete_callback( dxl_complete_callback callback )
+{
+	DXL_HAL_ATOMIC
+	{
+		complete_callback = callback;
+	}
+}
+
+void dxl_set_return_timeout( unsigned int timeout_us )
+{
+	gwNextReturnTimeout_us = timeout_us;
+}
+
+unsigned int dxl_get_return_time( void )
+{
+	unsigned int time;
+
+	DXL_HAL_ATOMIC
+	{
+		time = gwReturnTime_us;
+	}
+	return time;
+}
+
+int dxl_get_error_counts( int index, dxl_error_counts *counts )
+{
+	int used = 0;
+
+	if (index < 0 || index >= DXL_ERROR_DEVICES)
+		return 0;
+	DXL_HAL_ATOMIC
+	{
+		if (index < gbErrorDevices)
+		{
+			*counts = *(dxl_error_counts *)&gErrorCounts[index];
+			used = 1;
+		}
+	}
+	return used;
+}
+
+void dxl_reset_error_counts( void )
+{
+	DXL_HAL_ATOMIC
+	{
+		gbErrorDevices = 0;
+		memset((void *)gErrorCounts, 0, sizeof(gErrorCounts));
+	}
+}
+
+void dxl_lock( void )
+{
+	DXL_HAL_ATOMIC
+	{
+		gbLockMain++;
+	}
+	// Wait for an interrupt handler to release the bus
+	while (gbLockIsr)
+		dxl_hal_poll();
+	// Wait for a transaction started without lock
+	if (gbLockMain == 1)
+		while (giBusUsing)
+			dxl_hal_poll();
+}
+
+void dxl_unlock( void )
+{
+	DXL_HAL_ATOMIC
+	{
+		if (gbLockMain)
+			gbLockMain--;
+	}
+}
+
+int dxl_isr_try_lock( void )
+{
+	int res = 0;
+	DXL_HAL_ATOMIC
+	{
+		if (!gbLockMain && !gbLockIsr && !giBusUsing)
+		{
+			gbLockIsr = 1;
+			res = 1;
+		}
+	}
+	return res;
+}
+
+void dxl_isr_unlock( void )
+{
+	gbLockIsr = 0;
+}
+
+void dxl_set_txpacket_id( int id )
+{
+	gbInstructionPacket[ID] = (unsigned char)id;
+}
+
+void dxl_set_txpacket_instruction( int instruction )
+{
+	gbInstructionPacket[INSTRUCTION] = (unsigned char)instruction;
+}
+
+void dxl_set_txpacket_parameter( int index, int value )
+{
+	gbInstructionPacket[PARAMETER+index] = (unsigned char)value;
+}
+
+void dxl_set_txpacket_length( int length )
+{
+	gbInstructionPacket[LENGTH] = (unsigned char)length;
+}
+
+int dxl_get_rxpacket_error( int errbit )
+{
+	if (gbStatusPacket[ERRBIT] & (unsigned char)errbit)
+		return 1;
+	return 0;
+}
+
+int dxl_get_rxpacket_length( void )
+{
+	return (int)gbStatusPacket[LENGTH];
+}
+
+int dxl_get_rxpacket_parameter( int index )
+{
+	return (int)gbStatusPacket[PARAMETER+index];
+}
+
+int dxl_makeword( int lowbyte, int highbyte )
+{
+	return ((highbyte & 0xFF) << 8) | (lowbyte & 0xFF);
+}
+
+int dxl_get_lowbyte( int word )
+{
+	return word & 0xFF;
+}
+
+int dxl_get_highbyte( int word )
+{
+	return (word >> 8) & 0xFF;
+}
+
+/// \private Internal function to wait for the end of a transaction which has been started successfully.
+static void dxl_rx_wait(void)
+{
+	if (gbCommStatus != COMM_TXSUCCESS)
+		return;
+	do {
+		dxl_rx_packet();
+	} while (gbCommStatus == COMM_RXWAITING);
+}
+
+/// \private Internal function to hand the finished instruction packet to the transmitter.
+static void dxl_tx_start(void)
+{
+	unsigned char TxNumByte = gbInstructionPacket[LENGTH] + 4;
+
+	// Length of the expected status packet
+	if (gbInstructionPacket[ID] == BROADCAST_ID)
+		gbRxPacketLength = 0;
+	else if (gbInstructionPacket[INSTRUCTION] == INST_READ)
+		gbRxPacketLength = gbInstructionPacket[PARAMETER+1] + 6;
+	else if (gbInstructionPacket[INSTRUCTION] == INST_PING || dxl_get_status_return_level(gbInstructionPacket[ID]) == STATUS_RETURN_ALL)
+		gbRxPacketLength = 6;
+	else
+		gbRxPacketLength = 0;
+
+	gbRxGetLength = 0;
+	gwReturnTime_us = 0;
+	gwReturnTimeout_us = gwNextReturnTimeout_us;
+	gwNextReturnTimeout_us = DXL_RETURN_TIMEOUT_US;
+	gbCommStatus = COMM_TXSUCCESS;
+	giBusUsing = 1;
+	dxl_hal_clear();
+	if (dxl_hal_tx(gbInstructionPacket, TxNumByte) != TxNumByte)
+	{
+		giBusUsing = 0;
+		dxl_tx_fail(COMM_TXFAIL);
+	}
+}
+
+/// \private Internal function to check whether the instruction packet can be sent.
+static int dxl_tx_check(void)
+{
+	if (giBusUsing)
+	{
+		dxl_tx_fail(COMM_TXFAIL);
+		return 0;
+	}
+
+	if (gbInstructionPacket[LENGTH] < 2 || gbInstructionPacket[LENGTH] > (MAXNUM_TXPARAM+2))
+	{
+		dxl_tx_fail(COMM_TXERROR);
+		return 0;
+	}
+
+	switch (gbInstructionPacket[INSTRUCTION])
+	{
+		case INST_PING:
+		case INST_READ:
+		case INST_WRITE:
+		case INST_REG_WRITE:
+		case INST_ACTION:
+		case INST_RESET:
+		case INST_SYNC_WRITE:
+		break;
+
+		default:
+			dxl_tx_fail(COMM_TXERROR);
+			return 0;
+	}
+	return 1;
+}
+
+void dxl_tx_packet( void )
+{
+	unsigned char i, checksum = 0;
+
+	if (!dxl_tx_check())
+		return;
+
+	gbInstructionPacket[0] = 0xFF;
+	gbInstructionPacket[1] = 0xFF;
+	for (i = 0; i < gbInstructionPacket[LENGTH] + 1; i++)
+		checksum += gbInstructionPacket[i+ID];
+	gbInstructionPacket[gbInstructionPacket[LENGTH]+LENGTH] = ~checksum;
+	dxl_tx_start();
+}
+
+void dxl_packet_begin( dxl_packet *packet, int id, int instruction )
+{
+	gbInstructionPacket[0] = 0xFF;
+	gbInstructionPacket[1] = 0xFF;
+	gbInstructionPacket[ID] = (unsigned char)id;
+	gbInstructionPacket[INSTRUCTION] = (unsigned char)instruction;
+	packet->cursor = &gbInstructionPacket[PARAMETER];
+	packet->checksum = (unsigned char)id + (unsigned char)instruction;
+}
+
+void dxl_packet_tx( dxl_packet *packet )
+{
+	int count = packet->cursor - &gbInstructionPacket[PARAMETER];
+	unsigned char length = (unsigned char)count + 2;
+
+	if (count > MAXNUM_TXPARAM)
+	{
+		dxl_tx_fail(COMM_TXERROR);
+		return;
+	}
+	gbInstructionPacket[LENGTH] = length;
+	if (!dxl_tx_check())
+		return;
+	// The checksum byte follows the last parameter
+	*packet->cursor = ~(unsigned char)(packet->checksum + length);
+	dxl_tx_start();
+}
+
+void dxl_packet_txrx( dxl_packet *packet )
+{
+	dxl_packet_tx(packet);
+	dxl_rx_wait();
+}
+
+void dxl_rx_packet( void )
+{
+	// The status packet is received in interrupt context, only report the state here
+	dxl_hal_poll();
+	DXL_HAL_ATOMIC
+	{
+		if (giBusUsing)
+			gbCommStatus = COMM_RXWAITING;
+	}
+}
+
+void dxl_txrx_packet( void )
+{
+	dxl_tx_packet();
+	dxl_rx_wait();
+}
+
+int dxl_get_result( void )
+{
+	return (int)gbCommStatus;
+}
+
+void dxl_ping( int id )
+{
+	dxl_lock();
+
+	gbInstructionPacket[ID] = (unsigned char)id;
+	gbInstructionPacket[INSTRUCTION] = INST_PING;
+	gbInstructionPacket[LENGTH] = 2;
+
+	dxl_txrx_packet();
+	dxl_unlock();
+}
+
+int dxl_read_byte( int id, int address )
+{
+	int value;
+
+	dxl_lock();
+
+	gbInstructionPacket[ID] = (unsigned char)id;
+	gbInstructionPacket[INSTRUCTION] = INST_READ;
+	gbInstructionPacket[PARAMETER] = (unsigned char)address;
+	gbInstructionPacket[PARAMETER+1] = 1;
+	gbInstructionPacket[LENGTH] = 4;
+
+	dxl_txrx_packet();
+	value = (int)gbStatusPacket[PARAMETER];
+	dxl_unlock();
+
+	return value;
+}
+
+void dxl_write_byte( int id, int address, int value )
+{
+	dxl_lock();
+
+	gbInstructionPacket[ID] = (unsigned char)id;
+	gbInstructionPacket[INSTRUCTION] = INST_WRITE;
+	gbInstructionPacket[PARAMETER] = (unsigned char)address;
+	gbInstructionPacket[PARAMETER+1] = (unsigned char)value;
+	gbInstructionPacket[LENGTH] = 4;
+
+	dxl_txrx_packet();
+	dxl_unlock();
+}
+
+int dxl_read_word( int id, int address )
+{
+	int value;
+
+	dxl_lock();
+
+	gbInstructionPacket[ID] = (unsigned char)id;
+	gbInstructionPacket[INSTRUCTION] = INST_READ;
+	gbInstructionPacket[PARAMETER] = (unsigned char)address;
+	gbInstructionPacket[PARAMETER+1] = 2;
+	gbInstructionPacket[LENGTH] = 4;
+
+	dxl_txrx_packet();
+	value = dxl_makeword((int)gbStatusPacket[PARAMETER], (int)gbStatusPacket[PARAMETER+1]);
+	dxl_unlock();
+
+	return value;
+}
+
+void dxl_write_word( int id, int address, int value )
+{
+	dxl_lock();
+
+	gbInstructionPacket[ID] = (unsigned char)id;
+	gbInstructionPacket[INSTRUCTION] = INST_WRITE;
+	gbInstructionPacket[PARAMETER] = (unsigned char)address;
+	gbInstructionPacket[PARAMETER+1] = (unsigned char)dxl_get_lowbyte(value);
+	gbInstructionPacket[PARAMETER+2] = (unsigned char)dxl_get_highbyte(value);
+	gbInstructionPacket[LENGTH] = 5;
+
+	dxl_txrx_packet();
+	dxl_unlock();
+}
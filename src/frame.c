@@ -0,0 +1,229 @@
+/*! \file frame.c
+    \brief Binary framed command protocol with CRC-16 for the serial connection (declaration part, see frame.h for an interface description).
+ */
+
+#include <stddef.h>
+#include <string.h>
+#include "frame.h"
+
+/// \private Maximum number of bytes of a frame before encoding.
+#define FRAME_MAX_RAW			(FRAME_MAX_PAYLOAD + FRAME_OVERHEAD)
+
+/// \private Position of the request id in a frame.
+#define FRAME_REQUEST_ID		0
+/// \private Position of the command in a frame.
+#define FRAME_COMMAND			1
+/// \private Position of the payload in a frame.
+#define FRAME_PAYLOAD			2
+
+/// \private Function to read the received bytes.
+static frame_read_function frame_read = NULL;
+/// \private Function to send the replies.
+static frame_write_function frame_write = NULL;
+/// \private Handler to read values.
+static frame_get_handler frame_get = NULL;
+/// \private Handler to write values.
+static frame_set_handler frame_set = NULL;
+/// \private Receiver of the requests.
+static frame_decoder frame_receiver;
+
+uint16_t frame_crc16(const uint8_t * data, const uint8_t length)
+{
+	uint16_t crc = 0xFFFF;
+	uint8_t i, bit;
+	for (i = 0; i < length; i++)
+	{
+		crc ^= (uint16_t)data[i] << 8;
+		for (bit = 0; bit < 8; bit++)
+			crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+	}
+	return crc;
+}
+
+uint8_t frame_encode(const uint8_t request_id, const uint8_t command, const uint8_t * payload, const uint8_t length, uint8_t * buffer)
+{
+	uint8_t raw[FRAME_MAX_RAW];
+	uint8_t size = length + FRAME_OVERHEAD;
+	uint8_t i, out = 1, code;
+	uint16_t crc;
+	if (length > FRAME_MAX_PAYLOAD)
+		return 0;
+	raw[FRAME_REQUEST_ID] = request_id;
+	raw[FRAME_COMMAND] = command;
+	memcpy(&raw[FRAME_PAYLOAD], payload, length);
+	crc = frame_crc16(raw, length + FRAME_PAYLOAD);
+	raw[size - 2] = crc & 0xFF;
+	raw[size - 1] = crc >> 8;
+	// COBS: each block starts with the distance to the next zero byte, which is left out
+	buffer[0] = FRAME_DELIMITER;
+	code = out++;
+	buffer[code] = 1;
+	for (i = 0; i < size; i++)
+	{
+		if (raw[i] != 0)
+		{
+			buffer[out++] = raw[i];
+			buffer[code]++;
+		}
+		if (raw[i] == 0 || buffer[code] == 0xFF)
+		{
+			code = out++;
+			buffer[code] = 1;
+		}
+	}
+	buffer[out++] = FRAME_DELIMITER;
+	return out;
+}
+
+void frame_decoder_init(frame_decoder * decoder)
+{
+	decoder->length = 0;
+	decoder->overflow = 0;
+	decoder->errors = 0;
+}
+
+/// \private Function to decode a COBS encoded frame in place, returns the decoded length or 0 if it is invalid.
+static uint8_t frame_decode(uint8_t * data, const uint8_t length)
+{
+	uint8_t in = 0, out = 0, code, i;
+	while (in < length)
+	{
+		code = data[in++];
+		if (in + code - 1 > length)
+			return 0;
+		for (i = 1; i < code; i++)
+			data[out++] = data[in++];
+		// A full block is not followed by a zero, neither is the last block
+		if (code < 0xFF && in < length)
+			data[out++] = 0;
+	}
+	return out;
+}
+
+uint8_t frame_decoder_put(frame_decoder * decoder, const uint8_t value)
+{
+	uint8_t length;
+	if (value != FRAME_DELIMITER)
+	{
+		if (decoder->length < sizeof(decoder->data))
+			decoder->data[decoder->length++] = value;
+		else
+			decoder->overflow = 1;
+		return 0;
+	}
+	length = decoder->length;
+	decoder->length = 0;
+	// Nothing between two delimiters
+	if (length == 0 && !decoder->overflow)
+		return 0;
+	if (!decoder->overflow)
+		length = frame_decode(decoder->data, length);
+	else
+		length = 0;
+	decoder->overflow = 0;
+	if (length < FRAME_OVERHEAD || length > FRAME_MAX_RAW
+		|| frame_crc16(decoder->data, length - 2) != (decoder->data[length - 2] | ((uint16_t)decoder->data[length - 1] << 8)))
+	{
+		decoder->errors++;
+		return 0;
+	}
+	return length - 2;
+}
+
+void frame_init(const frame_read_function read, const frame_write_function write, const frame_get_handler get, const frame_set_handler set)
+{
+	frame_read = read;
+	frame_write = write;
+	frame_get = get;
+	frame_set = set;
+	frame_decoder_init(&frame_receiver);
+}
+
+/// \private Function to execute a request, returns the length of the reply payload.
+static uint8_t frame_execute(const uint8_t command, const uint8_t * request, const uint8_t length, uint8_t * reply)
+{
+	uint8_t status = FRAME_STATUS_OK, count = 0, i;
+	int16_t value;
+	switch (command)
+	{
+		case FRAME_COMMAND_PING:
+			if (length > FRAME_MAX_PAYLOAD - 1)
+			{
+				reply[0] = FRAME_STATUS_LENGTH;
+				return 1;
+			}
+			memcpy(&reply[1], request, length);
+			reply[0] = FRAME_STATUS_OK;
+			return length + 1;
+
+		case FRAME_COMMAND_GET:
+			if (length > FRAME_MAX_GET)
+				status = FRAME_STATUS_LENGTH;
+			for (i = 0; i < length && status == FRAME_STATUS_OK; i++)
+			{
+				status = frame_get != NULL ? frame_get(request[i], &value) : FRAME_STATUS_UNKNOWN;
+				if (status == FRAME_STATUS_OK)
+				{
+					reply[2 + 2 * count] = (uint16_t)value & 0xFF;
+					reply[3 + 2 * count] = (uint16_t)value >> 8;
+					count++;
+				}
+			}
+			reply[0] = status;
+			reply[1] = count;
+			return 2 + 2 * count;
+
+		case FRAME_COMMAND_SET:
+			if (length % 3 != 0)
+				status = FRAME_STATUS_LENGTH;
+			for (i = 0; i < length && status == FRAME_STATUS_OK; i += 3)
+			{
+				value = (int16_t)(request[i + 1] | ((uint16_t)request[i + 2] << 8));
+				status = frame_set != NULL ? frame_set(request[i], value) : FRAME_STATUS_READ_ONLY;
+				if (status == FRAME_STATUS_OK)
+					count++;
+			}
+			reply[0] = status;
+			reply[1] = count;
+			return 2;
+
+		default:
+			reply[0] = FRAME_STATUS_COMMAND;
+			return 1;
+	}
+}
+
+uint8_t frame_poll(void)
+{
+	unsigned char received[16];
+	uint8_t reply[FRAME_MAX_PAYLOAD];
+	uint8_t encoded[FRAME_MAX_ENCODED];
+	uint8_t count, i, length, executed = 0;
+	if (frame_read == NULL)
+		return 0;
+	// Read until the receive buffer is empty, the link is much slower than the decoding
+	do
+	{
+		count = frame_read(received, sizeof(received));
+		for (i = 0; i < count; i++)
+		{
+			length = frame_decoder_put(&frame_receiver, received[i]);
+			// Replies are not executed, e.g. if two devices are connected
+			if (length == 0 || (frame_receiver.data[FRAME_COMMAND] & FRAME_REPLY))
+				continue;
+			length = frame_execute(frame_receiver.data[FRAME_COMMAND], &frame_receiver.data[FRAME_PAYLOAD],
+				length - FRAME_PAYLOAD, reply);
+			length = frame_encode(frame_receiver.data[FRAME_REQUEST_ID], frame_receiver.data[FRAME_COMMAND] | FRAME_REPLY,
+				reply, length, encoded);
+			if (frame_write != NULL)
+				frame_write(encoded, length);
+			executed++;
+		}
+	} while (count == sizeof(received));
+	return executed;
+}
+
+uint16_t frame_get_errors(void)
+{
+	return frame_receiver.errors;
+}
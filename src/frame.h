@@ -0,0 +1,200 @@
+/*! \file frame.h
+    \brief Binary framed command protocol with CRC-16 for the serial connection.
+	\author Team Kick-Ass
+	\copyright GNU Public License V3
+	\date 2012
+
+	\file frame.h
+	\details This file implements a compact binary protocol to read and write values of an application over the serial
+	connection. Several values are read (#FRAME_COMMAND_GET) or written (#FRAME_COMMAND_SET) with one request, so a
+	state dump or a parameter change costs one round trip instead of one per value.
+
+	A frame consists of the request id, the command, up to #FRAME_MAX_PAYLOAD bytes of payload and the CRC-16 (CCITT,
+	polynomial 0x1021, initial value 0xFFFF, little endian) of all these bytes. It is encoded with Consistent Overhead
+	Byte Stuffing (COBS), so it contains no zero bytes, and is enclosed by two #FRAME_DELIMITER bytes. Thus a receiver
+	synchronizes on the next delimiter after a lost byte, and text printed in between is discarded as an invalid frame.
+	Values are signed 16 bit integers in little endian byte order and are addressed by an 8 bit id defined by the
+	application.
+
+	The device answers each valid request with a frame of the same request id and the command or'ed with #FRAME_REPLY.
+	Its payload starts with a status byte (FRAME_STATUS_*):
+	- #FRAME_COMMAND_PING: The request payload may be up to #FRAME_MAX_PAYLOAD - 1 bytes, the reply contains the status
+	and the same bytes.
+	- #FRAME_COMMAND_GET: The request payload contains up to #FRAME_MAX_GET value ids, the reply contains the status,
+	the number _n_ of values read and the _n_ values.
+	- #FRAME_COMMAND_SET: The request payload contains up to #FRAME_MAX_SET pairs of value id and value, the reply
+	contains the status and the number _n_ of values written.
+	- #FRAME_COMMAND_TELEMETRY: There is no request, the device sends the records of its telemetry stream as replies
+	with request id 0 (see telemetry.h).
+	- #FRAME_COMMAND_LOG: There is no request, the device sends its log messages as replies with request id 0 (see
+	log.h).
+
+	The values are read or written in the given order up to the first one which fails, the status tells why it failed.
+
+	The encoding functions are free of hardware dependencies and are shared by the firmware and the Linux client
+	(tools/frame_client.h). On the robot the received bytes are handed to #frame_poll from the main loop, which calls the
+	handlers of the application and sends the replies.
+
+	\par Example:
+\code
+uint8_t value_get(const uint8_t id, int16_t * value)
+{
+	if (id != 1)
+		return FRAME_STATUS_UNKNOWN;
+	*value = sensor_read(1, SENSOR_IR);
+	return FRAME_STATUS_OK;
+}
+
+frame_init(&serial_read, &serial_write, &value_get, NULL);
+while (1)
+{
+	frame_poll();
+	// ...
+}
+\endcode
+ */
+#ifndef _FRAME_HEADER
+#define _FRAME_HEADER
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Byte which encloses the encoded frames.
+#define FRAME_DELIMITER			0x00
+/// Maximum number of payload bytes of a frame.
+#define FRAME_MAX_PAYLOAD		64
+/// Number of bytes of a frame besides the payload (request id, command and CRC).
+#define FRAME_OVERHEAD			4
+/// Maximum number of bytes of an encoded frame including both delimiters.
+#define FRAME_MAX_ENCODED		(FRAME_MAX_PAYLOAD + FRAME_OVERHEAD + (FRAME_MAX_PAYLOAD + FRAME_OVERHEAD) / 254 + 3)
+/// Maximum number of values read by one #FRAME_COMMAND_GET request.
+#define FRAME_MAX_GET			((FRAME_MAX_PAYLOAD - 2) / 2)
+/// Maximum number of values written by one #FRAME_COMMAND_SET request.
+#define FRAME_MAX_SET			(FRAME_MAX_PAYLOAD / 3)
+
+/// Command to test the connection, the payload is sent back.
+#define FRAME_COMMAND_PING		0x01
+/// Command to read values.
+#define FRAME_COMMAND_GET		0x02
+/// Command to write values.
+#define FRAME_COMMAND_SET		0x03
+/// Command of the records of the telemetry stream (see telemetry.h), the device sends them as replies without request.
+#define FRAME_COMMAND_TELEMETRY	0x04
+/// Command of the messages of the tokenized logging (see log.h), the device sends them as replies without request.
+#define FRAME_COMMAND_LOG		0x05
+/// Flag of the command of a reply.
+#define FRAME_REPLY				0x80
+
+/// Status: the request has been executed.
+#define FRAME_STATUS_OK			0
+/// Status: the value id is unknown.
+#define FRAME_STATUS_UNKNOWN	1
+/// Status: the value can not be written.
+#define FRAME_STATUS_READ_ONLY	2
+/// Status: the value is out of range.
+#define FRAME_STATUS_RANGE		3
+/// Status: the payload has an invalid length.
+#define FRAME_STATUS_LENGTH		4
+/// Status: the command is unknown.
+#define FRAME_STATUS_COMMAND	5
+
+/// Receiver state of the frames, see #frame_decoder_put.
+typedef struct {
+	/// Number of bytes received since the last delimiter.
+	uint8_t length;
+	/// Set if the current frame is too long, it is discarded at the next delimiter.
+	uint8_t overflow;
+	/// Number of invalid frames (too long, bad encoding or CRC).
+	uint16_t errors;
+	/// Received bytes, a valid frame is decoded in place.
+	uint8_t data[FRAME_MAX_ENCODED];
+} frame_decoder;
+
+/** Function definition to read the serial connection.
+	\param[out]	data		Buffer for the received bytes.
+	\param[in]	length		Size of the buffer.
+	\returns The number of received bytes, without waiting.
+ */
+typedef unsigned char (*frame_read_function)(unsigned char * data, int length);
+
+/** Function definition to write the serial connection.
+	\param[in]	data		Bytes to send.
+	\param[in]	length		Number of bytes to send.
+	\returns The number of bytes sent.
+ */
+typedef int (*frame_write_function)(const unsigned char * data, int length);
+
+/** Handler function definition to read a value of the application.
+	\param[in]	id			Id of the value.
+	\param[out]	value		The value.
+	\returns One of the FRAME_STATUS_* values, #FRAME_STATUS_OK in case of success.
+ */
+typedef uint8_t (*frame_get_handler)(const uint8_t id, int16_t * value);
+
+/** Handler function definition to write a value of the application.
+	\param[in]	id			Id of the value.
+	\param[in]	value		The new value.
+	\returns One of the FRAME_STATUS_* values, #FRAME_STATUS_OK in case of success.
+ */
+typedef uint8_t (*frame_set_handler)(const uint8_t id, const int16_t value);
+
+/** Function to calculate the CRC-16 (CCITT) of a frame.
+	\param[in]	data		Bytes of the frame.
+	\param[in]	length		Number of bytes.
+	\returns The CRC.
+ */
+uint16_t frame_crc16(const uint8_t * data, const uint8_t length);
+
+/** Function to encode a frame.
+	\param[in]	request_id	Request id of the frame.
+	\param[in]	command		Command of the frame.
+	\param[in]	payload		Payload of the frame.
+	\param[in]	length		Number of payload bytes in the range [0:#FRAME_MAX_PAYLOAD].
+	\param[out]	buffer		Buffer of at least #FRAME_MAX_ENCODED bytes for the encoded frame.
+	\returns The number of encoded bytes including both delimiters, 0 if the payload is too long.
+ */
+uint8_t frame_encode(const uint8_t request_id, const uint8_t command, const uint8_t * payload, const uint8_t length, uint8_t * buffer);
+
+/** Function to reset a receiver.
+	\param[out]	decoder		The receiver.
+ */
+void frame_decoder_init(frame_decoder * decoder);
+
+/** Function to pass a received byte to a receiver.
+	If the byte completes a valid frame, the frame is available in _decoder->data_ until the next call: the request
+	id at index 0, the command at index 1 and the payload after it. Invalid frames are counted and discarded.
+	\param[in,out]	decoder		The receiver.
+	\param[in]		value		The received byte.
+	\returns The number of bytes of the completed frame without the CRC, i.e. the payload length plus 2, or 0 if no
+	frame has been completed.
+ */
+uint8_t frame_decoder_put(frame_decoder * decoder, const uint8_t value);
+
+/** Function to set up the device side of the protocol.
+	\param[in]	read		Function to read the received bytes without waiting, e.g. _serial_read()_.
+	\param[in]	write		Function to send the replies, e.g. _serial_write()_.
+	\param[in]	get			Handler to read the values of the application or _NULL_ if none can be read.
+	\param[in]	set			Handler to write the values of the application or _NULL_ if none can be written.
+ */
+void frame_init(const frame_read_function read, const frame_write_function write, const frame_get_handler get, const frame_set_handler set);
+
+/** Function to execute the received requests.
+	This function is to be called regularly from the main loop. It reads all received bytes, calls the handlers
+	for each complete request and sends the replies. The handlers thus run in the context of the main loop.
+	\returns The number of executed requests.
+ */
+uint8_t frame_poll(void);
+
+/** Function to get the number of invalid frames received by #frame_poll.
+	\returns The number of invalid frames since #frame_init.
+ */
+uint16_t frame_get_errors(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
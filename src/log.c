@@ -0,0 +1,32 @@
+/*! \file log.c
+    \brief Tokenized logging which sends message ids and raw arguments instead of formatted text (declaration part, see log.h for an interface description).
+ */
+
+#include <stddef.h>
+#include "log.h"
+
+/// \private Function to send the messages.
+static frame_write_function log_write = NULL;
+
+void log_init(const frame_write_function write)
+{
+	log_write = write;
+}
+
+void log_send(const log_message_id id, const uint8_t count, const int16_t a, const int16_t b, const int16_t c)
+{
+	uint8_t payload[1 + 2 * LOG_MAX_ARGUMENTS];
+	uint8_t encoded[FRAME_MAX_ENCODED];
+	uint8_t length;
+	if (log_write == NULL || count > LOG_MAX_ARGUMENTS)
+		return;
+	payload[0] = (uint8_t)id;
+	payload[1] = a & 0xFF;
+	payload[2] = (uint16_t)a >> 8;
+	payload[3] = b & 0xFF;
+	payload[4] = (uint16_t)b >> 8;
+	payload[5] = c & 0xFF;
+	payload[6] = (uint16_t)c >> 8;
+	length = frame_encode(0, FRAME_COMMAND_LOG | FRAME_REPLY, payload, 1 + 2 * count, encoded);
+	log_write(encoded, length);
+}
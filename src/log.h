@@ -0,0 +1,87 @@
+/*! \file log.h
+    \brief Tokenized logging which sends message ids and raw arguments instead of formatted text.
+	\author Team Kick-Ass
+	\copyright GNU Public License V3
+	\date 2012
+
+	\file log.h
+	\details This file implements a logging layer which replaces _printf()_ for diagnostic messages. The messages are
+	listed once in log_messages.h, which assigns an id to each of them at compile time. At runtime only the id and
+	the raw bytes of the arguments are sent, the formatting is done by the host tool tools/log_decode.c with the
+	format strings of the same list. So neither the format strings nor _vfprintf()_ are linked into the firmware and
+	a log call costs a few bytes on the serial connection instead of a formatted line.
+
+	A message is sent as a frame of the protocol of frame.h with the command #FRAME_COMMAND_LOG and request id 0. Its
+	payload is the message id followed by up to #LOG_MAX_ARGUMENTS arguments as 16 bit integers in little endian byte
+	order. Thus the messages are protected by a CRC and share the connection with replies and the telemetry stream.
+	Messages logged before #log_init or with a _NULL_ write function are discarded.
+
+	\par Example:
+	In log_messages.h:
+\code
+LOG_MESSAGE(LOG_SENSOR_VALUE, "Sensor %d: %u")
+\endcode
+	In the application:
+\code
+log_init(&serial_write);
+LOG2(LOG_SENSOR_VALUE, 1, sensor_read(1, SENSOR_DISTANCE));
+\endcode
+	The messages are printed on the PC with:
+\code
+log_decode -d /dev/ttyUSB0
+\endcode
+ */
+#ifndef _LOG_HEADER
+#define _LOG_HEADER
+
+#include <stdint.h>
+#include "frame.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Maximum number of arguments of a message.
+#define LOG_MAX_ARGUMENTS	3
+
+/// \cond Ignore this part from documentation.
+#define LOG_MESSAGE(name, format)	name,
+/// \endcond
+
+/// Ids of the messages, one for each entry of log_messages.h.
+typedef enum {
+#include "log_messages.h"
+	/// Number of messages.
+	LOG_MESSAGES
+} log_message_id;
+
+#undef LOG_MESSAGE
+
+/// Macro to log a message without arguments.
+#define LOG0(id)			log_send((id), 0, 0, 0, 0)
+/// Macro to log a message with one argument.
+#define LOG1(id, a)			log_send((id), 1, (a), 0, 0)
+/// Macro to log a message with two arguments.
+#define LOG2(id, a, b)		log_send((id), 2, (a), (b), 0)
+/// Macro to log a message with three arguments.
+#define LOG3(id, a, b, c)	log_send((id), 3, (a), (b), (c))
+
+/** Function to set up the logging.
+	\param[in]	write		Function to send the messages, e.g. _serial_write()_, or _NULL_ to discard them.
+ */
+void log_init(const frame_write_function write);
+
+/** Function to send a message, use the LOG0() to LOG3() macros instead.
+	\param[in]	id			Id of the message.
+	\param[in]	count		Number of arguments in the range [0:#LOG_MAX_ARGUMENTS].
+	\param[in]	a			First argument.
+	\param[in]	b			Second argument.
+	\param[in]	c			Third argument.
+ */
+void log_send(const log_message_id id, const uint8_t count, const int16_t a, const int16_t b, const int16_t c);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
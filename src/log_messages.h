@@ -0,0 +1,53 @@
+/*! \file log_messages.h
+    \brief Dictionary of the messages of the tokenized logging.
+	\author Team Kick-Ass
+	\copyright GNU Public License V3
+	\date 2012
+
+	\file log_messages.h
+	\details This file lists all messages of log.h as _LOG_MESSAGE(name, format)_ entries. It has no include guard
+	on purpose: the includer defines #LOG_MESSAGE before each inclusion. The firmware turns the list into the
+	enumeration #log_message_id, so the position of an entry is its id and the format strings are not part of the
+	firmware at all. The decoder tools/log_decode.c turns the same list into a table of the format strings.
+
+	The arguments of a message are 16 bit integers, so the conversions of the formats are limited to _d_, _i_, _u_,
+	_x_, _X_, _o_ and _c_ with optional flags and width. New messages are appended at the end of the list, so the ids
+	of the existing ones are kept and old recordings can still be decoded. The error messages of the motors are in the
+	order of the DXL_ERROR_* classes of the driver, #motor_report_errors adds the class to the first one.
+ */
+
+// Motor errors of the driver per error class, see motor_report_errors()
+LOG_MESSAGE(LOG_MOTOR_ERROR_VOLTAGE, "Motor %u: %u voltage")
+LOG_MESSAGE(LOG_MOTOR_ERROR_ANGLE, "Motor %u: %u angle")
+LOG_MESSAGE(LOG_MOTOR_ERROR_OVERHEAT, "Motor %u: %u overheat")
+LOG_MESSAGE(LOG_MOTOR_ERROR_RANGE, "Motor %u: %u range")
+LOG_MESSAGE(LOG_MOTOR_ERROR_CHECKSUM, "Motor %u: %u checksum")
+LOG_MESSAGE(LOG_MOTOR_ERROR_OVERLOAD, "Motor %u: %u overload")
+LOG_MESSAGE(LOG_MOTOR_ERROR_INSTRUCTION, "Motor %u: %u instruction")
+LOG_MESSAGE(LOG_MOTOR_ERROR_TXFAIL, "Motor %u: %u TXFAIL")
+LOG_MESSAGE(LOG_MOTOR_ERROR_TXERROR, "Motor %u: %u TXERROR")
+LOG_MESSAGE(LOG_MOTOR_ERROR_RXTIMEOUT, "Motor %u: %u RXTIMEOUT")
+LOG_MESSAGE(LOG_MOTOR_ERROR_RXCORRUPT, "Motor %u: %u RXCORRUPT")
+// Communication results, see PrintCommStatus()
+LOG_MESSAGE(LOG_COMM_TXFAIL, "COMM_TXFAIL: Failed transmit instruction packet!")
+LOG_MESSAGE(LOG_COMM_TXERROR, "COMM_TXERROR: Incorrect instruction packet!")
+LOG_MESSAGE(LOG_COMM_RXFAIL, "COMM_RXFAIL: Failed get status packet from device!")
+LOG_MESSAGE(LOG_COMM_RXWAITING, "COMM_RXWAITING: Now receiving status packet!")
+LOG_MESSAGE(LOG_COMM_RXTIMEOUT, "COMM_RXTIMEOUT: There is no status packet!")
+LOG_MESSAGE(LOG_COMM_RXCORRUPT, "COMM_RXCORRUPT: Incorrect status packet!")
+LOG_MESSAGE(LOG_COMM_UNKNOWN, "Unknown error code %d!")
+// Error bits of a status packet, see PrintErrorCode()
+LOG_MESSAGE(LOG_ERRBIT_VOLTAGE, "Input voltage error!")
+LOG_MESSAGE(LOG_ERRBIT_ANGLE, "Angle limit error!")
+LOG_MESSAGE(LOG_ERRBIT_OVERHEAT, "Overheat error!")
+LOG_MESSAGE(LOG_ERRBIT_RANGE, "Out of range error!")
+LOG_MESSAGE(LOG_ERRBIT_CHECKSUM, "Checksum error!")
+LOG_MESSAGE(LOG_ERRBIT_OVERLOAD, "Overload error!")
+LOG_MESSAGE(LOG_ERRBIT_INSTRUCTION, "Instruction code error!")
+// Squid (2-nonwheeled-rob/main.c)
+LOG_MESSAGE(LOG_SQUID_GOING_RIGHT, "Going right, sensor: %d.")
+LOG_MESSAGE(LOG_SQUID_GOING_FORWARD, "Going forward, sensor: %d.")
+LOG_MESSAGE(LOG_SQUID_LEFT_WALL, "Found left wall, sensor: %d.")
+LOG_MESSAGE(LOG_SQUID_RIGHT_WALL, "Found right wall, sensor: %d.")
+LOG_MESSAGE(LOG_SQUID_MOTOR_MISSING, "Motor %d is missing")
+LOG_MESSAGE(LOG_SQUID_LEG_BLOCKED, "Leg of motor %d blocked, stopped.")
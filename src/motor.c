@@ -9,20 +9,1323 @@
 #include "motor.h"
 #include "error.h"
 #include "macro.h"
-#include <stdio.h>
+#include "timer.h"
+#include "dxl_hal.h"
+#include "log.h"
+#include <stddef.h>
+#include <math.h>
+#include <util/atomic.h>
+#include <avr/pgmspace.h>
 #include <util/delay.h>
 
-/// \private Maximal allowed deviation from goal position.
-#define MOTOR_MAX_DEVIATION		10
-/// \private Number of cycles allowed without robot moving.
-#define MOTOR_MAX_CYCLES_WITHOUT_MOVING		20
+/// \private Number of sequence numbers of a movement handle, chosen to never form #MOTOR_MOVE_INVALID.
+#define MOTOR_MOVE_SEQUENCES	((MOTOR_MOVE_INVALID + 1) / MOTOR_MOVE_MAX_GROUPS - 1)
 
-/// \private Delay in ms between motor commands to avoid flooding of serial port.
-#define MOTOR_COMMAND_DELAY		5
+/// \private State of a tracked movement.
+typedef struct {
+	/// Number of motors, 0 if the slot is free.
+	uint8_t size;
+	/// Sequence number of the movement, part of its handle.
+	uint8_t sequence;
+	/// Ids of the motors.
+	uint8_t id[MOTOR_MOVE_MAX_MOTORS];
+	/// Bit i is set as long as motor id[i] is moving.
+	uint16_t moving;
+	/// Time in ms since the movement has been started.
+	uint16_t elapsed;
+	/// Completion callback.
+	motor_move_callback callback;
+} motor_move_state;
 
-/// \private Maximum time in ms to wait for a motor to finish its position
-#define MOTOR_MAX_TIMEOUT		2000ul
+/// \private Moving speed units times ms per position unit, see #MOTOR_SPEED_PER_POSITION_RATE.
+#define MOTOR_SPEED_TIME_PER_POSITION	((uint32_t)(MOTOR_SPEED_PER_POSITION_RATE * 1000.0 + 0.5))
 
+/// \private Maximum number of motors moved by one goal position SYNC_WRITE packet.
+#define MOTOR_SYNC_MOVE_MAX_MOTORS	((MAXNUM_TXPARAM - 2) / 3)
+
+/// \private First control table address of the shadow.
+#define MOTOR_SHADOW_FIRST		TORQUE_ENABLE
+/// \private Number of control table bytes of the shadow.
+#define MOTOR_SHADOW_LENGTH		(PUNCH_H - TORQUE_ENABLE + 1)
+/// \private Mask of the writable bytes of the shadow (#TORQUE_ENABLE to #TORQUE_LIMIT_H and #LOCK to #PUNCH_H).
+#define MOTOR_SHADOW_WRITABLE	(((1ul << (TORQUE_LIMIT_H - MOTOR_SHADOW_FIRST + 1)) - 1) | (7ul << (LOCK - MOTOR_SHADOW_FIRST)))
+/// \private Mask of all error bits of a status packet.
+#define MOTOR_ERRBIT_ALL		(ERRBIT_VOLTAGE | ERRBIT_ANGLE | ERRBIT_OVERHEAT | ERRBIT_RANGE | ERRBIT_CHECKSUM | ERRBIT_OVERLOAD | ERRBIT_INSTRUCTION)
+/// \private Id of an unused shadow entry.
+#define MOTOR_SHADOW_UNUSED		0xFF
+
+/// \private RAM shadow of the writable control table of a motor.
+typedef struct {
+	/// Id of the motor, #MOTOR_SHADOW_UNUSED if the entry is unused.
+	uint8_t id;
+	/// Values of the control table from #MOTOR_SHADOW_FIRST on.
+	uint8_t value[MOTOR_SHADOW_LENGTH];
+	/// Bit i is set if the value of byte i is known.
+	uint32_t valid;
+	/// Bit i is set if byte i has been changed but not been written yet.
+	uint32_t dirty;
+} motor_shadow_entry;
+
+/// \private Shadows of the motors.
+static motor_shadow_entry motor_shadows[MOTOR_SHADOW_MOTORS];
+/// \private Set as soon as the shadows have been initialized.
+static uint8_t motor_shadows_initialized = 0;
+/// \private Control table write statistics.
+static motor_write_stats motor_writes = {0, 0};
+
+/// \private Read policy and return time statistics of a motor.
+typedef struct {
+	/// Id of the motor, #MOTOR_SHADOW_UNUSED if the entry is unused.
+	uint8_t id;
+	/// Timeout and retry settings.
+	motor_read_policy policy;
+	/// Smoothed return time in 1/8 us.
+	uint16_t return_time;
+	/// Smoothed mean deviation of the return time in 1/4 us.
+	uint16_t return_jitter;
+	/// Number of repeated reads.
+	uint16_t retries;
+	/// Number of reads which failed after all retries.
+	uint16_t failures;
+} motor_link_entry;
+
+/// \private Read policies and return time statistics of the motors.
+static motor_link_entry motor_links[MOTOR_LINK_MOTORS];
+/// \private Set as soon as the read policies have been initialized.
+static uint8_t motor_links_initialized = 0;
+/// \private Read policy of the motors without an entry.
+static motor_read_policy motor_default_policy = {DXL_RETURN_TIMEOUT_US, 0};
+
+/// \private Mask for the transaction queue indices.
+#define MOTOR_QUEUE_MASK		(MOTOR_QUEUE_LENGTH - 1)
+/// \private Bus is not used by the background tasks.
+#define MOTOR_BUS_IDLE			0
+/// \private Bus is used by a poll request.
+#define MOTOR_BUS_POLL			1
+/// \private Bus is used by a queued transaction.
+#define MOTOR_BUS_QUEUE			2
+/// \private Bus state: ping of the presence check.
+#define MOTOR_BUS_PRESENCE		3
+/// \private Bus state: setpoints of the trajectory streamer.
+#define MOTOR_BUS_STREAM		4
+/// \private Bus state: wheel speed read of the odometry.
+#define MOTOR_BUS_ODOMETRY		5
+/// \private Bus state: wheel speeds of the differential drive.
+#define MOTOR_BUS_DRIVE			6
+/// \private Bus state: load read of the load monitor.
+#define MOTOR_BUS_LOAD			7
+/// \private Limit of the integral of the speed error of a wheel of the differential drive.
+#define MOTOR_DRIVE_INTEGRAL_LIMIT	4096
+/// \private Mask for the keyframe indices of the trajectory streamer.
+#define MOTOR_STREAM_MASK		(MOTOR_STREAM_KEYFRAMES - 1)
+/// \private Number of control table bytes read by #motor_scan, from #MODEL_NUMBER_L to #RETURN_DELAY_TIME.
+#define MOTOR_SCAN_LENGTH		(RETURN_DELAY_TIME - MODEL_NUMBER_L + 1)
+
+/// \private Tracked movements.
+static volatile motor_move_state motor_moves[MOTOR_MOVE_MAX_GROUPS];
+/// \private Movement of the motor polled next.
+static volatile uint8_t motor_poll_group = 0;
+/// \private Motor polled next within the movement.
+static volatile uint8_t motor_poll_index = 0;
+/// \private Sequence number of the movement of the polled motor.
+static volatile uint8_t motor_poll_sequence = 0;
+/// \private Set while a poll round is in progress.
+static volatile uint8_t motor_poll_round = 0;
+/// \private Time in ms since the last poll round has been started.
+static volatile uint8_t motor_poll_time = 0;
+/// \private Set if the background tasks are running.
+static volatile uint8_t motor_timer_running = 0;
+
+/// \private Transaction queues, one per priority.
+static motor_transaction motor_queue[MOTOR_PRIORITIES][MOTOR_QUEUE_LENGTH];
+/// \private Read positions of the transaction queues.
+static volatile uint8_t motor_queue_head[MOTOR_PRIORITIES];
+/// \private Write positions of the transaction queues.
+static volatile uint8_t motor_queue_tail[MOTOR_PRIORITIES];
+/// \private Statistics of the transaction queues.
+static volatile motor_queue_stats motor_queue_statistics[MOTOR_PRIORITIES];
+/// \private Usage of the bus by the background tasks, one of MOTOR_BUS_*.
+static volatile uint8_t motor_bus_state = MOTOR_BUS_IDLE;
+/// \private Priority of the queued transaction on the bus.
+static volatile uint8_t motor_bus_priority = 0;
+/// \private Start time of the transaction on the bus in us.
+static volatile uint32_t motor_bus_start = 0;
+/// \private Bus time in us used by the background tasks in the current tick.
+static volatile uint16_t motor_bus_used = 0;
+/// \private Bus time in us the background tasks may use per tick.
+static volatile uint16_t motor_bus_budget = MOTOR_BUS_BUDGET_US;
+/// \private Keyframe of a streamed trajectory.
+typedef struct {
+	/// Time in ms, see #motor_stream_time.
+	uint16_t time;
+	/// Position of the motor.
+	uint16_t position;
+} motor_keyframe;
+
+/// \private Trajectory of a streamed motor.
+typedef struct {
+	/// Id of the motor.
+	uint8_t id;
+	/// Ring buffer of the keyframes.
+	motor_keyframe keyframe[MOTOR_STREAM_KEYFRAMES];
+	/// Index of the keyframe the current segment starts with, only changed by the streamer.
+	volatile uint8_t head;
+	/// Index of the next free keyframe, only changed by #motor_stream_push.
+	volatile uint8_t tail;
+	/// Set if slope and speed belong to the current segment.
+	uint8_t segment;
+	/// Slope of the current segment in position units per ms (16.16 fixed point).
+	int32_t slope;
+	/// Moving speed of the current segment.
+	uint16_t speed;
+	/// Last goal position sent, 0xFFFF if none has been sent yet.
+	volatile uint16_t setpoint;
+} motor_stream_track;
+
+/// \private Trajectories of the streamed motors.
+static motor_stream_track motor_stream_tracks[MOTOR_STREAM_MAX_MOTORS];
+/// \private Number of streamed motors, 0 if the streamer is stopped.
+static volatile uint8_t motor_stream_size = 0;
+/// \private Time between two setpoints in ms.
+static volatile uint8_t motor_stream_period = 1;
+/// \private Time since the last setpoint in ms.
+static volatile uint8_t motor_stream_elapsed = 0;
+/// \private Set if the setpoints are due.
+static volatile uint8_t motor_stream_due = 0;
+/// \private Time base of the streamer in ms.
+static volatile uint16_t motor_stream_clock = 0;
+
+/// \private Motors found by #motor_scan.
+static volatile motor_info motor_registry[MOTOR_REGISTRY_SIZE];
+/// \private Number of motors in the registry.
+static volatile uint8_t motor_registry_size = 0;
+/// \private Set while the presence check is running.
+static volatile uint8_t motor_presence_enabled = 0;
+/// \private Set if the presence check has not pinged a motor in the current tick yet.
+static volatile uint8_t motor_presence_due = 0;
+/// \private Registry index of the motor pinged next by the presence check.
+static volatile uint8_t motor_presence_index = 0;
+/// \private Presence change callback.
+static volatile motor_presence_callback presence_callback = NULL;
+/// \private Read policy entry of the motor addressed by the transaction of the background tasks.
+static motor_link_entry * volatile motor_bus_link = NULL;
+
+/// \private Quarter of a sine period in 64 steps, scaled by 16384, stored in flash.
+static const int16_t motor_sine_table[65] PROGMEM = {
+	0, 402, 804, 1205, 1606, 2006, 2404, 2801, 3196, 3590, 3981, 4370, 4756, 5139, 5520, 5897,
+	6270, 6639, 7005, 7366, 7723, 8076, 8423, 8765, 9102, 9434, 9760, 10080, 10394, 10702, 11003, 11297,
+	11585, 11866, 12140, 12406, 12665, 12916, 13160, 13395, 13623, 13842, 14053, 14256, 14449, 14635, 14811, 14978,
+	15137, 15286, 15426, 15557, 15679, 15791, 15893, 15986, 16069, 16143, 16207, 16261, 16305, 16340, 16364, 16379,
+	16384
+};
+/// \private Ids of the left and the right wheel of the odometry.
+static uint8_t motor_odometry_id[2];
+/// \private Set while the odometry is running.
+static volatile uint8_t motor_odometry_running = 0;
+/// \private Time between two samples in ms.
+static volatile uint8_t motor_odometry_period = 1;
+/// \private Time since the last sample in ms.
+static volatile uint8_t motor_odometry_elapsed = 0;
+/// \private Number of sample periods which have not been integrated yet.
+static volatile uint8_t motor_odometry_periods = 0;
+/// \private Index of the wheel read next.
+static volatile uint8_t motor_odometry_wheel = 0;
+/// \private Last present speed of the wheels, positive values drive the robot forward.
+static int16_t motor_odometry_speed[2];
+/// \private Travel of a wheel per speed unit and sample in um (16.16 fixed point).
+static uint32_t motor_odometry_scale = 0;
+/// \private Circumference of the circle the wheels drive on when turning on the spot in um.
+static uint32_t motor_odometry_circle = 1;
+/// \private Heading per um of #motor_odometry_turn (16.16 fixed point).
+static uint32_t motor_odometry_angle_scale = 0;
+/// \private Travel of the right wheel minus travel of the left wheel modulo #motor_odometry_circle in um.
+static uint32_t motor_odometry_turn = 0;
+/// \private Integrated pose.
+static volatile motor_pose motor_odometry_pose;
+/// \private Distance between the wheels in mm.
+static uint16_t motor_odometry_track = 0;
+/// \private Set while the differential drive is running.
+static volatile uint8_t motor_drive_running = 0;
+/// \private Set if the wheel speeds of the differential drive are due.
+static volatile uint8_t motor_drive_due = 0;
+/// \private Proportional and integral gain of the speed controller (8.8 fixed point).
+static int16_t motor_drive_gain[2];
+/// \private Speed setpoints of the wheels, positive values drive the robot forward.
+static volatile int16_t motor_drive_target[2];
+/// \private Integrated speed error of the wheels.
+static int16_t motor_drive_integral[2];
+/// \private Moving speeds sent to the wheels, positive values drive the robot forward.
+static int16_t motor_drive_output[2];
+/// \private Highest speed of a wheel in mm/s.
+static uint16_t motor_drive_max_speed = 0;
+/// \private Speed units per mm/s (16.16 fixed point).
+static uint32_t motor_drive_scale = 0;
+
+/// \private Load detector state of a motor watched by the load monitor.
+typedef struct {
+	/// Id of the motor.
+	uint8_t id;
+	/// Last load sample.
+	int16_t load;
+	/// Moving average of the magnitude of the load in 1/8 units, valid if primed is set.
+	uint16_t level;
+	/// Set as soon as the first sample has been taken.
+	uint8_t primed;
+	/// Conditions (MOTOR_LOAD_EVENT_*) of the last sample.
+	uint8_t active;
+	/// Events raised but not fetched yet.
+	volatile uint8_t events;
+} motor_load_entry;
+
+/// \private Motors watched by the load monitor.
+static motor_load_entry motor_load_entries[MOTOR_LOAD_MAX_MOTORS];
+/// \private Number of watched motors, 0 if the load monitor is stopped.
+static volatile uint8_t motor_load_size = 0;
+/// \private Time between two samples in ms.
+static volatile uint8_t motor_load_period = 1;
+/// \private Time since the last sample in ms.
+static volatile uint8_t motor_load_elapsed = 0;
+/// \private Set if a sample is due.
+static volatile uint8_t motor_load_due = 0;
+/// \private Index of the motor read next.
+static volatile uint8_t motor_load_index = 0;
+/// \private Stall threshold, 0 if disabled.
+static uint16_t motor_load_stall = 0;
+/// \private Collision limit in 1/8 units, 0 if disabled.
+static uint16_t motor_load_rise = 0;
+/// \private Event callback of the load monitor.
+static volatile motor_load_callback load_callback = NULL;
+
+/// \private Function to find the read policy entry of a motor, a free entry is assigned if requested.
+static motor_link_entry * motor_link_find(const uint8_t id, const uint8_t assign)
+{
+	uint8_t i;
+	motor_link_entry * free_entry = NULL;
+	if (!motor_links_initialized)
+	{
+		if (!assign)
+			return NULL;
+		for (i = 0; i < MOTOR_LINK_MOTORS; i++)
+			motor_links[i].id = MOTOR_SHADOW_UNUSED;
+		motor_links_initialized = 1;
+	}
+	for (i = 0; i < MOTOR_LINK_MOTORS; i++)
+	{
+		if (motor_links[i].id == id)
+			return &motor_links[i];
+		if (free_entry == NULL && motor_links[i].id == MOTOR_SHADOW_UNUSED)
+			free_entry = &motor_links[i];
+	}
+	if (!assign || free_entry == NULL || id == MOTOR_BROADCAST_ID)
+		return NULL;
+	free_entry->policy = motor_default_policy;
+	free_entry->return_time = 0;
+	free_entry->return_jitter = 0;
+	free_entry->retries = 0;
+	free_entry->failures = 0;
+	free_entry->id = id;
+	return free_entry;
+}
+
+/// \private Function to get the timeout of the next read of a motor.
+static uint16_t motor_link_timeout(const motor_link_entry * link, const motor_read_policy * policy)
+{
+	uint16_t timeout;
+	if (policy->timeout_us != MOTOR_TIMEOUT_ADAPTIVE)
+		return policy->timeout_us;
+	// Nothing learned yet
+	if (link == NULL || link->return_time == 0)
+		return DXL_RETURN_TIMEOUT_US;
+	timeout = (link->return_time >> 3) + link->return_jitter;
+	if (timeout < MOTOR_TIMEOUT_MIN_US)
+		return MOTOR_TIMEOUT_MIN_US;
+	if (timeout > DXL_RETURN_TIMEOUT_US)
+		return DXL_RETURN_TIMEOUT_US;
+	return timeout;
+}
+
+/// \private Function to learn the return time of a motor from the transaction which has just ended.
+static void motor_link_learn(motor_link_entry * link, const int result)
+{
+	int16_t error;
+	uint16_t sample = dxl_get_return_time();
+	if (link == NULL || result != COMM_RXSUCCESS || sample == 0)
+		return;
+	if (sample > 4095)
+		sample = 4095;
+	if (link->return_time == 0)
+	{
+		link->return_time = sample << 3;
+		link->return_jitter = sample << 1;
+		return;
+	}
+	// Smoothing of the return time with gain 1/8 and of its deviation with gain 1/4 (Jacobson)
+	error = (int16_t)sample - (int16_t)(link->return_time >> 3);
+	link->return_time += error;
+	if (error < 0)
+		error = -error;
+	link->return_jitter += error - (int16_t)(link->return_jitter >> 2);
+}
+
+/// \private Function to prepare the return timeout of a transaction of the background tasks.
+static void motor_link_prepare(const uint8_t id)
+{
+	motor_link_entry * link = motor_link_find(id, 0);
+	motor_bus_link = link;
+	dxl_set_return_timeout(motor_link_timeout(link, link != NULL ? &link->policy : &motor_default_policy));
+}
+
+/// \private Function to finish a tracked movement, called with interrupts disabled.
+static void motor_move_finish(const uint8_t group)
+{
+	motor_move_callback callback = motor_moves[group].callback;
+	motor_move_handle handle = group + MOTOR_MOVE_MAX_GROUPS * motor_moves[group].sequence;
+	motor_moves[group].size = 0;
+	motor_moves[group].sequence = (motor_moves[group].sequence + 1) % MOTOR_MOVE_SEQUENCES;
+	if (callback != NULL)
+		callback(handle);
+}
+
+/// \private Function to find the next motor of the poll round, returns 0 if the round is complete.
+static uint8_t motor_poll_find(void)
+{
+	volatile motor_move_state * move;
+	if (!motor_poll_round)
+		return 0;
+	// Find next motor which is still moving
+	for (; motor_poll_group < MOTOR_MOVE_MAX_GROUPS; motor_poll_group++, motor_poll_index = 0)
+	{
+		move = &motor_moves[motor_poll_group];
+		for (; motor_poll_index < move->size; motor_poll_index++)
+			if (move->moving & (1u << motor_poll_index))
+				return 1;
+	}
+	// Round complete
+	motor_poll_round = 0;
+	return 0;
+}
+
+/// \private Function to send the poll request of the motor found by #motor_poll_find.
+static void motor_poll_start(void)
+{
+	volatile motor_move_state * move = &motor_moves[motor_poll_group];
+	dxl_packet packet;
+	dxl_packet_begin(&packet, move->id[motor_poll_index], INST_READ);	//motor to poll
+	dxl_packet_put(&packet, MOVING);					//memory area to read
+	dxl_packet_put(&packet, 1);							//length of the data
+	motor_poll_sequence = move->sequence;
+	motor_link_prepare(move->id[motor_poll_index]);
+	dxl_packet_tx(&packet);
+}
+
+/// \private Function to evaluate the answer of a poll request.
+static void motor_poll_finish(void)
+{
+	volatile motor_move_state * move = &motor_moves[motor_poll_group];
+	// The movement may have timed out meanwhile
+	if (dxl_get_result() == COMM_RXSUCCESS && dxl_get_rxpacket_parameter(0) == 0 && move->size > 0 && move->sequence == motor_poll_sequence)
+	{
+		move->moving &= ~(1u << motor_poll_index);
+		if (move->moving == 0)
+			motor_move_finish(motor_poll_group);
+	}
+	// A motor which did not answer is polled again in the next round
+	motor_poll_index++;
+}
+
+/// \private Function to send the oldest transaction of a queue.
+static void motor_queue_start(const uint8_t priority)
+{
+	motor_transaction * transaction = &motor_queue[priority][motor_queue_head[priority]];
+	dxl_packet packet;
+	uint8_t i;
+	dxl_packet_begin(&packet, transaction->id, transaction->instruction);
+	dxl_packet_put(&packet, transaction->address);		//memory area
+	if (transaction->instruction == INST_READ)
+		dxl_packet_put(&packet, transaction->length);	//length of the data
+	else
+		for (i = 0; i < transaction->length; i++)
+			dxl_packet_put(&packet, transaction->data[i]);	//data
+	motor_link_prepare(transaction->id);
+	dxl_packet_tx(&packet);
+}
+
+/// \private Function to finish the oldest transaction of a queue.
+static void motor_queue_finish(const uint8_t priority)
+{
+	motor_transaction * transaction = &motor_queue[priority][motor_queue_head[priority]];
+	volatile motor_queue_stats * stats = &motor_queue_statistics[priority];
+	uint32_t latency = dxl_hal_get_time() - transaction->queued;
+	uint8_t i;
+	transaction->result = dxl_get_result();
+	if (transaction->instruction == INST_READ && transaction->result == COMM_RXSUCCESS)
+	{
+		if (dxl_get_rxpacket_length() == transaction->length + 2)
+			for (i = 0; i < transaction->length; i++)
+				transaction->data[i] = dxl_get_rxpacket_parameter(i);
+		else
+			transaction->result = COMM_RXCORRUPT;
+	}
+	// Update statistics
+	stats->completed++;
+	stats->latency_sum_us += latency;
+	if (latency > stats->latency_max_us)
+		stats->latency_max_us = latency;
+	stats->depth--;
+	if (transaction->callback != NULL)
+		transaction->callback(transaction);
+	motor_queue_head[priority] = (motor_queue_head[priority] + 1) & MOTOR_QUEUE_MASK;
+}
+
+/// \private Function to check whether any streamed motor has a keyframe.
+static uint8_t motor_stream_ready(void)
+{
+	uint8_t i;
+	for (i = 0; i < motor_stream_size; i++)
+		if (motor_stream_tracks[i].head != motor_stream_tracks[i].tail)
+			return 1;
+	return 0;
+}
+
+/// \private Function to interpolate the setpoint of a streamed motor at the current time.
+static uint16_t motor_stream_interpolate(motor_stream_track * track)
+{
+	uint16_t now = motor_stream_clock;
+	uint8_t next = (track->head + 1) & MOTOR_STREAM_MASK;
+	motor_keyframe * from, * to;
+	uint16_t distance, duration;
+	uint32_t speed;
+	int16_t elapsed;
+	// Go to the segment containing the current time
+	while (next != track->tail && (int16_t)(track->keyframe[next].time - now) <= 0)
+	{
+		track->head = next;
+		track->segment = 0;
+		next = (next + 1) & MOTOR_STREAM_MASK;
+	}
+	from = &track->keyframe[track->head];
+	elapsed = (int16_t)(now - from->time);
+	// Hold the position before the first and after the last keyframe
+	if (next == track->tail || elapsed < 0)
+		return from->position;
+	to = &track->keyframe[next];
+	// Slope and speed only change with the segment, the division is done once per segment
+	if (!track->segment)
+	{
+		duration = to->time - from->time;
+		track->slope = ((int32_t)to->position - (int32_t)from->position) * 65536 / duration;
+		distance = to->position > from->position ? to->position - from->position : from->position - to->position;
+		speed = (distance * (MOTOR_SPEED_TIME_PER_POSITION * MOTOR_STREAM_SPEED_MARGIN / 100) + duration / 2) / duration;
+		// Speed 0 would mean maximum speed
+		track->speed = speed < 1 ? 1 : (speed > MOTOR_MAX_SPEED ? MOTOR_MAX_SPEED : speed);
+		track->segment = 1;
+	}
+	// The product stays below the position difference times 65536 since elapsed < duration
+	return from->position + (int16_t)((track->slope * elapsed) >> 16);
+}
+
+/// \private Function to send the setpoints of the streamed motors.
+static void motor_stream_start_packet(void)
+{
+	motor_stream_track * track;
+	uint16_t position;
+	uint8_t i;
+	dxl_packet packet;
+	motor_stream_due = 0;
+	dxl_packet_begin(&packet, MOTOR_BROADCAST_ID, INST_SYNC_WRITE);	//broadcast sync write
+	dxl_packet_put(&packet, GOAL_POSITION_L);		//memory area to write
+	dxl_packet_put(&packet, 4);						//goal position and moving speed
+	for (i = 0; i < motor_stream_size; i++)
+	{
+		track = &motor_stream_tracks[i];
+		if (track->head == track->tail)
+			continue;
+		position = motor_stream_interpolate(track);
+		track->setpoint = position;
+		dxl_packet_put(&packet, track->id);
+		dxl_packet_put_word(&packet, position);
+		dxl_packet_put_word(&packet, track->speed);
+	}
+	motor_bus_link = NULL;
+	dxl_packet_tx(&packet);
+}
+
+/// \private Function to compute the sine of a binary angle (65536 is a full turn), scaled by 16384.
+static int16_t motor_sine(const uint16_t angle)
+{
+	uint16_t quarter = angle & 0x3FFF;
+	uint8_t index, fraction;
+	int16_t value;
+	// Mirror the second and the fourth quarter onto the first one
+	if (angle & 0x4000)
+		quarter = 0x4000 - quarter;
+	index = quarter >> 8;
+	fraction = quarter & 0xFF;
+	value = (int16_t)pgm_read_word(&motor_sine_table[index]);
+	// Linear interpolation between the table entries
+	if (fraction != 0)
+		value += (int16_t)(((int32_t)((int16_t)pgm_read_word(&motor_sine_table[index + 1]) - value) * fraction) >> 8);
+	return (angle & 0x8000) ? -value : value;
+}
+
+/// \private Function to convert a speed or load value with direction bit 10 to a signed value.
+static int16_t motor_decode_direction(const uint16_t value)
+{
+	// Bit 10 set means clockwise
+	if (value & 0x0400)
+		return -(int16_t)(value & 0x03FF);
+	return (int16_t)(value & 0x03FF);
+}
+
+/// \private Function to convert a present speed of a wheel into its travel per sample in um.
+static int32_t motor_odometry_travel(const int16_t speed)
+{
+	// Integer and fractional part separately, so neither product overflows
+	return speed * (int32_t)(motor_odometry_scale >> 16) + ((speed * (int32_t)(motor_odometry_scale & 0xFFFF) + 0x8000) >> 16);
+}
+
+/// \private Function to integrate the pending sample periods with the last wheel speeds.
+static void motor_odometry_integrate(void)
+{
+	int32_t left = motor_odometry_travel(motor_odometry_speed[0]);
+	int32_t right = motor_odometry_travel(motor_odometry_speed[1]);
+	int32_t forward = (left + right) / 2;
+	int32_t turn;
+	uint16_t heading, middle;
+	// A period missed by a busy bus is bridged with the same speeds
+	for (; motor_odometry_periods > 0; motor_odometry_periods--)
+	{
+		// The heading follows from the turn modulo a full circle, so it is exact and needs no division
+		turn = (int32_t)motor_odometry_turn + right - left;
+		while (turn < 0)
+			turn += motor_odometry_circle;
+		while (turn >= (int32_t)motor_odometry_circle)
+			turn -= motor_odometry_circle;
+		motor_odometry_turn = turn;
+		heading = (uint16_t)(((uint32_t)turn * motor_odometry_angle_scale) >> 16);
+		// Move along the heading in the middle of the sample (the travel is below 2^17 um, the product fits)
+		middle = motor_odometry_pose.heading + (int16_t)(heading - motor_odometry_pose.heading) / 2;
+		motor_odometry_pose.x += (forward * motor_sine(middle + 0x4000) + 0x2000) >> 14;
+		motor_odometry_pose.y += (forward * motor_sine(middle) + 0x2000) >> 14;
+		motor_odometry_pose.heading = heading;
+		motor_odometry_pose.samples++;
+	}
+}
+
+/// \private Function to compute the moving speeds of the differential drive from the last wheel speeds.
+static void motor_drive_update(void)
+{
+	int16_t target, error;
+	int32_t output;
+	uint8_t wheel;
+	for (wheel = 0; wheel < 2; wheel++)
+	{
+		target = motor_drive_target[wheel];
+		// Stop without creeping
+		if (motor_drive_target[0] == 0 && motor_drive_target[1] == 0)
+		{
+			motor_drive_integral[wheel] = 0;
+			motor_drive_output[wheel] = 0;
+			continue;
+		}
+		error = target - motor_odometry_speed[wheel];
+		motor_drive_integral[wheel] += error;
+		if (motor_drive_integral[wheel] > MOTOR_DRIVE_INTEGRAL_LIMIT)
+			motor_drive_integral[wheel] = MOTOR_DRIVE_INTEGRAL_LIMIT;
+		else if (motor_drive_integral[wheel] < -MOTOR_DRIVE_INTEGRAL_LIMIT)
+			motor_drive_integral[wheel] = -MOTOR_DRIVE_INTEGRAL_LIMIT;
+		// The setpoint is fed forward, the controller only corrects the difference
+		output = target + (((int32_t)motor_drive_gain[0] * error + (int32_t)motor_drive_gain[1] * motor_drive_integral[wheel]) >> 8);
+		// Do not wind up while the wheel cannot go faster
+		if (output > MOTOR_MAX_SPEED || output < -MOTOR_MAX_SPEED)
+		{
+			if ((output > 0) == (error > 0))
+				motor_drive_integral[wheel] -= error;
+			output = output > 0 ? MOTOR_MAX_SPEED : -MOTOR_MAX_SPEED;
+		}
+		motor_drive_output[wheel] = (int16_t)output;
+	}
+	motor_drive_due = 1;
+}
+
+/// \private Function to send the moving speeds of both wheels of the differential drive.
+static void motor_drive_start_packet(void)
+{
+	uint8_t wheel;
+	int16_t speed;
+	dxl_packet packet;
+	motor_drive_due = 0;
+	dxl_packet_begin(&packet, MOTOR_BROADCAST_ID, INST_SYNC_WRITE);	//broadcast sync write
+	dxl_packet_put(&packet, MOVING_SPEED_L);		//memory area to write
+	dxl_packet_put(&packet, 2);						//moving speed
+	for (wheel = 0; wheel < 2; wheel++)
+	{
+		// The right wheel is mounted mirrored, bit 10 set means clockwise
+		speed = wheel ? -motor_drive_output[wheel] : motor_drive_output[wheel];
+		dxl_packet_put(&packet, motor_odometry_id[wheel]);
+		dxl_packet_put_word(&packet, speed < 0 ? (uint16_t)(-speed) | 0x0400 : (uint16_t)speed);
+	}
+	motor_bus_link = NULL;
+	dxl_packet_tx(&packet);
+}
+
+/// \private Function to send the speed read of a wheel of the odometry.
+static void motor_odometry_start_read(void)
+{
+	dxl_packet packet;
+	uint8_t id = motor_odometry_id[motor_odometry_wheel];
+	dxl_packet_begin(&packet, id, INST_READ);
+	dxl_packet_put(&packet, PRESENT_SPEED_L);		//memory area
+	dxl_packet_put(&packet, 2);						//length of the data
+	motor_link_prepare(id);
+	dxl_packet_tx(&packet);
+}
+
+/// \private Function to evaluate the answer of a speed read of the odometry.
+static void motor_odometry_finish(void)
+{
+	int16_t speed;
+	if (dxl_get_result() == COMM_RXSUCCESS && dxl_get_rxpacket_length() == 4)
+	{
+		speed = motor_decode_direction(dxl_makeword(dxl_get_rxpacket_parameter(0), dxl_get_rxpacket_parameter(1)));
+		// The right wheel is mounted mirrored
+		motor_odometry_speed[motor_odometry_wheel] = motor_odometry_wheel ? -speed : speed;
+	}
+	else
+		motor_odometry_pose.failures++;
+	if (++motor_odometry_wheel < 2)
+		return;
+	motor_odometry_wheel = 0;
+	motor_odometry_integrate();
+	// The speed controller runs with every sample
+	if (motor_drive_running)
+		motor_drive_update();
+}
+
+/// \private Function to send the load read of a motor watched by the load monitor.
+static void motor_load_start_read(void)
+{
+	dxl_packet packet;
+	uint8_t id = motor_load_entries[motor_load_index].id;
+	dxl_packet_begin(&packet, id, INST_READ);
+	dxl_packet_put(&packet, PRESENT_LOAD_L);		//memory area
+	dxl_packet_put(&packet, 2);						//length of the data
+	motor_link_prepare(id);
+	dxl_packet_tx(&packet);
+}
+
+/// \private Function to evaluate the answer of a load read and run the detectors.
+static void motor_load_finish(void)
+{
+	motor_load_entry * entry = &motor_load_entries[motor_load_index];
+	motor_load_callback callback = load_callback;
+	uint16_t magnitude;
+	uint8_t active = 0, raised;
+	// The monitor may have been stopped meanwhile
+	if (motor_load_index >= motor_load_size)
+		return;
+	if (++motor_load_index >= motor_load_size)
+	{
+		motor_load_index = 0;
+		motor_load_due = 0;
+	}
+	// A motor which did not answer is sampled again in the next period
+	if (dxl_get_result() != COMM_RXSUCCESS || dxl_get_rxpacket_length() != 4)
+		return;
+	entry->load = motor_decode_direction(dxl_makeword(dxl_get_rxpacket_parameter(0), dxl_get_rxpacket_parameter(1)));
+	magnitude = entry->load < 0 ? -entry->load : entry->load;
+	if (!entry->primed)
+	{
+		entry->level = magnitude << 3;
+		entry->primed = 1;
+	}
+	if (motor_load_stall > 0 && magnitude > motor_load_stall)
+		active |= MOTOR_LOAD_EVENT_STALL;
+	// Compare with the level before this sample, so a step is seen at once
+	if (motor_load_rise > 0 && (magnitude << 3) > entry->level + motor_load_rise)
+		active |= MOTOR_LOAD_EVENT_COLLISION;
+	entry->level += magnitude - (entry->level >> 3);
+	// Raise the conditions which have just become true
+	raised = active & ~entry->active;
+	entry->active = active;
+	if (raised)
+	{
+		entry->events |= raised;
+		if (callback != NULL)
+			callback(entry - motor_load_entries, raised);
+	}
+}
+
+/// \private Function to send the ping of the presence check.
+static void motor_presence_start(void)
+{
+	dxl_packet packet;
+	if (motor_presence_index >= motor_registry_size)
+		motor_presence_index = 0;
+	dxl_packet_begin(&packet, motor_registry[motor_presence_index].id, INST_PING);
+	motor_link_prepare(motor_registry[motor_presence_index].id);
+	dxl_packet_tx(&packet);
+	motor_presence_due = 0;
+}
+
+/// \private Function to evaluate the answer of a ping of the presence check.
+static void motor_presence_finish(void)
+{
+	volatile motor_info * info = &motor_registry[motor_presence_index];
+	motor_presence_callback callback = presence_callback;
+	uint8_t present;
+	// The registry may have been cleared meanwhile
+	if (motor_presence_index >= motor_registry_size)
+		return;
+	present = info->present;
+	if (dxl_get_result() == COMM_RXSUCCESS)
+	{
+		info->misses = 0;
+		info->present = 1;
+	}
+	else if (info->misses < 0xFF && ++info->misses >= MOTOR_PRESENCE_MISSES)
+		info->present = 0;
+	if (info->present != present && callback != NULL)
+		callback(info->id, info->present);
+	motor_presence_index++;
+}
+
+/// \private Function to finish the transaction of the background tasks on the bus.
+static void motor_bus_finish(void)
+{
+	uint16_t duration = (uint16_t)(dxl_hal_get_time() - motor_bus_start);
+	motor_bus_used = (motor_bus_used + duration < motor_bus_used) ? 0xFFFF : motor_bus_used + duration;
+	motor_link_learn(motor_bus_link, dxl_get_result());
+	if (motor_bus_state == MOTOR_BUS_POLL)
+		motor_poll_finish();
+	else if (motor_bus_state == MOTOR_BUS_PRESENCE)
+		motor_presence_finish();
+	else if (motor_bus_state == MOTOR_BUS_ODOMETRY)
+		motor_odometry_finish();
+	else if (motor_bus_state == MOTOR_BUS_LOAD)
+		motor_load_finish();
+	else if (motor_bus_state == MOTOR_BUS_QUEUE)
+		motor_queue_finish(motor_bus_priority);
+	motor_bus_state = MOTOR_BUS_IDLE;
+	dxl_isr_unlock();
+}
+
+/// \private Function to start the next transaction of the background tasks, called with interrupts disabled.
+/// The setpoints of the streamer, the wheel speeds of the differential drive, the speed reads of the odometry, the load
+/// reads of the load monitor and the setpoint writes are sent first, then the poll requests of the tracked movements, then the telemetry reads and
+/// finally the ping of the presence check.
+static void motor_bus_next(void)
+{
+	uint8_t priority, state;
+	// Send transactions back-to-back as long as the budget lasts
+	while (motor_bus_state == MOTOR_BUS_IDLE && motor_bus_used < motor_bus_budget)
+	{
+		state = MOTOR_BUS_IDLE;
+		// The setpoints of the streamer come first
+		if (motor_stream_due)
+		{
+			if (motor_stream_ready())
+				state = MOTOR_BUS_STREAM;
+			else
+				motor_stream_due = 0;
+		}
+		if (state == MOTOR_BUS_IDLE && motor_drive_due)
+			state = MOTOR_BUS_DRIVE;
+		// Both wheels of the odometry are read back-to-back
+		if (state == MOTOR_BUS_IDLE && motor_odometry_running && (motor_odometry_periods > 0 || motor_odometry_wheel > 0))
+			state = MOTOR_BUS_ODOMETRY;
+		// All watched motors are read back-to-back
+		if (state == MOTOR_BUS_IDLE && motor_load_due)
+			state = MOTOR_BUS_LOAD;
+		for (priority = 0; priority < MOTOR_PRIORITIES && state == MOTOR_BUS_IDLE; priority++)
+		{
+			if (motor_queue_head[priority] != motor_queue_tail[priority])
+			{
+				state = MOTOR_BUS_QUEUE;
+				motor_bus_priority = priority;
+			}
+			else if (priority == MOTOR_PRIORITY_NORMAL && motor_poll_find())
+				state = MOTOR_BUS_POLL;
+		}
+		if (state == MOTOR_BUS_IDLE && motor_presence_due && motor_registry_size > 0)
+			state = MOTOR_BUS_PRESENCE;
+		// Nothing to do or the main program is using the bus, try again later
+		if (state == MOTOR_BUS_IDLE || !dxl_isr_try_lock())
+			return;
+		motor_bus_state = state;
+		motor_bus_start = dxl_hal_get_time();
+		if (state == MOTOR_BUS_POLL)
+			motor_poll_start();
+		else if (state == MOTOR_BUS_PRESENCE)
+			motor_presence_start();
+		else if (state == MOTOR_BUS_STREAM)
+			motor_stream_start_packet();
+		else if (state == MOTOR_BUS_ODOMETRY)
+			motor_odometry_start_read();
+		else if (state == MOTOR_BUS_DRIVE)
+			motor_drive_start_packet();
+		else if (state == MOTOR_BUS_LOAD)
+			motor_load_start_read();
+		else
+			motor_queue_start(motor_bus_priority);
+		// Transmission failed, finish immediately (the transaction may also have completed already)
+		if (motor_bus_state != MOTOR_BUS_IDLE && (dxl_get_result() == COMM_TXFAIL || dxl_get_result() == COMM_TXERROR))
+			motor_bus_finish();
+	}
+}
+
+/// \private Bus transaction complete callback, called in interrupt context.
+static void motor_bus_complete(void)
+{
+	if (motor_bus_state == MOTOR_BUS_IDLE)
+		return;
+	motor_bus_finish();
+	// Continue immediately with the next transaction
+	motor_bus_next();
+}
+
+/// \private Background task, called every ms with interrupts disabled.
+static void motor_timer_tick(void)
+{
+	uint8_t group;
+	// Finish movements which take too long
+	for (group = 0; group < MOTOR_MOVE_MAX_GROUPS; group++)
+		if (motor_moves[group].size > 0 && ++motor_moves[group].elapsed >= MOTOR_MAX_TIMEOUT)
+			motor_move_finish(group);
+	// Start a new poll round
+	if (motor_poll_time < MOTOR_POLL_INTERVAL)
+		motor_poll_time++;
+	if (!motor_poll_round && motor_poll_time >= MOTOR_POLL_INTERVAL)
+	{
+		motor_poll_time = 0;
+		motor_poll_group = 0;
+		motor_poll_index = 0;
+		motor_poll_round = 1;
+	}
+	// One ping of the presence check per tick
+	motor_presence_due = motor_presence_enabled;
+	// Setpoints of the streamer
+	motor_stream_clock++;
+	if (motor_stream_size > 0 && ++motor_stream_elapsed >= motor_stream_period)
+	{
+		motor_stream_elapsed = 0;
+		motor_stream_due = 1;
+	}
+	// Samples of the odometry
+	if (motor_odometry_running && ++motor_odometry_elapsed >= motor_odometry_period)
+	{
+		motor_odometry_elapsed = 0;
+		if (motor_odometry_periods < 0xFF)
+			motor_odometry_periods++;
+	}
+	// Samples of the load monitor
+	if (motor_load_size > 0 && ++motor_load_elapsed >= motor_load_period)
+	{
+		motor_load_elapsed = 0;
+		motor_load_due = 1;
+	}
+	// New budget for this tick
+	motor_bus_used = 0;
+	motor_bus_next();
+}
+
+int motor_init(void) {
+	dxl_set_complete_callback(&motor_bus_complete);
+	// Background tasks run at 1 kHz
+	timer_set_interrupt(MOTOR_TIMER, TIT_OUTPUT_COMPARE_MATCH_A, &motor_timer_tick);
+	timer_set_value(MOTOR_TIMER, TVT_OUTPUT_COMPARE_A, F_CPU / 64 / 1000 - 1);
+	if (timer_init(MOTOR_TIMER, TOM_CLEAR_ON_COMPARE, TPS_DIV_64, 0) != TIMER_ERROR_SUCCESS)
+		return 0;
+	motor_timer_running = 1;
+	return 1;
+}
+
+/// \private Function to find the shadow of a motor, a free entry is assigned if requested.
+static motor_shadow_entry * motor_shadow_find(const uint8_t id, const uint8_t assign)
+{
+	uint8_t i;
+	motor_shadow_entry * free_entry = NULL;
+	if (!motor_shadows_initialized)
+	{
+		for (i = 0; i < MOTOR_SHADOW_MOTORS; i++)
+			motor_shadows[i].id = MOTOR_SHADOW_UNUSED;
+		motor_shadows_initialized = 1;
+	}
+	for (i = 0; i < MOTOR_SHADOW_MOTORS; i++)
+	{
+		if (motor_shadows[i].id == id)
+			return &motor_shadows[i];
+		if (free_entry == NULL && motor_shadows[i].id == MOTOR_SHADOW_UNUSED)
+			free_entry = &motor_shadows[i];
+	}
+	if (!assign || free_entry == NULL || id == MOTOR_BROADCAST_ID)
+		return NULL;
+	free_entry->id = id;
+	free_entry->valid = 0;
+	free_entry->dirty = 0;
+	return free_entry;
+}
+
+/// \private Function to get the mask of the shadow bytes of a control table range, 0 if the range is not (fully) shadowed.
+static uint32_t motor_shadow_mask(const uint8_t address, const uint8_t length)
+{
+	if (length == 0 || address < MOTOR_SHADOW_FIRST || address + length > MOTOR_SHADOW_FIRST + MOTOR_SHADOW_LENGTH)
+		return 0;
+	return ((1ul << length) - 1) << (address - MOTOR_SHADOW_FIRST);
+}
+
+/// \private Function to store values which have been written to a motor in its shadow.
+static void motor_shadow_update(const uint8_t id, const uint8_t address, const uint8_t * data, const uint8_t length)
+{
+	uint8_t i, j;
+	for (i = 0; i < MOTOR_SHADOW_MOTORS; i++)
+	{
+		motor_shadow_entry * entry = &motor_shadows[i];
+		if (entry->id == MOTOR_SHADOW_UNUSED || (entry->id != id && id != MOTOR_BROADCAST_ID))
+			continue;
+		for (j = 0; j < length; j++)
+		{
+			uint32_t bit = motor_shadow_mask(address + j, 1);
+			if (bit == 0)
+				continue;
+			entry->value[address + j - MOTOR_SHADOW_FIRST] = data[j];
+			entry->valid |= bit;
+			entry->dirty &= ~bit;
+		}
+	}
+}
+
+/// \private Function to send a write packet and update the shadow.
+static int motor_write_packet(const uint8_t id, const uint8_t address, const uint8_t * data, const uint8_t length)
+{
+	uint8_t i;
+	int CommStatus;
+	dxl_packet packet;
+	dxl_lock();
+	dxl_packet_begin(&packet, id, INST_WRITE);		//motor to write
+	dxl_packet_put(&packet, address);				//memory area to write
+	for (i = 0; i < length; i++)
+		dxl_packet_put(&packet, data[i]);			//data
+	dxl_packet_txrx(&packet);						//transmit packet
+	CommStatus = dxl_get_result();
+	// Motors report errors like an overload by changing their control table
+	if (CommStatus == COMM_RXSUCCESS && id != MOTOR_BROADCAST_ID && dxl_get_status_return_level(id) == STATUS_RETURN_ALL
+		&& dxl_get_rxpacket_error(MOTOR_ERRBIT_ALL))
+		motor_shadow_invalidate(id);
+	else if (CommStatus == COMM_RXSUCCESS)
+		motor_shadow_update(id, address, data, length);
+	dxl_unlock();
+	motor_writes.sent++;
+	return CommStatus;
+}
+
+int motor_write(const uint8_t id, const uint8_t address, const uint8_t * data, const uint8_t length) {
+	uint8_t i;
+	uint32_t mask = motor_shadow_mask(address, length);
+	motor_shadow_entry * entry;
+	if (length == 0 || length > MAXNUM_TXPARAM - 1)
+		return COMM_TXERROR;
+	entry = motor_shadow_find(id, mask != 0);
+	// Skip write if all values are known to be set already, only ranges within the shadow are compared
+	if (mask != 0 && entry != NULL && (entry->valid & mask) == mask && (entry->dirty & mask) == 0)
+	{
+		for (i = 0; i < length; i++)
+			if (entry->value[address + i - MOTOR_SHADOW_FIRST] != data[i])
+				break;
+		if (i == length)
+		{
+			motor_writes.suppressed++;
+			return COMM_RXSUCCESS;
+		}
+	}
+	return motor_write_packet(id, address, data, length);
+}
+
+int motor_write_byte(const uint8_t id, const uint8_t address, const uint8_t value) {
+	return motor_write(id, address, &value, 1);
+}
+
+int motor_write_word(const uint8_t id, const uint8_t address, const uint16_t value) {
+	uint8_t data[2];
+	data[0] = dxl_get_lowbyte(value);
+	data[1] = dxl_get_highbyte(value);
+	return motor_write(id, address, data, 2);
+}
+
+int motor_shadow_set(const uint8_t id, const uint8_t address, const uint8_t * data, const uint8_t length) {
+	uint8_t i, changed = 0;
+	uint32_t mask = motor_shadow_mask(address, length);
+	motor_shadow_entry * entry = NULL;
+	// Only writable registers within the shadow can be deferred
+	if (mask != 0 && (mask & MOTOR_SHADOW_WRITABLE) == mask)
+		entry = motor_shadow_find(id, 1);
+	if (entry == NULL)
+		return motor_write(id, address, data, length);
+	for (i = 0; i < length; i++)
+	{
+		uint8_t index = address + i - MOTOR_SHADOW_FIRST;
+		uint32_t bit = 1ul << index;
+		if (!(entry->valid & bit) || entry->value[index] != data[i])
+		{
+			entry->value[index] = data[i];
+			entry->valid |= bit;
+			entry->dirty |= bit;
+			changed = 1;
+		}
+	}
+	if (!changed)
+		motor_writes.suppressed++;
+	return COMM_RXSUCCESS;
+}
+
+int motor_shadow_flush(const uint8_t id) {
+	uint8_t first, last, i;
+	uint8_t data[MOTOR_SHADOW_LENGTH];
+	int CommStatus = COMM_RXSUCCESS;
+	motor_shadow_entry * entry = motor_shadow_find(id, 0);
+	if (entry == NULL)
+		return COMM_RXSUCCESS;
+	while (entry->dirty != 0)
+	{
+		// Find first dirty byte
+		for (first = 0; !(entry->dirty & (1ul << first)); first++);
+		// Extend the packet over clean bytes with known values up to the last dirty byte which can be reached
+		last = first;
+		for (i = first + 1; i < MOTOR_SHADOW_LENGTH; i++)
+		{
+			uint32_t bit = 1ul << i;
+			if (!(entry->valid & MOTOR_SHADOW_WRITABLE & bit))
+				break;
+			if (entry->dirty & bit)
+				last = i;
+		}
+		for (i = first; i <= last; i++)
+			data[i - first] = entry->value[i];
+		// The dirty flags are cleared by a successful write, otherwise the values are unknown
+		CommStatus = motor_write_packet(id, MOTOR_SHADOW_FIRST + first, data, last - first + 1);
+		entry->dirty &= ~motor_shadow_mask(MOTOR_SHADOW_FIRST + first, last - first + 1);
+		if (CommStatus != COMM_RXSUCCESS)
+			entry->valid &= ~motor_shadow_mask(MOTOR_SHADOW_FIRST + first, last - first + 1);
+	}
+	return CommStatus;
+}
+
+void motor_shadow_flush_all(void) {
+	uint8_t i;
+	for (i = 0; i < MOTOR_SHADOW_MOTORS; i++)
+		if (motor_shadows[i].id != MOTOR_SHADOW_UNUSED)
+			motor_shadow_flush(motor_shadows[i].id);
+}
+
+void motor_shadow_invalidate(const uint8_t id) {
+	uint8_t i;
+	for (i = 0; i < MOTOR_SHADOW_MOTORS; i++)
+	{
+		if (motor_shadows[i].id == id || (id == MOTOR_BROADCAST_ID && motor_shadows[i].id != MOTOR_SHADOW_UNUSED))
+		{
+			motor_shadows[i].valid = 0;
+			motor_shadows[i].dirty = 0;
+		}
+	}
+}
+
+int motor_stage_write(const uint8_t id, const uint8_t address, const uint8_t * data, const uint8_t length) {
+	uint8_t i;
+	uint32_t mask = motor_shadow_mask(address, length);
+	int CommStatus;
+	dxl_packet packet;
+	if (length == 0 || length > MAXNUM_TXPARAM - 1)
+		return COMM_TXERROR;
+	dxl_lock();
+	dxl_packet_begin(&packet, id, INST_REG_WRITE);	//motor to stage the write
+	dxl_packet_put(&packet, address);				//memory area to write
+	for (i = 0; i < length; i++)
+		dxl_packet_put(&packet, data[i]);			//data
+	dxl_packet_txrx(&packet);						//transmit packet
+	CommStatus = dxl_get_result();
+	dxl_unlock();
+	motor_writes.sent++;
+	// The values are not known before the commit, a replaced staged write is not applied at all
+	for (i = 0; i < MOTOR_SHADOW_MOTORS; i++)
+		if (motor_shadows[i].id != MOTOR_SHADOW_UNUSED && (motor_shadows[i].id == id || id == MOTOR_BROADCAST_ID))
+			motor_shadows[i].valid &= ~mask;
+	return CommStatus;
+}
+
+int motor_stage_position(const uint8_t id, const uint16_t position) {
+	uint8_t data[2];
+	data[0] = dxl_get_lowbyte(position);
+	data[1] = dxl_get_highbyte(position);
+	return motor_stage_write(id, GOAL_POSITION_L, data, 2);
+}
+
+int motor_stage_position_speed(const uint8_t id, const uint16_t position, const uint16_t speed) {
+	uint8_t data[4];
+	data[0] = dxl_get_lowbyte(position);
+	data[1] = dxl_get_highbyte(position);
+	data[2] = dxl_get_lowbyte(speed);
+	data[3] = dxl_get_highbyte(speed);
+	return motor_stage_write(id, GOAL_POSITION_L, data, 4);
+}
+
+int motor_commit(void) {
+	int CommStatus;
+	dxl_packet packet;
+	dxl_lock();
+	dxl_packet_begin(&packet, MOTOR_BROADCAST_ID, INST_ACTION);	//execute staged writes of all motors
+	dxl_packet_txrx(&packet);
+	CommStatus = dxl_get_result();
+	dxl_unlock();
+	motor_writes.sent++;
+	return CommStatus;
+}
+
+/// \private Function to write an EEPROM byte of a motor unless it already has the value.
+static int motor_write_eeprom(const uint8_t id, const uint8_t address, const uint8_t value) {
+	int present = -1;
+	if (id != MOTOR_BROADCAST_ID) {
+		dxl_lock();
+		present = dxl_read_byte(id, address);
+		if (dxl_get_result() != COMM_RXSUCCESS)
+			present = -1;
+		dxl_unlock();
+	}
+	if (present == value)
+		return COMM_RXSUCCESS;
+	return motor_write_packet(id, address, &value, 1);
+}
+
+int motor_set_status_return_level(const uint8_t id, const uint8_t level) {
+	int CommStatus;
+	if (level > STATUS_RETURN_ALL)
+		return COMM_TXERROR;
+	dxl_lock();
+	// The motor answers the write according to its old or its new level, thus accept a missing answer
+	dxl_set_status_return_level(id, STATUS_RETURN_ALL);
+	CommStatus = motor_write_eeprom(id, STATUS_RETURN_LEVEL, level);
+	if (CommStatus == COMM_RXTIMEOUT) {
+		// A PING is always answered, make sure the motor is there
+		dxl_ping(id);
+		CommStatus = dxl_get_result();
+	}
+	dxl_set_status_return_level(id, level);
+	dxl_unlock();
+	return CommStatus;
+}
+
+int motor_read_status_return_level(const uint8_t id) {
+	int level;
+	dxl_lock();
+	level = dxl_read_byte(id, STATUS_RETURN_LEVEL);
+	if (dxl_get_result() == COMM_RXSUCCESS && level <= STATUS_RETURN_ALL)
+		dxl_set_status_return_level(id, level);
+	else
+		level = -1;
+	dxl_unlock();
+	return level;
+}
+
+int motor_set_return_delay(const uint8_t id, const uint16_t delay_us) {
+	if (delay_us > 508)
+		return COMM_TXERROR;
+	return motor_write_eeprom(id, RETURN_DELAY_TIME, (uint8_t)(delay_us / 2));
+}
+
+void motor_get_write_stats(motor_write_stats * stats) {
+	*stats = motor_writes;
+}
+
+void motor_reset_write_stats(void) {
+	motor_writes.sent = 0;
+	motor_writes.suppressed = 0;
+}
+
+/// \private Function to add a transaction to a queue.
+static int motor_queue_add(const uint8_t id, const uint8_t instruction, const uint8_t address, const uint8_t * data,
+	const uint8_t length, const uint8_t priority, const motor_transaction_callback callback)
+{
+	motor_transaction * transaction;
+	volatile motor_queue_stats * stats;
+	uint8_t i, tail;
+	int res = 0;
+	if (priority >= MOTOR_PRIORITIES || length == 0 || length > MOTOR_QUEUE_MAX_DATA)
+		return 0;
+	dxl_set_complete_callback(&motor_bus_complete);
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		stats = &motor_queue_statistics[priority];
+		tail = motor_queue_tail[priority];
+		if (((tail + 1) & MOTOR_QUEUE_MASK) == motor_queue_head[priority])
+			stats->dropped++;
+		else
+		{
+			transaction = &motor_queue[priority][tail];
+			transaction->id = id;
+			transaction->instruction = instruction;
+			transaction->address = address;
+			transaction->length = length;
+			if (data != NULL)
+				for (i = 0; i < length; i++)
+					transaction->data[i] = data[i];
+			transaction->result = COMM_RXWAITING;
+			transaction->callback = callback;
+			transaction->queued = dxl_hal_get_time();
+			motor_queue_tail[priority] = (tail + 1) & MOTOR_QUEUE_MASK;
+			if (++stats->depth > stats->max_depth)
+				stats->max_depth = stats->depth;
+			res = 1;
+			// Start immediately if the bus is idle
+			if (motor_timer_running)
+				motor_bus_next();
+		}
+	}
+	return res;
+}
+
+int motor_queue_read(const uint8_t id, const uint8_t address, const uint8_t length, const uint8_t priority, const motor_transaction_callback callback) {
+	return motor_queue_add(id, INST_READ, address, NULL, length, priority, callback);
+}
+
+int motor_queue_write(const uint8_t id, const uint8_t address, const uint8_t * data, const uint8_t length, const uint8_t priority, const motor_transaction_callback callback) {
+	uint8_t i;
+	// The values are not known before the write has been executed
+	uint32_t mask = motor_shadow_mask(address, length);
+	for (i = 0; i < MOTOR_SHADOW_MOTORS; i++)
+		if (motor_shadows[i].id != MOTOR_SHADOW_UNUSED && (motor_shadows[i].id == id || id == MOTOR_BROADCAST_ID))
+			motor_shadows[i].valid &= ~mask;
+	return motor_queue_add(id, INST_WRITE, address, data, length, priority, callback);
+}
+
+void motor_set_bus_budget(const uint16_t budget_us) {
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		motor_bus_budget = budget_us;
+	}
+}
+
+void motor_get_queue_stats(const uint8_t priority, motor_queue_stats * stats) {
+	if (priority >= MOTOR_PRIORITIES)
+		return;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		*stats = motor_queue_statistics[priority];
+	}
+}
+
+void motor_reset_queue_stats(void) {
+	uint8_t priority;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		for (priority = 0; priority < MOTOR_PRIORITIES; priority++)
+		{
+			motor_queue_statistics[priority].max_depth = motor_queue_statistics[priority].depth;
+			motor_queue_statistics[priority].completed = 0;
+			motor_queue_statistics[priority].dropped = 0;
+			motor_queue_statistics[priority].latency_sum_us = 0;
+			motor_queue_statistics[priority].latency_max_us = 0;
+		}
+	}
+}
 
 void motor_move(char id, uint16_t motor_position, char blocking) {
 	motor_set_position(id, motor_position, blocking);
@@ -37,7 +1340,7 @@ int motor_get_mode(char id){
 }
 
 void motor_set_speed(char id, int motor_speed){
-	dxl_write_word(id, MOVING_SPEED_L, motor_speed); //set motor speed
+	motor_write_word(id, MOVING_SPEED_L, motor_speed); //set motor speed
 }
 
 void motor_set_speed_dir(char id, uint8_t percentage, char wise){
@@ -45,58 +1348,81 @@ void motor_set_speed_dir(char id, uint8_t percentage, char wise){
 	v = (uint16_t) percentage*1023ul/100ul; //convert percentage to 10 bit value
 	if (wise)
 		SET(v,10);	 //bit 10 is the direction bit 0 ccw, 1 cw
-	dxl_write_word(id, MOVING_SPEED_L, v); //set speed
+	motor_write_word(id, MOVING_SPEED_L, v); //set speed, skipped if unchanged
 }
 
 int motor_get_speed(char id) {
 	return dxl_read_word(id, PRESENT_SPEED_L);	//return speed
 }
 
-void motor_wait_finish(char id, uint16_t goal_position)
-{
-	uint16_t present_pos = 0, diff = MOTOR_MAX_DEVIATION + 1;
-	uint8_t cycles_not_moving = 0;
-	uint16_t timeout = 0;
-	while (diff > MOTOR_MAX_DEVIATION && cycles_not_moving < MOTOR_MAX_CYCLES_WITHOUT_MOVING && timeout < MOTOR_MAX_TIMEOUT)
-	{
-		// Read current position
-		present_pos = dxl_read_word(id, PRESENT_POSITION_L);
-		// Wait to not overload serial motor bus
-		_delay_ms(MOTOR_COMMAND_DELAY);
-		timeout += MOTOR_COMMAND_DELAY;
-		if (dxl_get_result() == COMM_RXSUCCESS)
+motor_move_handle motor_track_move(const uint8_t size, const uint8_t * id, const motor_move_callback callback) {
+	uint8_t group, i;
+	motor_move_handle handle = MOTOR_MOVE_INVALID;
+	if (size == 0 || size > MOTOR_MOVE_MAX_MOTORS)
+		return MOTOR_MOVE_INVALID;
+	dxl_set_complete_callback(&motor_bus_complete);
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		for (group = 0; group < MOTOR_MOVE_MAX_GROUPS; group++)
 		{
-			if (present_pos > goal_position)
-				diff = present_pos - goal_position;
-			else
-				diff = goal_position - present_pos;
-			// Check if motor is not moving for a certain time
-			if (diff <= MOTOR_MAX_DEVIATION)
-				cycles_not_moving++;
-			else
-				cycles_not_moving = 0;
+			if (motor_moves[group].size == 0)
+			{
+				for (i = 0; i < size; i++)
+					motor_moves[group].id[i] = id[i];
+				motor_moves[group].moving = (uint16_t)((1ul << size) - 1);
+				motor_moves[group].elapsed = 0;
+				motor_moves[group].callback = callback;
+				motor_moves[group].size = size;
+				handle = group + MOTOR_MOVE_MAX_GROUPS * motor_moves[group].sequence;
+				break;
+			}
 		}
-	} 
+	}
+	return handle;
 }
 
-void motor_set_position(char id, uint16_t motor_position, char blocking) {
-	dxl_write_word(id, GOAL_POSITION_L, motor_position); //set position
-	int CommStatus = dxl_get_result(); //check communication
-	if (CommStatus == COMM_RXSUCCESS)	{
-		if (blocking == MOTOR_MOVE_BLOCKING) //block until position reached
-			motor_wait_finish(id, motor_position);
+uint8_t motor_move_finished(const motor_move_handle handle) {
+	uint8_t group = handle % MOTOR_MOVE_MAX_GROUPS;
+	if (handle == MOTOR_MOVE_INVALID)
+		return 1;
+	// The sequence number changes as soon as the movement has finished
+	return motor_moves[group].sequence != handle / MOTOR_MOVE_MAX_GROUPS;
+}
+
+void motor_move_wait(const motor_move_handle handle) {
+	while (!motor_move_finished(handle))
+	{
+		if (!motor_timer_running)
+		{
+			// No background tasks, drive them from here
+			_delay_ms(1);
+			ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+			{
+				motor_timer_tick();
+			}
+		}
 	}
-	else
-		PrintCommStatus(CommStatus);//communication failed, print error code
 }
 
-int read_data(char id, char which) {
-	int value=dxl_read_word(id,which);  //read requested data
-	int result=dxl_get_result();		//check communication status
-	if(result==COMM_RXSUCCESS)	//communication succeded
+void motor_wait_finish(char id, uint16_t goal_position)
+{
+	uint8_t motor = (uint8_t)id;
+	(void)goal_position;
+	motor_move_wait(motor_track_move(1, &motor, NULL));
+}
+
+void motor_set_position(char id, uint16_t motor_position, char blocking) {
+	int CommStatus = motor_write_word(id, GOAL_POSITION_L, motor_position); //set position
+	if (CommStatus == COMM_RXSUCCESS && blocking == MOTOR_MOVE_BLOCKING) //block until position reached
+		motor_wait_finish(id, motor_position);
+}
+
+/// \private Function to read a word, returns #MOTOR_READ_ERROR if the motor did not answer.
+static int read_data(char id, char which) {
+	uint16_t value;
+	if (motor_read_word(id, which, &value) == COMM_RXSUCCESS)	//communication succeded
 		return value;			//return read value
-	PrintCommStatus(result);		//communication failed, print error message
-	return 5000;				//return dummy value
+	return MOTOR_READ_ERROR;
 }
 
 
@@ -104,35 +1430,629 @@ uint16_t motor_get_position(char id) {
 	return (uint16_t)read_data(id, PRESENT_POSITION_L); //return current position
 }
 
-void motor_sync_move(const uint8_t size, const uint8_t * id, const uint16_t * position, const char blocking) {
+int motor_sync_write(const uint8_t start_address, const uint8_t bytes_per_motor, const uint8_t size, const uint8_t * id, const uint8_t * data) {
+	uint8_t first, count, i, j;
+	uint8_t motors_per_packet;
+	int CommStatus = COMM_RXSUCCESS;
+	const uint8_t * motor_data;
+	dxl_packet packet;
+	if (bytes_per_motor == 0 || bytes_per_motor > MAXNUM_TXPARAM - 3)
+		return COMM_TXERROR;
+	// Each motor needs its id and data, the packet starts with address and length
+	motors_per_packet = (MAXNUM_TXPARAM - 2) / (bytes_per_motor + 1);
+	for (first = 0; first < size; first += count) {
+		count = size - first;
+		if (count > motors_per_packet)
+			count = motors_per_packet;
+		motor_data = &data[first * bytes_per_motor];
+		dxl_lock();
+		dxl_packet_begin(&packet, MOTOR_BROADCAST_ID, INST_SYNC_WRITE);	//broadcast sync write
+		dxl_packet_put(&packet, start_address);			//memory area to write
+		dxl_packet_put(&packet, bytes_per_motor);		//length of the data
+		for (i = 0; i < count; i++) {
+			dxl_packet_put(&packet, id[first + i]);		//id
+			for (j = 0; j < bytes_per_motor; j++)
+				dxl_packet_put(&packet, *motor_data++);	//data
+		}
+		dxl_packet_txrx(&packet);	//transmit packet
+		CommStatus = dxl_get_result();	//get transmission state
+		dxl_unlock();
+		motor_writes.sent++;
+		if (CommStatus != COMM_RXSUCCESS)
+			break;
+		for (i = 0; i < count; i++)
+			motor_shadow_update(id[first + i], start_address, &data[(first + i) * bytes_per_motor], bytes_per_motor);	//remember written values
+	}
+	return CommStatus;
+}
+
+/// \private Function to send the goal positions of several motors at the same time.
+static int motor_sync_write_position(const uint8_t size, const uint8_t * id, const uint16_t * position) {
 	int i, CommStatus;
-	dxl_set_txpacket_id(MOTOR_BROADCAST_ID);		//set broadcast id 
-	dxl_set_txpacket_instruction(INST_SYNC_WRITE);	//set instruction type
-	dxl_set_txpacket_parameter(0, GOAL_POSITION_L); //memory area to write
-	dxl_set_txpacket_parameter(1, 2); //length of the data
-	
+	uint8_t data[2 * MOTOR_SYNC_MOVE_MAX_MOTORS];
+	if (size > MOTOR_SYNC_MOVE_MAX_MOTORS)
+		return 0;
 	for(i=0;i<size;i++){
-		dxl_set_txpacket_parameter(2+(3*i), id[i]);  //id
-		dxl_set_txpacket_parameter(2+(3*i)+1, dxl_get_lowbyte(position[i]));//low byte
-		dxl_set_txpacket_parameter(2+(3*i)+2, dxl_get_highbyte(position[i]));//high byte
-	}
-	
-	dxl_set_txpacket_length((2+1)*size+4);		//set packet length
-	dxl_txrx_packet();			//transmit packet
-	CommStatus = dxl_get_result();	//get transmission state
-	if( CommStatus == COMM_RXSUCCESS ){	//transmission succeded
-		PrintErrorCode();					//show potentiol motors error (overload, overheat,etc....)
-		if (blocking == MOTOR_MOVE_BLOCKING) //blocking function requested
+		data[2*i] = dxl_get_lowbyte(position[i]);		//low byte
+		data[2*i+1] = dxl_get_highbyte(position[i]);	//high byte
+	}
+	CommStatus = motor_sync_write(GOAL_POSITION_L, 2, size, id, data);	//transmit packet, errors are counted by the driver
+	return CommStatus == COMM_RXSUCCESS;
+}
+
+void motor_sync_move(const uint8_t size, const uint8_t * id, const uint16_t * position, const char blocking) {
+	if (blocking == MOTOR_MOVE_BLOCKING) //blocking function requested
+		motor_move_wait(motor_sync_move_async(size, id, position, NULL));	// Wait for finish of all motors
+	else
+		motor_sync_write_position(size, id, position);
+}
+
+motor_move_handle motor_sync_move_async(const uint8_t size, const uint8_t * id, const uint16_t * position, const motor_move_callback callback) {
+	if (!motor_sync_write_position(size, id, position))
+		return MOTOR_MOVE_INVALID;
+	return motor_track_move(size, id, callback);
+}
+
+motor_move_handle motor_sync_move_timed(const uint8_t size, const uint8_t * id, const uint16_t * position, const uint16_t duration_ms) {
+	uint8_t i, data[4 * MOTOR_MOVE_MAX_MOTORS];
+	uint16_t present[MOTOR_MOVE_MAX_MOTORS], travel[MOTOR_MOVE_MAX_MOTORS], max_travel = 0;
+	uint32_t duration = duration_ms, speed;
+	if (size == 0 || size > MOTOR_MOVE_MAX_MOTORS)
+		return MOTOR_MOVE_INVALID;
+	for (i = 0; i < size; i++)
+		present[i] = MOTOR_READ_ERROR;
+	motor_sync_get_position(size, id, present);
+	for (i = 0; i < size; i++) {
+		// Unknown position, assume the whole range
+		if (present[i] > 1023)
+			travel[i] = 1023;
+		else
+			travel[i] = position[i] > present[i] ? position[i] - present[i] : present[i] - position[i];
+		if (travel[i] > max_travel)
+			max_travel = travel[i];
+	}
+	// The motor with the longest travel limits the duration
+	if (duration * MOTOR_MAX_SPEED < max_travel * MOTOR_SPEED_TIME_PER_POSITION)
+		duration = (max_travel * MOTOR_SPEED_TIME_PER_POSITION + MOTOR_MAX_SPEED - 1) / MOTOR_MAX_SPEED;
+	for (i = 0; i < size; i++) {
+		speed = duration > 0 ? (travel[i] * MOTOR_SPEED_TIME_PER_POSITION + duration / 2) / duration : 0;
+		// Speed 0 would mean maximum speed
+		if (speed < 1)
+			speed = 1;
+		else if (speed > MOTOR_MAX_SPEED)
+			speed = MOTOR_MAX_SPEED;
+		data[4*i] = dxl_get_lowbyte(position[i]);		//goal position
+		data[4*i+1] = dxl_get_highbyte(position[i]);
+		data[4*i+2] = dxl_get_lowbyte(speed);			//moving speed
+		data[4*i+3] = dxl_get_highbyte(speed);
+	}
+	if (motor_sync_write(GOAL_POSITION_L, 4, size, id, data) != COMM_RXSUCCESS)
+		return MOTOR_MOVE_INVALID;
+	return motor_track_move(size, id, NULL);
+}
+
+/// \private Function to forget values in the shadow of a motor which are written by the background tasks.
+static void motor_shadow_forget(const uint8_t id, const uint8_t address, const uint8_t length)
+{
+	motor_shadow_entry * entry = motor_shadow_find(id, 0);
+	if (entry != NULL)
+		entry->valid &= ~motor_shadow_mask(address, length);
+}
+
+int motor_stream_start(const uint8_t size, const uint8_t * id, const uint8_t period_ms) {
+	uint8_t i;
+	if (size == 0 || size > MOTOR_STREAM_MAX_MOTORS || period_ms == 0 || !motor_timer_running)
+		return 0;
+	motor_stream_stop();
+	for (i = 0; i < size; i++) {
+		motor_stream_tracks[i].id = id[i];
+		motor_stream_tracks[i].head = 0;
+		motor_stream_tracks[i].tail = 0;
+		motor_stream_tracks[i].segment = 0;
+		motor_stream_tracks[i].speed = MOTOR_MAX_SPEED;
+		motor_stream_tracks[i].setpoint = 0xFFFF;
+		// The streamer writes goal position and moving speed without the shadow
+		motor_shadow_forget(id[i], GOAL_POSITION_L, 4);
+	}
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		motor_stream_period = period_ms;
+		motor_stream_elapsed = 0;
+		motor_stream_size = size;
+	}
+	return 1;
+}
+
+void motor_stream_stop(void) {
+	uint8_t i, size;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		size = motor_stream_size;
+		motor_stream_size = 0;
+		motor_stream_due = 0;
+	}
+	// A packet in flight is not affected, its values are forgotten as well
+	for (i = 0; i < size; i++)
+		motor_shadow_forget(motor_stream_tracks[i].id, GOAL_POSITION_L, 4);
+}
+
+uint16_t motor_stream_time(void) {
+	uint16_t time;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		time = motor_stream_clock;
+	}
+	return time;
+}
+
+int motor_stream_push(const uint8_t index, const uint16_t time_ms, const uint16_t position) {
+	motor_stream_track * track;
+	uint8_t tail;
+	if (index >= motor_stream_size)
+		return 0;
+	track = &motor_stream_tracks[index];
+	tail = track->tail;
+	if (((tail + 1) & MOTOR_STREAM_MASK) == track->head)
+		return 0;
+	track->keyframe[tail].time = time_ms;
+	track->keyframe[tail].position = position;
+	// Publish the keyframe after it has been written
+	track->tail = (tail + 1) & MOTOR_STREAM_MASK;
+	return 1;
+}
+
+uint8_t motor_stream_free(const uint8_t index) {
+	motor_stream_track * track;
+	if (index >= motor_stream_size)
+		return 0;
+	track = &motor_stream_tracks[index];
+	return (track->head - track->tail - 1) & MOTOR_STREAM_MASK;
+}
+
+uint16_t motor_stream_setpoint(const uint8_t index) {
+	uint16_t setpoint;
+	if (index >= motor_stream_size)
+		return 0xFFFF;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		setpoint = motor_stream_tracks[index].setpoint;
+	}
+	return setpoint;
+}
+
+int motor_odometry_start(const uint8_t left_id, const uint8_t right_id, const uint16_t wheel_diameter_mm, const uint16_t track_mm, const uint8_t period_ms) {
+	// Travel of a wheel per speed unit and ms in um
+	double rate = MOTOR_RPM_PER_SPEED_UNIT * M_PI * wheel_diameter_mm / 60.0;
+	if (wheel_diameter_mm == 0 || track_mm == 0 || period_ms == 0 || !motor_timer_running
+			|| MOTOR_MAX_SPEED * rate * period_ms > MOTOR_ODOMETRY_MAX_TRAVEL)
+		return 0;
+	motor_odometry_stop();
+	motor_odometry_id[0] = left_id;
+	motor_odometry_id[1] = right_id;
+	motor_odometry_track = track_mm;
+	motor_odometry_speed[0] = 0;
+	motor_odometry_speed[1] = 0;
+	// The factors are computed once, the samples are integrated in fixed point
+	motor_odometry_scale = (uint32_t)(rate * period_ms * 65536.0 + 0.5);
+	motor_odometry_circle = (uint32_t)(2.0 * M_PI * track_mm * 1000.0 + 0.5);
+	motor_odometry_angle_scale = 0xFFFFFFFFul / motor_odometry_circle;
+	motor_odometry_reset();
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		motor_odometry_period = period_ms;
+		motor_odometry_elapsed = 0;
+		motor_odometry_periods = 0;
+		motor_odometry_wheel = 0;
+		motor_odometry_running = 1;
+	}
+	return 1;
+}
+
+void motor_odometry_stop(void) {
+	// The differential drive needs the wheel speeds
+	motor_drive_stop();
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		motor_odometry_running = 0;
+	}
+}
+
+void motor_odometry_reset(void) {
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		motor_odometry_pose.x = 0;
+		motor_odometry_pose.y = 0;
+		motor_odometry_pose.heading = 0;
+		motor_odometry_pose.samples = 0;
+		motor_odometry_pose.failures = 0;
+		motor_odometry_turn = 0;
+	}
+}
+
+void motor_odometry_get(motor_pose * pose) {
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		*pose = *(motor_pose *)&motor_odometry_pose;
+	}
+}
+
+int motor_drive_start(const int16_t kp, const int16_t ki) {
+	// Wheel speed in mm/s per speed unit, see motor_odometry_start
+	double rate = motor_odometry_scale / 65536.0 / motor_odometry_period;
+	if (!motor_odometry_running)
+		return 0;
+	motor_drive_stop();
+	motor_drive_gain[0] = kp;
+	motor_drive_gain[1] = ki;
+	motor_drive_max_speed = (uint16_t)(MOTOR_MAX_SPEED * rate);
+	motor_drive_scale = (uint32_t)(65536.0 / rate + 0.5);
+	motor_drive_integral[0] = motor_drive_integral[1] = 0;
+	motor_drive_target[0] = motor_drive_target[1] = 0;
+	// The moving speed is written without the shadow
+	motor_shadow_forget(motor_odometry_id[0], MOVING_SPEED_L, 2);
+	motor_shadow_forget(motor_odometry_id[1], MOVING_SPEED_L, 2);
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		motor_drive_running = 1;
+	}
+	return 1;
+}
+
+void motor_drive_stop(void) {
+	uint8_t zero[4] = {0, 0, 0, 0};
+	uint8_t running;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		running = motor_drive_running;
+		motor_drive_running = 0;
+		motor_drive_due = 0;
+	}
+	// Stop the wheels, a packet in flight is overwritten
+	if (running)
+		motor_sync_write(MOVING_SPEED_L, 2, 2, motor_odometry_id, zero);
+}
+
+int motor_drive_set(const int16_t linear_mm_s, const int16_t angular_mrad_s) {
+	int32_t speed[2], peak;
+	int32_t turn = (int32_t)angular_mrad_s * motor_odometry_track / 2000;
+	uint8_t wheel;
+	if (!motor_drive_running)
+		return 0;
+	speed[0] = linear_mm_s - turn;
+	speed[1] = linear_mm_s + turn;
+	// Scale both wheels down together to keep the curvature
+	peak = speed[0] < 0 ? -speed[0] : speed[0];
+	if (speed[1] > peak || -speed[1] > peak)
+		peak = speed[1] < 0 ? -speed[1] : speed[1];
+	for (wheel = 0; wheel < 2; wheel++)
+	{
+		if (peak > motor_drive_max_speed)
+			speed[wheel] = speed[wheel] * motor_drive_max_speed / peak;
+		speed[wheel] = (speed[wheel] * (int32_t)motor_drive_scale + 0x8000) >> 16;
+		if (speed[wheel] > MOTOR_MAX_SPEED)
+			speed[wheel] = MOTOR_MAX_SPEED;
+		else if (speed[wheel] < -MOTOR_MAX_SPEED)
+			speed[wheel] = -MOTOR_MAX_SPEED;
+	}
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		motor_drive_target[0] = (int16_t)speed[0];
+		motor_drive_target[1] = (int16_t)speed[1];
+	}
+	return 1;
+}
+
+int motor_load_start(const uint8_t size, const uint8_t * id, const uint8_t period_ms, const uint16_t stall_load, const uint16_t collision_rise, const motor_load_callback callback) {
+	uint8_t i;
+	if (size == 0 || size > MOTOR_LOAD_MAX_MOTORS || period_ms == 0 || stall_load > 1023 || collision_rise > 1023
+			|| !motor_timer_running)
+		return 0;
+	motor_load_stop();
+	for (i = 0; i < size; i++) {
+		motor_load_entries[i].id = id[i];
+		motor_load_entries[i].load = 0;
+		motor_load_entries[i].primed = 0;
+		motor_load_entries[i].active = 0;
+		motor_load_entries[i].events = 0;
+	}
+	motor_load_stall = stall_load;
+	motor_load_rise = collision_rise << 3;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		load_callback = callback;
+		motor_load_period = period_ms;
+		motor_load_elapsed = 0;
+		motor_load_index = 0;
+		motor_load_size = size;
+	}
+	return 1;
+}
+
+void motor_load_stop(void) {
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		motor_load_size = 0;
+		motor_load_due = 0;
+	}
+}
+
+uint8_t motor_load_event(const uint8_t index) {
+	uint8_t events = 0;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		if (index < motor_load_size)
 		{
-			// Wait for finish of all motors
-			for (i = 0; i < size; i++)
-				motor_wait_finish(id[i], position[i]);
-		}			
-	}		
-	else							//communication failed
-		PrintCommStatus(CommStatus);	//show communication error
+			events = motor_load_entries[index].events;
+			motor_load_entries[index].events = 0;
+		}
+	}
+	return events;
+}
+
+int16_t motor_load_get(const uint8_t index) {
+	int16_t load = 0;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		if (index < motor_load_size)
+			load = motor_load_entries[index].load;
+	}
+	return load;
 }
 
+int motor_read_block_policy(const uint8_t id, const uint8_t address, const uint8_t length, uint8_t * buffer, const motor_read_policy * policy) {
+	uint8_t i, attempt;
+	uint16_t timeout;
+	int CommStatus;
+	motor_link_entry * link;
+	dxl_packet packet;
+	if (length == 0 || length > MAXNUM_RXPARAM)
+		return COMM_TXERROR;
+	dxl_lock();
+	link = motor_link_find(id, 1);
+	if (policy == NULL)
+		policy = link != NULL ? &link->policy : &motor_default_policy;
+	timeout = motor_link_timeout(link, policy);
+	for (attempt = 0; ; attempt++) {
+		dxl_set_return_timeout(timeout);
+		dxl_packet_begin(&packet, id, INST_READ);		//motor to read
+		dxl_packet_put(&packet, address);				//memory area to read
+		dxl_packet_put(&packet, length);				//length of the data
+		dxl_packet_txrx(&packet);						//transmit and wait for status packet
+		CommStatus = dxl_get_result();
+		if (CommStatus == COMM_RXSUCCESS && dxl_get_rxpacket_length() != length + 2)
+			CommStatus = COMM_RXCORRUPT;
+		motor_link_learn(link, CommStatus);
+		if (CommStatus == COMM_RXSUCCESS || CommStatus == COMM_TXERROR || attempt >= policy->retries)
+			break;
+		// Give a learned timeout more time for the next attempt
+		if (policy->timeout_us == MOTOR_TIMEOUT_ADAPTIVE)
+			timeout = (timeout > DXL_RETURN_TIMEOUT_US / 2) ? DXL_RETURN_TIMEOUT_US : timeout * 2;
+		if (link != NULL)
+			link->retries++;
+	}
+	if (CommStatus == COMM_RXSUCCESS)
+		for (i = 0; i < length; i++)
+			buffer[i] = dxl_get_rxpacket_parameter(i);
+	else if (link != NULL)
+		link->failures++;
+	dxl_unlock();
+	return CommStatus;
+}
+
+int motor_read_block(const uint8_t id, const uint8_t address, const uint8_t length, uint8_t * buffer) {
+	return motor_read_block_policy(id, address, length, buffer, NULL);
+}
+
+int motor_read_byte(const uint8_t id, const uint8_t address, uint8_t * value) {
+	return motor_read_block(id, address, 1, value);
+}
+
+int motor_read_word(const uint8_t id, const uint8_t address, uint16_t * value) {
+	uint8_t data[2];
+	int CommStatus = motor_read_block(id, address, 2, data);
+	if (CommStatus == COMM_RXSUCCESS)
+		*value = dxl_makeword(data[0], data[1]);
+	return CommStatus;
+}
+
+int motor_set_read_policy(const uint8_t id, const motor_read_policy * policy) {
+	uint8_t i;
+	motor_link_entry * link;
+	int res = 1;
+	dxl_lock();
+	if (id == MOTOR_BROADCAST_ID) {
+		motor_default_policy = *policy;
+		for (i = 0; i < MOTOR_LINK_MOTORS && motor_links_initialized; i++)
+			motor_links[i].policy = *policy;
+	}
+	else if ((link = motor_link_find(id, 1)) != NULL)
+		link->policy = *policy;
+	else
+		res = 0;
+	dxl_unlock();
+	return res;
+}
+
+int motor_get_link_stats(const uint8_t id, motor_link_stats * stats) {
+	motor_link_entry * link;
+	int res = 0;
+	dxl_lock();
+	link = motor_link_find(id, 0);
+	if (link != NULL) {
+		stats->return_time_us = link->return_time >> 3;
+		stats->return_jitter_us = link->return_jitter >> 2;
+		stats->timeout_us = motor_link_timeout(link, &link->policy);
+		stats->retries = link->retries;
+		stats->failures = link->failures;
+		res = 1;
+	}
+	dxl_unlock();
+	return res;
+}
+
+int motor_scan(const uint8_t first_id, const uint8_t last_id, const uint16_t timeout_us) {
+	uint8_t id, i, data[MOTOR_SCAN_LENGTH];
+	volatile motor_info * info;
+	dxl_packet packet;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		motor_registry_size = 0;
+	}
+	for (id = first_id; id <= last_id && id < MOTOR_BROADCAST_ID && motor_registry_size < MOTOR_REGISTRY_SIZE; id++) {
+		dxl_lock();
+		dxl_set_return_timeout(timeout_us);
+		dxl_packet_begin(&packet, id, INST_READ);		//motor to ask
+		dxl_packet_put(&packet, MODEL_NUMBER_L);		//memory area to read
+		dxl_packet_put(&packet, MOTOR_SCAN_LENGTH);		//length of the data
+		dxl_packet_txrx(&packet);
+		if (dxl_get_result() == COMM_RXSUCCESS && dxl_get_rxpacket_length() == MOTOR_SCAN_LENGTH + 2) {
+			for (i = 0; i < MOTOR_SCAN_LENGTH; i++)
+				data[i] = dxl_get_rxpacket_parameter(i);
+			// Entries beyond the size are not used by the presence check
+			info = &motor_registry[motor_registry_size];
+			info->id = id;
+			info->model = dxl_makeword(data[MODEL_NUMBER_L], data[MODEL_NUMBER_H]);
+			info->firmware = data[VERSION_OF_FIRMWARE];
+			info->baud_rate = data[BAUD_RATE];
+			info->return_delay_us = data[RETURN_DELAY_TIME] * 2;
+			info->present = 1;
+			info->misses = 0;
+			ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+			{
+				motor_registry_size++;
+			}
+		}
+		dxl_unlock();
+	}
+	return motor_registry_size;
+}
+
+uint8_t motor_registry_count(void) {
+	return motor_registry_size;
+}
+
+int motor_registry_get(const uint8_t index, motor_info * info) {
+	int res = 0;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		if (index < motor_registry_size) {
+			*info = *(motor_info *)&motor_registry[index];
+			res = 1;
+		}
+	}
+	return res;
+}
+
+int motor_registry_find(const uint8_t id) {
+	uint8_t i;
+	for (i = 0; i < motor_registry_size; i++)
+		if (motor_registry[i].id == id)
+			return i;
+	return -1;
+}
+
+void motor_set_presence_check(const uint8_t enable, const motor_presence_callback callback) {
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		presence_callback = callback;
+		motor_presence_enabled = enable;
+	}
+}
+
+int motor_sync_read(const uint8_t size, const uint8_t * id, const uint8_t address, const uint8_t length, uint8_t * data) {
+	uint8_t i;
+	int count = 0;
+	if (length == 0 || length > MAXNUM_RXPARAM)
+		return 0;
+	// Keep the bus for the whole group, the requests follow each other without any delay
+	dxl_lock();
+	for (i = 0; i < size; i++)
+		if (motor_read_block(id[i], address, length, &data[i * length]) == COMM_RXSUCCESS)
+			count++;
+	dxl_unlock();
+	return count;
+}
+
+void motor_decode_telemetry(const uint8_t * data, motor_telemetry * telemetry) {
+	telemetry->position = dxl_makeword(data[PRESENT_POSITION_L - PRESENT_POSITION_L], data[PRESENT_POSITION_H - PRESENT_POSITION_L]);
+	telemetry->speed = motor_decode_direction(dxl_makeword(data[PRESENT_SPEED_L - PRESENT_POSITION_L], data[PRESENT_SPEED_H - PRESENT_POSITION_L]));
+	telemetry->load = motor_decode_direction(dxl_makeword(data[PRESENT_LOAD_L - PRESENT_POSITION_L], data[PRESENT_LOAD_H - PRESENT_POSITION_L]));
+	telemetry->voltage = data[PRESENT_VOLTAGE - PRESENT_POSITION_L];
+	telemetry->temperature = data[PRESENT_TEMPERATURE - PRESENT_POSITION_L];
+}
+
+int motor_get_telemetry(const uint8_t id, motor_telemetry * telemetry) {
+	uint8_t data[MOTOR_TELEMETRY_LENGTH];
+	int CommStatus = motor_read_block(id, PRESENT_POSITION_L, MOTOR_TELEMETRY_LENGTH, data);
+	if (CommStatus == COMM_RXSUCCESS)
+		motor_decode_telemetry(data, telemetry);
+	return CommStatus;
+}
+
+int motor_sync_get_telemetry(const uint8_t size, const uint8_t * id, motor_telemetry * telemetry) {
+	uint8_t i;
+	int count = 0;
+	// The reads are issued back-to-back, see motor_sync_read()
+	dxl_lock();
+	for (i = 0; i < size; i++)
+		if (motor_get_telemetry(id[i], &telemetry[i]) == COMM_RXSUCCESS)
+			count++;
+	dxl_unlock();
+	return count;
+}
+
+int motor_sync_get_position(const uint8_t size, const uint8_t * id, uint16_t * position) {
+	uint8_t i;
+	int count = 0;
+	// Keep the bus for the whole group, the requests follow each other without any delay
+	dxl_lock();
+	for (i = 0; i < size; i++)
+		if (motor_read_word(id[i], PRESENT_POSITION_L, &position[i]) == COMM_RXSUCCESS)
+			count++;
+	dxl_unlock();
+	return count;
+}
+
+
+/// \private Error counters at the time of the last report.
+static dxl_error_counts motor_errors_reported[DXL_ERROR_DEVICES];
+/// \private Time of the last report in us.
+static uint32_t motor_errors_report_time = 0;
+
+int motor_report_errors(const uint16_t interval_ms) {
+	uint8_t i, j, reported;
+	int motors = 0;
+	uint16_t delta;
+	dxl_error_counts counts;
+	uint32_t now = dxl_hal_get_time();
+	if (now - motor_errors_report_time < (uint32_t)interval_ms * 1000)
+		return 0;
+	motor_errors_report_time = now;
+	for (i = 0; i < DXL_ERROR_DEVICES && dxl_get_error_counts(i, &counts); i++) {
+		reported = 0;
+		for (j = 0; j < DXL_ERROR_CLASSES; j++) {
+			// The counters wrap around, the difference is still correct
+			delta = counts.count[j] - motor_errors_reported[i].count[j];
+			if (delta == 0)
+				continue;
+			// The messages are in the order of the error classes
+			LOG2(LOG_MOTOR_ERROR_VOLTAGE + j, counts.id, delta);
+			reported = 1;
+		}
+		if (reported)
+			motors++;
+		motor_errors_reported[i] = counts;
+	}
+	return motors;
+}
+
+void motor_reset_errors(void) {
+	uint8_t i, j;
+	dxl_reset_error_counts();
+	for (i = 0; i < DXL_ERROR_DEVICES; i++)
+		for (j = 0; j < DXL_ERROR_CLASSES; j++)
+			motor_errors_reported[i].count[j] = 0;
+}
 
 // Print communication error
 void PrintCommStatus(int CommStatus)
@@ -140,31 +2060,31 @@ void PrintCommStatus(int CommStatus)
 	switch(CommStatus)
 	{
 		case COMM_TXFAIL:
-			printf("COMM_TXFAIL: Failed transmit instruction packet!\n");
+			LOG0(LOG_COMM_TXFAIL);
 		break;
 
 		case COMM_TXERROR:
-			printf("COMM_TXERROR: Incorrect instruction packet!\n");
+			LOG0(LOG_COMM_TXERROR);
 		break;
 
 		case COMM_RXFAIL:
-			printf("COMM_RXFAIL: Failed get status packet from device!\n");
+			LOG0(LOG_COMM_RXFAIL);
 		break;
 
 		case COMM_RXWAITING:
-			printf("COMM_RXWAITING: Now receiving status packet!\n");
+			LOG0(LOG_COMM_RXWAITING);
 		break;
 
 		case COMM_RXTIMEOUT:
-			printf("COMM_RXTIMEOUT: There is no status packet!\n");
+			LOG0(LOG_COMM_RXTIMEOUT);
 		break;
 
 		case COMM_RXCORRUPT:
-			printf("COMM_RXCORRUPT: Incorrect status packet!\n");
+			LOG0(LOG_COMM_RXCORRUPT);
 		break;
 
 		default:
-			printf("This is unknown error code!\n");
+			LOG1(LOG_COMM_UNKNOWN, CommStatus);
 		break;
 	}
 }
@@ -173,23 +2093,23 @@ void PrintCommStatus(int CommStatus)
 void PrintErrorCode()
 {
 	if (dxl_get_rxpacket_error(ERRBIT_VOLTAGE) == 1)
-		printf("Input voltage error!\n");
+		LOG0(LOG_ERRBIT_VOLTAGE);
 
 	if (dxl_get_rxpacket_error(ERRBIT_ANGLE) == 1)
-		printf("Angle limit error!\n");
+		LOG0(LOG_ERRBIT_ANGLE);
 
 	if (dxl_get_rxpacket_error(ERRBIT_OVERHEAT) == 1)
-		printf("Overheat error!\n");
+		LOG0(LOG_ERRBIT_OVERHEAT);
 
 	if (dxl_get_rxpacket_error(ERRBIT_RANGE) == 1)
-		printf("Out of range error!\n");
+		LOG0(LOG_ERRBIT_RANGE);
 
 	if (dxl_get_rxpacket_error(ERRBIT_CHECKSUM) == 1)
-		printf("Checksum error!\n");
+		LOG0(LOG_ERRBIT_CHECKSUM);
 
 	if (dxl_get_rxpacket_error(ERRBIT_OVERLOAD) == 1)
-		printf("Overload error!\n");
+		LOG0(LOG_ERRBIT_OVERLOAD);
 
 	if (dxl_get_rxpacket_error(ERRBIT_INSTRUCTION) == 1)
-		printf("Instruction code error!\n");
+		LOG0(LOG_ERRBIT_INSTRUCTION);
 }
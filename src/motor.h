@@ -29,10 +29,230 @@
 ///Symbol to define a non-blocking function request. Should be used with #motor_move, #motor_sync_move and #motor_set_position functions
 #define MOTOR_MOVE_NON_BLOCKING		0
 
+///Timer used by the motor library for its background tasks, see #motor_init and timer.h
+#define MOTOR_TIMER					2
+///Interval in ms between two polls of the moving state of the motors tracked by #motor_track_move
+#define MOTOR_POLL_INTERVAL			10
+///Maximum time in ms a movement is tracked before it is considered finished
+#define MOTOR_MAX_TIMEOUT			2000
+
+///Maximum number of movements tracked at the same time
+#define MOTOR_MOVE_MAX_GROUPS		4
+///Maximum number of motors of a single tracked movement
+#define MOTOR_MOVE_MAX_MOTORS		16
+///Invalid movement handle, returned if a movement could not be started or tracked
+#define MOTOR_MOVE_INVALID			0xFF
+
+///Maximum number of motors whose writable control table is shadowed in RAM, see #motor_write
+#define MOTOR_SHADOW_MOTORS			8
+
+///Maximum number of motors with their own read policy and return time statistics, see #motor_set_read_policy
+#define MOTOR_LINK_MOTORS			8
+///Timeout of a #motor_read_policy which is learned from the measured return times of the motor
+#define MOTOR_TIMEOUT_ADAPTIVE		0
+///Lower limit in us of a learned timeout
+#define MOTOR_TIMEOUT_MIN_US		100
+///Value returned by #motor_get_position if the motor did not answer
+#define MOTOR_READ_ERROR			5000
+
+///Moving speed units per position unit per second (0.293 degree per position unit, 0.111 rpm per speed unit)
+#define MOTOR_SPEED_PER_POSITION_RATE	(300.0 / 1024.0 / 360.0 * 60.0 / 0.111)
+///Maximum moving speed in joint mode
+#define MOTOR_MAX_SPEED				1023
+
+///Maximum number of motors of the trajectory streamer, see #motor_stream_start
+#define MOTOR_STREAM_MAX_MOTORS		8
+///Number of keyframes buffered per streamed motor (minus one). Must be a power of two.
+#define MOTOR_STREAM_KEYFRAMES		8
+///Moving speed sent by the trajectory streamer in percent of the speed of the trajectory, so the motors do not lag behind
+#define MOTOR_STREAM_SPEED_MARGIN	120
+
+///Maximum number of motors in the registry filled by #motor_scan
+#define MOTOR_REGISTRY_SIZE			16
+///Default time in us a motor may take to answer during #motor_scan, covers the factory return delay of 500 us
+#define MOTOR_SCAN_TIMEOUT_US		600
+///Number of missed pings after which a registered motor is considered unplugged, see #motor_set_presence_check
+#define MOTOR_PRESENCE_MISSES		2
+
+///Wheel speed in rpm per present speed unit, used by the odometry (see #motor_odometry_start)
+#define MOTOR_RPM_PER_SPEED_UNIT	0.111
+///Maximum travel in um of a wheel per odometry sample, longer sample periods are rejected by #motor_odometry_start
+#define MOTOR_ODOMETRY_MAX_TRAVEL	131071
+///Default proportional gain of the differential drive per speed unit of error (8.8 fixed point), see #motor_drive_start
+#define MOTOR_DRIVE_KP				64
+///Default integral gain of the differential drive per speed unit of error and sample (8.8 fixed point)
+#define MOTOR_DRIVE_KI				16
+
+///Maximum number of motors watched by the load monitor, see #motor_load_start
+#define MOTOR_LOAD_MAX_MOTORS		8
+///Event of the load monitor: the load of a motor exceeds the stall threshold
+#define MOTOR_LOAD_EVENT_STALL		1
+///Event of the load monitor: the load of a motor rises faster above its recent level than the collision limit
+#define MOTOR_LOAD_EVENT_COLLISION	2
+
 #include <avr/io.h>
 #include <dynamixel.h>
 #include "motor_control_table.h"
 
+///Transaction priority for setpoint writes, sent before anything else
+#define MOTOR_PRIORITY_HIGH			0
+///Transaction priority for normal transactions, sent together with the polls of the tracked movements
+#define MOTOR_PRIORITY_NORMAL		1
+///Transaction priority for telemetry reads, sent when nothing else is to do
+#define MOTOR_PRIORITY_LOW			2
+///Number of transaction priorities
+#define MOTOR_PRIORITIES			3
+///Number of transactions which can be queued per priority (minus one). Must be a power of two.
+#define MOTOR_QUEUE_LENGTH			8
+///Maximum number of data bytes of a queued transaction
+#define MOTOR_QUEUE_MAX_DATA		8
+///Default bus time in us the background tasks may use per 1 ms tick, see #motor_set_bus_budget
+#define MOTOR_BUS_BUDGET_US			700
+
+///Statistics of the control table writes, see #motor_get_write_stats
+typedef struct {
+	///Number of write packets sent to the motors
+	uint32_t sent;
+	///Number of writes skipped since the motor already had the value
+	uint32_t suppressed;
+} motor_write_stats;
+
+///Queued bus transaction, see #motor_queue_read and #motor_queue_write
+typedef struct motor_transaction motor_transaction;
+
+///Transaction completion callback function definition. The transaction is only valid during the call.
+typedef void (*motor_transaction_callback)(const motor_transaction * transaction);
+
+struct motor_transaction {
+	///Id of the motor
+	uint8_t id;
+	///Instruction, _INST_READ_ or _INST_WRITE_
+	uint8_t instruction;
+	///First control table address
+	uint8_t address;
+	///Number of bytes to read or write
+	uint8_t length;
+	///Data to write or data read
+	uint8_t data[MOTOR_QUEUE_MAX_DATA];
+	///Communication result as returned by dxl_get_result()
+	uint8_t result;
+	///Time in us the transaction has been queued
+	uint32_t queued;
+	///Completion callback
+	motor_transaction_callback callback;
+};
+
+///Statistics of a transaction queue, see #motor_get_queue_stats
+typedef struct {
+	///Number of transactions in the queue
+	uint8_t depth;
+	///Maximum number of transactions in the queue
+	uint8_t max_depth;
+	///Number of completed transactions
+	uint32_t completed;
+	///Number of transactions rejected since the queue was full
+	uint32_t dropped;
+	///Sum of the latencies from queuing to completion in us
+	uint32_t latency_sum_us;
+	///Maximum latency from queuing to completion in us
+	uint32_t latency_max_us;
+} motor_queue_stats;
+
+///Number of control table bytes of the telemetry, from #PRESENT_POSITION_L to #PRESENT_TEMPERATURE
+#define MOTOR_TELEMETRY_LENGTH		(PRESENT_TEMPERATURE - PRESENT_POSITION_L + 1)
+
+///Timeout and retry settings of the reads of a motor, see #motor_set_read_policy
+typedef struct {
+	///Time in us the motor may take to start its answer, #MOTOR_TIMEOUT_ADAPTIVE to learn it from the return times
+	uint16_t timeout_us;
+	///Number of times a failed read is repeated
+	uint8_t retries;
+} motor_read_policy;
+
+///Return time statistics of a motor, see #motor_get_link_stats
+typedef struct {
+	///Smoothed time in us from the end of the request to the start of the answer, 0 if not measured yet
+	uint16_t return_time_us;
+	///Smoothed mean deviation of the return time in us
+	uint16_t return_jitter_us;
+	///Timeout in us used for the next read
+	uint16_t timeout_us;
+	///Number of repeated reads
+	uint16_t retries;
+	///Number of reads which failed after all retries
+	uint16_t failures;
+} motor_link_stats;
+
+///Registry entry of a motor found by #motor_scan
+typedef struct {
+	///Id of the motor
+	uint8_t id;
+	///Model number, 12 for the AX-12
+	uint16_t model;
+	///Version of the firmware
+	uint8_t firmware;
+	///Content of the #BAUD_RATE register, the baudrate is 2000000 / (value + 1) bps
+	uint8_t baud_rate;
+	///Return delay time in us
+	uint16_t return_delay_us;
+	///1 as long as the motor answers the pings of the presence check, 0 if it has been unplugged
+	uint8_t present;
+	///Number of consecutive missed pings
+	uint8_t misses;
+} motor_info;
+
+///Callback function definition of the presence check, called in interrupt context whenever a registered motor disappears or reappears
+typedef void (*motor_presence_callback)(const uint8_t id, const uint8_t present);
+
+///Callback function definition of the load monitor, called in interrupt context when a motor raises new events (MOTOR_LOAD_EVENT_*)
+typedef void (*motor_load_callback)(const uint8_t index, const uint8_t events);
+
+///Decoded state of a motor, see #motor_get_telemetry
+typedef struct {
+	///Present position in the range [0:1023]
+	uint16_t position;
+	///Present speed in the range [-1023:1023], positive values are counterclockwise
+	int16_t speed;
+	///Present load in the range [-1023:1023], positive values are counterclockwise
+	int16_t load;
+	///Present voltage in units of 0.1 V
+	uint8_t voltage;
+	///Present temperature in degree Celsius
+	uint8_t temperature;
+} motor_telemetry;
+
+///Pose of a robot with two wheels estimated by the odometry, see #motor_odometry_get
+typedef struct {
+	///Position in um along the heading the odometry has been started or reset with
+	int32_t x;
+	///Position in um to the left of the heading the odometry has been started or reset with
+	int32_t y;
+	///Heading, counterclockwise, 65536 is a full turn
+	uint16_t heading;
+	///Number of integrated samples
+	uint16_t samples;
+	///Number of wheel speed reads which failed, the previous speed of the wheel is used instead
+	uint16_t failures;
+} motor_pose;
+
+///Handle of a tracked movement, see #motor_track_move
+typedef uint8_t motor_move_handle;
+
+///Movement completion callback function definition. The argument is the handle of the finished movement.
+typedef void (*motor_move_callback)(const motor_move_handle handle);
+
+// *********************************************************************************
+/** Function to start the background tasks of the motor library.
+* The background tasks run in the compare match interrupt of timer #MOTOR_TIMER with a frequency of 1 kHz.
+* They share the bus with the main program (see dxl_lock() in dynamixel.h), track the movements started by
+* #motor_track_move and send the transactions queued by #motor_queue_read and #motor_queue_write.
+* Call this function after dxl_initialize(). Interrupts have to be enabled (sei()).
+* \note Without the background tasks the blocking functions still work, they poll the motors themselves, but
+* the completion of a non-blocking movement is only detected while #motor_move_wait is called.
+*\returns The function returns 1 in case of success and 0 otherwise.
+*/
+int motor_init(void);
+
 // *********************************************************************************
 /** Function move a single motor to a desired position.
 * This function can be used to move a motor to a certain position.
@@ -110,13 +330,47 @@ void motor_set_speed_dir(char id, uint8_t percentage, char wise);
 int motor_get_speed(char id);
 
 /** Function to wait until the motor reaches a position
-* It is used internally for the blocking #motor_move , #motor_set_position and #motor_sync_move functions.
+* The motor has reached its position as soon as its #MOVING flag is cleared or after #MOTOR_MAX_TIMEOUT ms.
 * \param [in] id The id of the motor to move. 
-* Valid arguments are unsigned integer numbers or #MOTOR_BROADCAST_ID 
-* \param [in] goal_position The position to be reached befor returning
+* Valid arguments are unsigned integer numbers.
+* \param [in] goal_position The position to be reached befor returning (unused, kept for compatibility)
+* \note This is a thin wrapper around #motor_track_move and #motor_move_wait.
 */
 void motor_wait_finish(char id, uint16_t goal_position);
 
+/** Function to track the movement of several motors in the background.
+* The motors are polled every #MOTOR_POLL_INTERVAL ms by reading their #MOVING flag. As soon as all motors have
+* stopped, or after #MOTOR_MAX_TIMEOUT ms, the movement is finished and the callback is called.
+\par Example: blink while the motors are moving
+\code
+const uint8_t ids[2] = {1, 2};
+motor_move_handle move;
+
+motor_set_position(1, 0, MOTOR_MOVE_NON_BLOCKING);
+motor_set_position(2, 1023, MOTOR_MOVE_NON_BLOCKING);
+move = motor_track_move(2, ids, NULL);
+while (!motor_move_finished(move))
+	blink_led();
+\endcode
+* \param [in] size The number of motors to track in the range [1:#MOTOR_MOVE_MAX_MOTORS].
+* \param [in] id An array of unsigned integers specifying the ids. It must be of the size specified in the first argument.
+* \param [in] callback Function called when the movement has finished or _NULL_.
+* The callback is called in interrupt context and must not use blocking motor functions.
+* \returns The handle of the movement or #MOTOR_MOVE_INVALID if #MOTOR_MOVE_MAX_GROUPS movements are already tracked.
+*/
+motor_move_handle motor_track_move(const uint8_t size, const uint8_t * id, const motor_move_callback callback);
+
+/** Function to check whether a tracked movement has finished.
+* \param [in] handle The handle returned by #motor_track_move or #motor_sync_move_async.
+*\returns 1 if the movement has finished (or the handle is #MOTOR_MOVE_INVALID) and 0 otherwise.
+*/
+uint8_t motor_move_finished(const motor_move_handle handle);
+
+/** Function to wait until a tracked movement has finished.
+* \param [in] handle The handle returned by #motor_track_move or #motor_sync_move_async.
+*/
+void motor_move_wait(const motor_move_handle handle);
+
 /** Function to set the desired position.
 *This function can be used to set a motor to a desired position.
 * \param [in] id The id of the motor to move. 
@@ -132,7 +386,8 @@ void motor_set_position(char id, uint16_t motor_position, char blocking);
 * This function can be used to read the current motor position.
 * \param [in] id The id of the motor to move. 
 * Valid arguments are unsigned integer numbers or #MOTOR_BROADCAST_ID 
-*\returns The current position, in the range [0:1023].
+*\returns The current position, in the range [0:1023], or #MOTOR_READ_ERROR if the motor did not answer. See
+* #motor_read_word for an explicit communication result.
 * \note This function only works if the specified motor is in Joint mode. See #motor_set_mode and #motor_get_mode.
 */
 uint16_t motor_get_position(char id);
@@ -166,7 +421,659 @@ It must be of the size specified in the first argument.
 */
 void motor_sync_move(const uint8_t size, const uint8_t * id, const uint16_t * position, const char blocking);
 
-/** Function to print communication error status.
+/** Function move several motors to the desired position at the same time without waiting for them.
+* The movement is tracked in the background (see #motor_track_move), the program can continue meanwhile.
+\par Example: move to the center position while the control loop keeps running
+\code
+motor_move_handle move = motor_sync_move_async(NUMBER_OF_MOTORS, ids, center_positions, NULL);
+while (!motor_move_finished(move))
+	read_sensors();
+\endcode
+* \param [in] size The number of motors to move in the range [1:#MOTOR_MOVE_MAX_MOTORS]. The following array parameters MUST be of this size.
+* \param [in] id An array of unsigned integers specifying the ids.
+*\param [in] position An array of unsigned integers specifying the target positions for the motors.
+* \param [in] callback Function called (in interrupt context) when all motors have reached their position or _NULL_.
+* \returns The handle of the movement or #MOTOR_MOVE_INVALID if the movement could not be started or tracked.
+* \note This function only works if the specified motor is in Joint mode. See #motor_set_mode and #motor_get_mode.
+*/
+motor_move_handle motor_sync_move_async(const uint8_t size, const uint8_t * id, const uint16_t * position, const motor_move_callback callback);
+
+/** Function to move several motors so that they all arrive at their target position at the same time.
+* The present positions of the motors are read first. Then the moving speed of each motor is set according to its
+* travel, so that it needs _duration_ms_ for the way, and goal position and moving speed of all motors are sent with
+* a single SYNC_WRITE packet. The movement is tracked in the background (see #motor_track_move).
+\par Example: move to the center position within 300 ms and wait for it
+\code
+motor_move_wait(motor_sync_move_timed(NUMBER_OF_MOTORS, ids, center_positions, 300));
+\endcode
+* \param [in] size The number of motors to move in the range [1:#MOTOR_MOVE_MAX_MOTORS]. The following array parameters MUST be of this size.
+* \param [in] id An array of unsigned integers specifying the ids.
+* \param [in] position An array of unsigned integers specifying the target positions for the motors.
+* \param [in] duration_ms The time of the movement in ms. If it is 0 or too short for #MOTOR_MAX_SPEED, the duration is
+* chosen so that the motor with the longest travel moves with #MOTOR_MAX_SPEED.
+* \returns The handle of the movement or #MOTOR_MOVE_INVALID if the movement could not be started or tracked.
+* \note The acceleration of the motors is not taken into account. A motor whose position cannot be read is moved as
+* if it had to travel the whole range.
+* \note This function only works if the specified motor is in Joint mode. See #motor_set_mode and #motor_get_mode.
+*/
+motor_move_handle motor_sync_move_timed(const uint8_t size, const uint8_t * id, const uint16_t * position, const uint16_t duration_ms);
+
+/** Function to start the trajectory streamer.
+* The streamer moves the motors along trajectories given by timestamped keyframes (see #motor_stream_push). Every
+* _period_ms_ the background tasks interpolate the position of each motor between its keyframes in fixed point and
+* send goal position and moving speed of all motors with a single SYNC_WRITE packet, independent of the timing of
+* the main program. The main program only has to keep the keyframe buffers filled. A running stream is restarted.
+\par Example: move two motors along a triangle signal
+\code
+uint8_t ids[] = {1, 2};
+uint16_t time;
+motor_init();
+motor_stream_start(2, ids, 20);
+time = motor_stream_time();
+while (1) {
+	while (motor_stream_free(0) > 0 && motor_stream_free(1) > 0) {
+		time += 500;
+		motor_stream_push(0, time, (time / 500) % 2 ? 300 : 700);
+		motor_stream_push(1, time, (time / 500) % 2 ? 700 : 300);
+	}
+	read_sensors();
+}
+\endcode
+* \param [in] size The number of motors in the range [1:#MOTOR_STREAM_MAX_MOTORS].
+* \param [in] id An array of unsigned integers specifying the ids. The motors are addressed by their index in this array.
+* \param [in] period_ms The time between two setpoints in ms.
+* \returns 1 in case of success, 0 if the parameters are invalid or #motor_init has not been called.
+* \note The main program must not write goal position or moving speed of the streamed motors while the stream is running.
+*/
+int motor_stream_start(const uint8_t size, const uint8_t * id, const uint8_t period_ms);
+
+/// Function to stop the trajectory streamer, the motors stay at their last setpoint.
+void motor_stream_stop(void);
+
+/** Function to get the time base of the trajectory streamer.
+* \returns The time in ms, running at 1 kHz as long as #motor_init has been called. It wraps around after 65536 ms.
+*/
+uint16_t motor_stream_time(void);
+
+/** Function to append a keyframe to the trajectory of a streamed motor.
+* The keyframes of a motor must be appended in chronological order. The position of the motor is interpolated
+* linearly between the keyframes and stays at the last keyframe if no further keyframe follows.
+* \param [in] index The index of the motor in the array given to #motor_stream_start.
+* \param [in] time_ms The time of the keyframe, see #motor_stream_time. It must be less than 32768 ms ahead.
+* \param [in] position The position of the motor at this time in the range [0:1023].
+* \returns 1 in case of success, 0 if the buffer of the motor is full or the stream is not running.
+*/
+int motor_stream_push(const uint8_t index, const uint16_t time_ms, const uint16_t position);
+
+/** Function to get the number of keyframes which can still be appended to the trajectory of a streamed motor.
+* \param [in] index The index of the motor in the array given to #motor_stream_start.
+* \returns The number of free keyframes, 0 if the stream is not running.
+*/
+uint8_t motor_stream_free(const uint8_t index);
+
+/** Function to get the goal position last sent to a streamed motor.
+* \param [in] index The index of the motor in the array given to #motor_stream_start.
+* \returns The goal position, 0xFFFF if the stream is not running or no goal position has been sent yet.
+*/
+uint16_t motor_stream_setpoint(const uint8_t index);
+
+/** Function to start the odometry of a robot with two wheels in wheel mode.
+* Every _period_ms_ the background tasks read the present speed of both wheels back-to-back and integrate the pose of
+* the robot in fixed point, independent of the timing of the main program. The main program reads the pose with
+* #motor_odometry_get. The pose starts at x = y = 0 with heading 0. A running odometry is restarted.
+\par Example: print the pose of the wheeled robot once per second
+\code
+motor_pose pose;
+motor_init();
+motor_odometry_start(11, 12, 52, 120, 20);
+while (1) {
+	_delay_ms(1000);
+	motor_odometry_get(&pose);
+	printf("x %ld mm, y %ld mm, heading %u\n", pose.x / 1000, pose.y / 1000, pose.heading);
+}
+\endcode
+* \param [in] left_id The id of the left wheel. It drives the robot forward when turning counterclockwise (#MOTOR_CCW).
+* \param [in] right_id The id of the right wheel. It drives the robot forward when turning clockwise (#MOTOR_CW).
+* \param [in] wheel_diameter_mm The diameter of the wheels in mm.
+* \param [in] track_mm The distance between the contact points of the wheels in mm.
+* \param [in] period_ms The time between two samples in ms. A wheel at maximum speed must travel less than
+* #MOTOR_ODOMETRY_MAX_TRAVEL um per sample, e.g. the period must be below 200 ms for wheels of 110 mm.
+* \returns 1 in case of success, 0 if the parameters are invalid or #motor_init has not been called.
+* \note The odometry only knows what the wheels report: slip is not detected and the present speed of the AX-12
+* is coarse, so the pose drifts over time.
+*/
+int motor_odometry_start(const uint8_t left_id, const uint8_t right_id, const uint16_t wheel_diameter_mm, const uint16_t track_mm, const uint8_t period_ms);
+
+/// Function to stop the odometry, the pose keeps its last value.
+void motor_odometry_stop(void);
+
+/// Function to set the pose of the odometry back to x = y = 0 with heading 0.
+void motor_odometry_reset(void);
+
+/** Function to get the pose estimated by the odometry.
+* \param [out] pose The consistent snapshot of the pose.
+*/
+void motor_odometry_get(motor_pose * pose);
+
+/** Function to start the differential drive.
+* The differential drive controls the speed of the wheels of the odometry (see #motor_odometry_start) in closed
+* loop. With every sample of the odometry the background tasks run a fixed point PI controller per wheel on the
+* measured present speed and write the moving speed of both wheels with a single SYNC_WRITE packet. Thus the
+* control rate is the sample rate of the odometry, independent of the timing of the main program, which only sets
+* the motion of the robot with #motor_drive_set. The robot stands still until the first call of #motor_drive_set.
+\par Example: drive a circle with a radius of 500 mm
+\code
+motor_init();
+motor_set_mode(MOTOR_BROADCAST_ID, MOTOR_WHEEL_MODE);
+motor_odometry_start(11, 12, 52, 120, 20);
+motor_drive_start(MOTOR_DRIVE_KP, MOTOR_DRIVE_KI);
+motor_drive_set(100, 200);
+\endcode
+* \param [in] kp The proportional gain in 1/256 speed units per speed unit of error, e.g. #MOTOR_DRIVE_KP.
+* \param [in] ki The integral gain in 1/256 speed units per speed unit of error and sample, e.g. #MOTOR_DRIVE_KI.
+* \returns 1 in case of success, 0 if the odometry is not running.
+* \note The main program must not write the moving speed of the wheels while the differential drive is running.
+*/
+int motor_drive_start(const int16_t kp, const int16_t ki);
+
+/// Function to stop the differential drive and the wheels. It is stopped by #motor_odometry_stop as well.
+void motor_drive_stop(void);
+
+/** Function to set the motion of the robot driven by the differential drive.
+* \param [in] linear_mm_s The forward speed in mm/s.
+* \param [in] angular_mrad_s The counterclockwise rotation in mrad/s.
+* \returns 1 in case of success, 0 if the differential drive is not running.
+* \note If a wheel would have to exceed its maximum speed, both wheels are slowed down by the same factor, so the
+* robot still drives the same curve.
+*/
+int motor_drive_set(const int16_t linear_mm_s, const int16_t angular_mrad_s);
+
+/** Function to start the load monitor.
+* Every _period_ms_ the background tasks read the present load of all watched motors back-to-back and run two
+* detectors in fixed point on each sample:
+* - #MOTOR_LOAD_EVENT_STALL: the magnitude of the load exceeds _stall_load_, e.g. a jaw closes on something.
+* - #MOTOR_LOAD_EVENT_COLLISION: the magnitude of the load exceeds its recent level by more than _collision_rise_,
+* e.g. a leg hits an obstacle. The recent level is a moving average over about 8 samples.
+*
+* An event is raised once when its condition becomes true, at the latest one sample period plus the read time after
+* the cause. It is passed to the callback and latched until it is fetched with #motor_load_event. A running monitor
+* is restarted.
+\par Example: open a gripper as soon as it is blocked
+\code
+uint8_t ids[] = {6};
+motor_init();
+motor_load_start(1, ids, 10, 400, 0, NULL);
+motor_move(6, 512, MOTOR_MOVE_NON_BLOCKING);
+while (!(motor_load_event(0) & MOTOR_LOAD_EVENT_STALL))
+	;
+motor_move(6, 300, MOTOR_MOVE_BLOCKING);
+\endcode
+* \param [in] size The number of motors in the range [1:#MOTOR_LOAD_MAX_MOTORS].
+* \param [in] id An array of unsigned integers specifying the ids. The motors are addressed by their index in this array.
+* \param [in] period_ms The time between two samples in ms.
+* \param [in] stall_load The stall threshold in the range [1:1023], 0 disables the stall detection.
+* \param [in] collision_rise The collision limit in the range [1:1023], 0 disables the collision detection.
+* \param [in] callback Function called in interrupt context with the index of the motor and its new events, or _NULL_.
+* \returns 1 in case of success, 0 if the parameters are invalid or #motor_init has not been called.
+*/
+int motor_load_start(const uint8_t size, const uint8_t * id, const uint8_t period_ms, const uint16_t stall_load, const uint16_t collision_rise, const motor_load_callback callback);
+
+/// Function to stop the load monitor.
+void motor_load_stop(void);
+
+/** Function to fetch the latched events of a watched motor.
+* \param [in] index The index of the motor in the array given to #motor_load_start.
+* \returns The events (MOTOR_LOAD_EVENT_*) raised since the last call, 0 if there are none or the monitor is not running.
+*/
+uint8_t motor_load_event(const uint8_t index);
+
+/** Function to get the last load sample of a watched motor.
+* \param [in] index The index of the motor in the array given to #motor_load_start.
+* \returns The present load in the range [-1023:1023], positive values are counterclockwise. It is 0 if the monitor
+* is not running or the motor has not answered yet.
+*/
+int16_t motor_load_get(const uint8_t index);
+
+/** Function to write the same control table range of several motors with a single SYNC_WRITE instruction.
+* The values of all motors are packed into one packet. If they exceed #MAXNUM_TXPARAM parameter bytes, as many
+* packets as necessary are sent.
+\par Example: set goal position and moving speed of two motors at the same time
+\code
+const uint8_t ids[2] = {1, 2};
+const uint8_t data[2 * 4] = {
+	0x00, 0x02, 0x00, 0x01,		// motor 1: position 512, speed 256
+	0xFF, 0x03, 0xFF, 0x03		// motor 2: position 1023, speed 1023
+};
+
+motor_sync_write(GOAL_POSITION_L, 4, 2, ids, data);
+\endcode
+* \param [in] start_address The first control table address to write, e.g. #GOAL_POSITION_L.
+* \param [in] bytes_per_motor The number of bytes to write to each motor.
+* \param [in] size The number of motors to write. The array parameters MUST be of this size.
+* \param [in] id An array of unsigned integers specifying the ids.
+* \param [in] data Buffer of _size_ * _bytes_per_motor_ bytes. The bytes of the motor _id[i]_ start at _data[i * bytes_per_motor]_.
+* \returns The communication result as returned by dxl_get_result(), _COMM_RXSUCCESS_ if all packets have been sent.
+*/
+int motor_sync_write(const uint8_t start_address, const uint8_t bytes_per_motor, const uint8_t size, const uint8_t * id, const uint8_t * data);
+
+/** Function to read the same control table range of several motors in one pass.
+* The read requests are issued back-to-back without any delay between them, each request is sent as soon as the
+* status packet of the previous motor has been received.
+\par Example: read the present position and speed of two motors
+\code
+const uint8_t ids[2] = {1, 2};
+uint8_t data[2 * 4];
+
+if (motor_sync_read(2, ids, PRESENT_POSITION_L, 4, data) == 2)
+	printf("Motor 2 is at position %u\n", data[4] | (data[5] << 8));
+\endcode
+* \param [in] size The number of motors to read. The array parameters MUST be of this size.
+* \param [in] id An array of unsigned integers specifying the ids.
+* \param [in] address The first control table address to read, e.g. #PRESENT_POSITION_L.
+* \param [in] length The number of bytes to read from each motor. Valid values are in the range [1:#MAXNUM_RXPARAM].
+* \param [out] data Buffer of _size_ * _length_ bytes. The bytes of the motor _id[i]_ are stored starting at _data[i * length]_.
+* The bytes of a motor which did not answer are left unchanged.
+* \returns The number of motors which have been read successfully.
+*/
+int motor_sync_read(const uint8_t size, const uint8_t * id, const uint8_t address, const uint8_t length, uint8_t * data);
+
+/** Function to read a contiguous range of the control table of a motor with a single READ instruction.
+\par Example: read the present speed and load of motor 1
+\code
+uint8_t data[4];
+if (motor_read_block(1, PRESENT_SPEED_L, 4, data) == COMM_RXSUCCESS)
+	printf("Load: %u\n", data[2] | (data[3] << 8));
+\endcode
+* \param [in] id The id of the motor.
+* \param [in] address The first control table address to read.
+* \param [in] length The number of bytes to read in the range [1:#MAXNUM_RXPARAM].
+* \param [out] buffer Buffer of _length_ bytes, left unchanged if the read fails.
+* \note The read is repeated according to the read policy of the motor, see #motor_set_read_policy.
+* \returns The communication result as returned by dxl_get_result().
+*/
+int motor_read_block(const uint8_t id, const uint8_t address, const uint8_t length, uint8_t * buffer);
+
+/** Function to read a contiguous range of the control table of a motor with its own timeout and retry settings.
+\par Example: check a motor which may be unplugged without stalling the loop
+\code
+motor_read_policy quick = {200, 0};
+uint8_t moving;
+if (motor_read_block_policy(3, MOVING, 1, &moving, &quick) != COMM_RXSUCCESS)
+	printf("Motor 3 did not answer\n");
+\endcode
+* \param [in] id The id of the motor.
+* \param [in] address The first control table address to read.
+* \param [in] length The number of bytes to read in the range [1:#MAXNUM_RXPARAM].
+* \param [out] buffer Buffer of _length_ bytes, left unchanged if the read fails.
+* \param [in] policy The timeout and retry settings of this read, _NULL_ for the policy of the motor.
+* \returns The communication result of the last attempt as returned by dxl_get_result().
+*/
+int motor_read_block_policy(const uint8_t id, const uint8_t address, const uint8_t length, uint8_t * buffer, const motor_read_policy * policy);
+
+/** Function to read a byte of the control table of a motor.
+* \param [in] id The id of the motor.
+* \param [in] address The control table address to read.
+* \param [out] value The value read, left unchanged if the read fails.
+* \returns The communication result as returned by dxl_get_result().
+*/
+int motor_read_byte(const uint8_t id, const uint8_t address, uint8_t * value);
+
+/** Function to read a word of the control table of a motor.
+\par Example:
+\code
+uint16_t position;
+if (motor_read_word(1, PRESENT_POSITION_L, &position) == COMM_RXSUCCESS)
+	printf("Position: %u\n", position);
+\endcode
+* \param [in] id The id of the motor.
+* \param [in] address The control table address of the low byte.
+* \param [out] value The value read, left unchanged if the read fails.
+* \returns The communication result as returned by dxl_get_result().
+*/
+int motor_read_word(const uint8_t id, const uint8_t address, uint16_t * value);
+
+/** Function to set the timeout and retry settings of the reads of a motor.
+* The settings apply to all reads of the motor layer including the background tasks. The default is a timeout of
+* #DXL_RETURN_TIMEOUT_US and no retries. With #MOTOR_TIMEOUT_ADAPTIVE the timeout is learned from the measured
+* return times of the motor (smoothed return time plus four times its mean deviation, at least
+* #MOTOR_TIMEOUT_MIN_US), thus a missing motor only stalls the bus for a fraction of the default timeout. A repeated
+* read doubles the learned timeout. Settings and statistics are kept for up to #MOTOR_LINK_MOTORS motors, further
+* motors use the default settings.
+\par Example: one unplugged leg must not slow down the gait
+\code
+motor_read_policy policy = {MOTOR_TIMEOUT_ADAPTIVE, 1};
+motor_set_read_policy(MOTOR_BROADCAST_ID, &policy);
+\endcode
+* \param [in] id The id of the motor, #MOTOR_BROADCAST_ID sets the default and the settings of all motors.
+* \param [in] policy The new settings.
+* \returns 1 in case of success, 0 if no more motors can be managed.
+*/
+int motor_set_read_policy(const uint8_t id, const motor_read_policy * policy);
+
+/** Function to read the return time statistics of a motor.
+* \param [in] id The id of the motor.
+* \param [out] stats Pointer to the statistics to fill.
+* \returns 1 in case of success, 0 if the motor has not been read yet.
+*/
+int motor_get_link_stats(const uint8_t id, motor_link_stats * stats);
+
+/** Function to search the bus for motors and fill the registry.
+* Each id is asked for its model number, firmware version, baudrate and return delay with a single READ instruction,
+* the requests follow each other without any pause. An id which does not answer only costs _timeout_us_ and the
+* transmission of the request, a scan of all ids takes about 175 ms with the default timeout. The registry is cleared
+* before and keeps the first #MOTOR_REGISTRY_SIZE motors found.
+\par Example: check the motors of the robot
+\code
+uint8_t i, ids[] = {6, 1, 3, 8, 2, 5};
+motor_scan(0, MOTOR_BROADCAST_ID - 1, MOTOR_SCAN_TIMEOUT_US);
+for (i = 0; i < sizeof(ids); i++)
+	if (motor_registry_find(ids[i]) < 0)
+		printf("Motor %u is missing\n", ids[i]);
+\endcode
+* \param [in] first_id The first id to ask.
+* \param [in] last_id The last id to ask, at most #MOTOR_BROADCAST_ID - 1.
+* \param [in] timeout_us The time in us a motor may take to start its answer, see #MOTOR_SCAN_TIMEOUT_US. It has to
+* cover the return delay time of the motors.
+* \returns The number of motors found.
+*/
+int motor_scan(const uint8_t first_id, const uint8_t last_id, const uint16_t timeout_us);
+
+/** Function to get the number of motors in the registry.
+* \returns The number of motors found by the last #motor_scan.
+*/
+uint8_t motor_registry_count(void);
+
+/** Function to read a registry entry.
+* \param [in] index The index of the entry in the range [0:#motor_registry_count - 1].
+* \param [out] info Pointer to the entry to fill.
+* \returns 1 in case of success, 0 if the index is invalid.
+*/
+int motor_registry_get(const uint8_t index, motor_info * info);
+
+/** Function to find a motor in the registry.
+* \param [in] id The id of the motor.
+* \returns The index of the registry entry or -1 if the motor has not been found by #motor_scan.
+*/
+int motor_registry_find(const uint8_t id);
+
+/** Function to start or stop the presence check of the registered motors.
+* The background tasks ping one registered motor per tick with the lowest priority, using the read policy of the
+* motor (see #motor_set_read_policy). A motor which misses #MOTOR_PRESENCE_MISSES pings in a row is marked as not
+* present, it is marked as present again as soon as it answers. Requires #motor_init.
+* \param [in] enable 1 to start the presence check, 0 to stop it.
+* \param [in] callback Function called (in interrupt context) on every change of the presence of a motor, may be _NULL_.
+*/
+void motor_set_presence_check(const uint8_t enable, const motor_presence_callback callback);
+
+/** Function to decode the raw telemetry bytes of a motor.
+* Useful together with #motor_queue_read to read the telemetry in the background.
+* \param [in] data The #MOTOR_TELEMETRY_LENGTH bytes of the control table starting at #PRESENT_POSITION_L.
+* \param [out] telemetry The decoded telemetry.
+*/
+void motor_decode_telemetry(const uint8_t * data, motor_telemetry * telemetry);
+
+/** Function to read position, speed, load, voltage and temperature of a motor with a single READ instruction.
+\par Example:
+\code
+motor_telemetry state;
+if (motor_get_telemetry(1, &state) == COMM_RXSUCCESS)
+	printf("Motor 1 at %u, %u.%u V, %u C\n", state.position, state.voltage / 10, state.voltage % 10, state.temperature);
+\endcode
+* \param [in] id The id of the motor.
+* \param [out] telemetry The decoded telemetry, left unchanged if the read fails.
+* \returns The communication result as returned by dxl_get_result().
+*/
+int motor_get_telemetry(const uint8_t id, motor_telemetry * telemetry);
+
+/** Function to read the telemetry of several motors in one pass, see #motor_get_telemetry and #motor_sync_read.
+* \param [in] size The number of motors to read. The array parameters MUST be of this size.
+* \param [in] id An array of unsigned integers specifying the ids.
+* \param [out] telemetry An array receiving the telemetry. The telemetry of a motor which did not answer is left unchanged.
+* \returns The number of motors which have been read successfully.
+*/
+int motor_sync_get_telemetry(const uint8_t size, const uint8_t * id, motor_telemetry * telemetry);
+
+/** Function to read the current position of several motors in one pass.
+* \param [in] size The number of motors to read. The array parameters MUST be of this size.
+* \param [in] id An array of unsigned integers specifying the ids.
+* \param [out] position An array receiving the current positions in the range [0:1023].
+* The position of a motor which did not answer is left unchanged.
+* \returns The number of motors which have been read successfully.
+* \note See #motor_sync_read for details.
+*/
+int motor_sync_get_position(const uint8_t size, const uint8_t * id, uint16_t * position);
+
+/** Function to write a range of the control table of a motor.
+* The library keeps a RAM shadow of the writable registers from #TORQUE_ENABLE to #PUNCH_H of up to
+* #MOTOR_SHADOW_MOTORS motors. A write is skipped if the motor is known to already have all values. All functions
+* of this library which set a control table value use this function, thus calling e.g. #motor_set_speed_dir
+* repeatedly with the same arguments does not load the bus.
+\par Example: enable the torque of motor 1
+\code
+const uint8_t enable = 1;
+motor_write(1, TORQUE_ENABLE, &enable, 1);
+\endcode
+* \param [in] id The id of the motor. Valid arguments are unsigned integer numbers or #MOTOR_BROADCAST_ID.
+* \param [in] address The first control table address to write.
+* \param [in] data The values to write.
+* \param [in] length The number of bytes to write.
+* \returns The communication result as returned by dxl_get_result(). The result of a skipped write is _COMM_RXSUCCESS_.
+* \note The shadow of a motor is invalidated if the motor reports an error, see #motor_shadow_invalidate.
+*/
+int motor_write(const uint8_t id, const uint8_t address, const uint8_t * data, const uint8_t length);
+
+/** Function to write a byte of the control table of a motor.
+* \param [in] id The id of the motor.
+* \param [in] address The control table address.
+* \param [in] value The value to write.
+* \returns The communication result, see #motor_write.
+*/
+int motor_write_byte(const uint8_t id, const uint8_t address, const uint8_t value);
+
+/** Function to write a word (two bytes, low byte first) of the control table of a motor.
+* \param [in] id The id of the motor.
+* \param [in] address The control table address of the low byte, e.g. #GOAL_POSITION_L.
+* \param [in] value The value to write.
+* \returns The communication result, see #motor_write.
+*/
+int motor_write_word(const uint8_t id, const uint8_t address, const uint16_t value);
+
+/** Function to change the shadow of a motor without writing it to the motor yet.
+* The changed registers are marked dirty and are written by #motor_shadow_flush. All dirty registers of a motor
+* are combined into as few write packets as possible (usually a single one).
+\par Example: change compliance slopes and punch in one packet
+\code
+const uint8_t slopes[2] = {64, 64};
+const uint8_t punch[2] = {50, 0};
+motor_shadow_set(1, CW_COMPLIANCE_SLOPE, slopes, 2);
+motor_shadow_set(1, PUNCH_L, punch, 2);
+motor_shadow_flush(1);
+\endcode
+* \param [in] id The id of the motor.
+* \param [in] address The first control table address to change.
+* \param [in] data The new values.
+* \param [in] length The number of bytes to change.
+* \returns The communication result. If the range is not shadowed (or the shadow is full) the values are written
+* immediately by #motor_write.
+*/
+int motor_shadow_set(const uint8_t id, const uint8_t address, const uint8_t * data, const uint8_t length);
+
+/** Function to write all dirty registers of a motor.
+* \param [in] id The id of the motor.
+* \returns The communication result of the last packet sent, _COMM_RXSUCCESS_ if nothing was dirty.
+*/
+int motor_shadow_flush(const uint8_t id);
+
+/// Function to write all dirty registers of all shadowed motors, see #motor_shadow_flush.
+void motor_shadow_flush_all(void);
+
+/** Function to discard the shadow of a motor.
+* Call this function if the control table of the motor has changed by other means, e.g. after a reset of the motor.
+* The next write of each register is sent to the motor.
+* \param [in] id The id of the motor or #MOTOR_BROADCAST_ID for all motors.
+*/
+void motor_shadow_invalidate(const uint8_t id);
+
+/** Function to read the control table write statistics.
+* \param [out] stats Pointer to the statistics to fill.
+*/
+void motor_get_write_stats(motor_write_stats * stats);
+
+/// Function to reset the control table write statistics.
+void motor_reset_write_stats(void);
+
+/** Function to stage a control table write of a motor without executing it.
+* The values are sent with the REG_WRITE instruction. The motor stores them and sets its #REGISTERED flag, but does
+* not apply them before #motor_commit is called. Thus motors which get different values, or even different
+* registers, start at the same time.
+\par Example: start two legs at the same time with different positions and speeds
+\code
+motor_stage_position_speed(1, 200, 300);
+motor_stage_position_speed(2, 800, 100);
+motor_stage_position(3, 512);
+motor_commit();
+\endcode
+* \param [in] id The id of the motor. Valid arguments are unsigned integer numbers or #MOTOR_BROADCAST_ID.
+* \param [in] address The first control table address to write.
+* \param [in] data The values to write.
+* \param [in] length The number of bytes to write.
+* \returns The communication result as returned by dxl_get_result().
+* \note A motor stores only one staged write. Staging a second write for the same motor before #motor_commit
+* replaces the first one, thus stage all registers of a motor with a single call.
+*/
+int motor_stage_write(const uint8_t id, const uint8_t address, const uint8_t * data, const uint8_t length);
+
+/** Function to stage a new goal position of a motor, see #motor_stage_write.
+* \param [in] id The id of the motor. Valid arguments are unsigned integer numbers or #MOTOR_BROADCAST_ID.
+* \param [in] position The desired position in the [0:1023] range.
+* \returns The communication result as returned by dxl_get_result().
+*/
+int motor_stage_position(const uint8_t id, const uint16_t position);
+
+/** Function to stage a new goal position and moving speed of a motor, see #motor_stage_write.
+* \param [in] id The id of the motor. Valid arguments are unsigned integer numbers or #MOTOR_BROADCAST_ID.
+* \param [in] position The desired position in the [0:1023] range.
+* \param [in] speed The desired moving speed in the [0:1023] range (0 is the maximum speed).
+* \returns The communication result as returned by dxl_get_result().
+*/
+int motor_stage_position_speed(const uint8_t id, const uint16_t position, const uint16_t speed);
+
+/** Function to execute the staged writes of all motors at the same time.
+* A single ACTION instruction is broadcast to all motors, see #motor_stage_write.
+* \returns The communication result as returned by dxl_get_result().
+* \note Use #motor_track_move to wait for the motors to reach their positions.
+*/
+int motor_commit(void);
+
+/** Function to configure which instructions a motor answers with a status packet.
+* The level is stored in the EEPROM of the motor (#STATUS_RETURN_LEVEL) and tracked by the bus driver, which
+* waits only for the status packets the motor actually sends. With #STATUS_RETURN_READ writes do not wait
+* for an answer, which halves the bus time of a write, while all reads keep working.
+* The EEPROM is only written if the motor has a different level.
+\par Example: configure both wheels for fast writes
+\code
+motor_set_status_return_level(MOTOR_LEFT, STATUS_RETURN_READ);
+motor_set_status_return_level(MOTOR_RIGHT, STATUS_RETURN_READ);
+\endcode
+* \param [in] id The id of the motor. Valid arguments are unsigned integer numbers or #MOTOR_BROADCAST_ID.
+* \param [in] level The status return level, one of _STATUS_RETURN_NONE_ (only PING is answered),
+* _STATUS_RETURN_READ_ (only PING and READ are answered) or _STATUS_RETURN_ALL_ (default).
+* \returns The communication result as returned by dxl_get_result().
+* \note With _STATUS_RETURN_NONE_ reads of the motor fail, and errors reported by the motor go unnoticed.
+*/
+int motor_set_status_return_level(const uint8_t id, const uint8_t level);
+
+/** Function to read the status return level of a motor.
+* The level is tracked by the bus driver afterwards. Call this function at startup for motors which have been
+* configured before, so that the driver does not wait for status packets which are never sent.
+* \param [in] id The id of the motor.
+* \returns The status return level or -1 if the motor did not answer.
+*/
+int motor_read_status_return_level(const uint8_t id);
+
+/** Function to set the time a motor waits before it sends a status packet.
+* The value is stored in the EEPROM of the motor (#RETURN_DELAY_TIME) and only written if it has changed.
+* \param [in] id The id of the motor. Valid arguments are unsigned integer numbers or #MOTOR_BROADCAST_ID.
+* \param [in] delay_us The return delay time in microseconds in the range [0:508], with a resolution of 2 us.
+* \returns The communication result as returned by dxl_get_result().
+*/
+int motor_set_return_delay(const uint8_t id, const uint16_t delay_us);
+
+/** Function to queue a read of a control table range for the background tasks.
+* The background tasks schedule the bus: queued transactions are sent back-to-back in the order of their priority
+* (#MOTOR_PRIORITY_HIGH first), as long as the bus is not used by the main program and the bus budget of the
+* current tick (see #motor_set_bus_budget) is not exhausted. Thus no delays are needed to not overload the bus.
+\par Example: read the temperature of motor 1 in the background
+\code
+void temperature_read(const motor_transaction * transaction)
+{
+	if (transaction->result == COMM_RXSUCCESS)
+		temperature = transaction->data[0];
+}
+
+motor_queue_read(1, PRESENT_TEMPERATURE, 1, MOTOR_PRIORITY_LOW, &temperature_read);
+\endcode
+* \param [in] id The id of the motor.
+* \param [in] address The first control table address to read.
+* \param [in] length The number of bytes to read in the range [1:#MOTOR_QUEUE_MAX_DATA].
+* \param [in] priority The priority, one of #MOTOR_PRIORITY_HIGH, #MOTOR_PRIORITY_NORMAL or #MOTOR_PRIORITY_LOW.
+* \param [in] callback Function called (in interrupt context) with the result or _NULL_.
+* \returns 1 if the transaction has been queued and 0 if the queue is full or the arguments are invalid.
+* \note The background tasks have to be started by #motor_init.
+*/
+int motor_queue_read(const uint8_t id, const uint8_t address, const uint8_t length, const uint8_t priority, const motor_transaction_callback callback);
+
+/** Function to queue a write of a control table range for the background tasks, see #motor_queue_read.
+* \param [in] id The id of the motor. Valid arguments are unsigned integer numbers or #MOTOR_BROADCAST_ID.
+* \param [in] address The first control table address to write.
+* \param [in] data The values to write, they are copied.
+* \param [in] length The number of bytes to write in the range [1:#MOTOR_QUEUE_MAX_DATA].
+* \param [in] priority The priority, one of #MOTOR_PRIORITY_HIGH, #MOTOR_PRIORITY_NORMAL or #MOTOR_PRIORITY_LOW.
+* \param [in] callback Function called (in interrupt context) with the result or _NULL_.
+* \returns 1 if the transaction has been queued and 0 if the queue is full or the arguments are invalid.
+*/
+int motor_queue_write(const uint8_t id, const uint8_t address, const uint8_t * data, const uint8_t length, const uint8_t priority, const motor_transaction_callback callback);
+
+/** Function to set the bus time the background tasks may use per tick.
+* The background tasks stop sending transactions in a tick as soon as they have used the bus for this time,
+* the remaining time of the tick is left for the main program.
+* \param [in] budget_us The bus time in us per 1 ms tick. The default is #MOTOR_BUS_BUDGET_US.
+*/
+void motor_set_bus_budget(const uint16_t budget_us);
+
+/** Function to read the statistics of a transaction queue.
+* \param [in] priority The priority of the queue.
+* \param [out] stats Pointer to the statistics to fill.
+*/
+void motor_get_queue_stats(const uint8_t priority, motor_queue_stats * stats);
+
+/// Function to reset the statistics of all transaction queues.
+void motor_reset_queue_stats(void);
+
+/** Function to log the bus errors which have been counted since the last report.
+* The driver counts the failed transactions and the error bits of the status packets of every motor (see
+* dxl_get_error_counts() in dynamixel.h) without any output on the serial interface. This function logs only
+* the counters which changed, one message of log.h per motor and error class, and returns immediately if the last
+* report is more recent than _interval_ms_, thus it may be called in every loop of the main program. The errors of
+* the motors without an own counter are logged with the id #MOTOR_BROADCAST_ID.
+\par Example:
+\code
+log_init(&serial_write);
+while (1) {
+	motor_sync_move(size, ids, positions, MOTOR_MOVE_NON_BLOCKING);
+	// Logs e.g. "Motor 3: 2 RXTIMEOUT" and "Motor 3: 1 overload" once per second at most
+	motor_report_errors(1000);
+}
+\endcode
+* \param [in] interval_ms The minimum time between two reports in ms.
+* \returns The number of motors with new errors, 0 if nothing has been reported.
+*/
+int motor_report_errors(const uint16_t interval_ms);
+
+/// Function to reset the error counters of the driver and the state of #motor_report_errors.
+void motor_reset_errors(void);
+
+/** Function to log communication error status (see log.h).
 * This function can be used to output 
 \par Example:
  \code
@@ -175,13 +1082,15 @@ int result = dxl_get_result();       //check communication
 		PrintCommStatus(result);  //print error
  \endcode
 * \param [in] CommStatus Should be the return value of dxl_get_result() function defined in dynamixel.h  
-* \note This function was in the example code that came with the Dynamixel SDK
+* \note This function was in the example code that came with the Dynamixel SDK. The motor functions do not call it
+* anymore, the errors are counted by the driver and printed by #motor_report_errors.
 */
 
 void PrintCommStatus(int CommStatus);
 
-/** Function to print motor error status (overheat,  input voltage error, etc...).
-* \note This function was in the example code that came with the Dynamixel SDK
+/** Function to log motor error status (overheat,  input voltage error, etc...) of the last status packet (see log.h).
+* \note This function was in the example code that came with the Dynamixel SDK. Use #motor_report_errors to print
+* the errors of all transactions without blocking the main loop.
 */
 
 void PrintErrorCode();
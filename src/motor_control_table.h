@@ -1,7 +1,7 @@
 /*! \file motor_control_table.h
     \author Walter Gambelunghe
     \copyright GNU Public License V3
-    \brief Symbolic definitions for the dynamixel internal RAM memory addresses.
+    \brief Symbolic definitions for the dynamixel internal EEPROM and RAM memory addresses.
     See <a href="http://support.robotis.com/en/product/dynamixel/ax_series/dxl_ax_actuator.htm"> Dynamixel documentation </a> for detailed description
  */
 
@@ -9,6 +9,30 @@
 #define __MOTOR_CONTROL_TABLE
 
 //DEFINE	NAME				ADDRESS	//HEX	 COMMENT 				RW 	INITIAL VALUE
+// EEPROM area, the values are kept after power off
+#define MODEL_NUMBER_L		0		//(0X00)	Lowest byte of model number	R	12 (0X0C)
+
+#define MODEL_NUMBER_H		1		//(0X01)	Highest byte of model number	R	0 (0X00)
+
+#define VERSION_OF_FIRMWARE	2		//(0X02)	Information on the version of firmware	R	-
+
+#define MOTOR_ID			3		//(0X03)	ID of Dynamixel			RW	1 (0X01)
+
+#define BAUD_RATE			4		//(0X04)	Baud Rate of Dynamixel		RW	1 (0X01)
+
+#define RETURN_DELAY_TIME	5		//(0X05)	Return Delay Time (2 us per unit)	RW	250 (0XFA)
+
+#define CW_ANGLE_LIMIT_L	6		//(0X06)	Lowest byte of clockwise Angle Limit	RW	0 (0X00)
+
+#define CW_ANGLE_LIMIT_H	7		//(0X07)	Highest byte of clockwise Angle Limit	RW	0 (0X00)
+
+#define CCW_ANGLE_LIMIT_L	8		//(0X08)	Lowest byte of counterclockwise Angle Limit	RW	255 (0XFF)
+
+#define CCW_ANGLE_LIMIT_H	9		//(0X09)	Highest byte of counterclockwise Angle Limit	RW	3 (0X03)
+
+#define STATUS_RETURN_LEVEL	16		//(0X10)	Status Return Level		RW	2 (0X02)
+
+// RAM area
 #define TORQUE_ENABLE 		24 		//(0X18) 	Torque On/Off 			RW 	0 (0X00)
 
 #define LED 				25		// (0X19)	LED On/Off				RW	0 (0X00)
@@ -9,21 +9,49 @@
 #include <avr/interrupt.h>
 #include <util/atomic.h>
 #include "serial.h"
+#include "serial_ring.h"
 
-#define MAXNUM_SERIALBUFF	128
 #define DEFAULT_BAUDRATE	34 // 57132(57600)bps
 
 #define DIR_RXD 	PORTE &= ~0x04, PORTE |= 0x08
 
-volatile unsigned char gbSerialBuffer[MAXNUM_SERIALBUFF] = {0};
-volatile unsigned char gbSerialBufferHead = 0;
-volatile unsigned char gbSerialBufferTail = 0;
 static FILE *device;
 
 static volatile serial_rx_callback rx_callback = NULL;
 
-void serial_put_queue( unsigned char data );
-unsigned char serial_get_queue(void);
+/// \endcond
+
+/// \private Mask for the transmit ring buffer indices.
+#define SERIAL_TX_MASK		(SERIAL_TX_BUFFER_SIZE - 1)
+
+/// \private Transmit ring buffer.
+static volatile unsigned char serial_tx_buffer[SERIAL_TX_BUFFER_SIZE];
+/// \private Read position of the transmit ring buffer, only changed by the interrupt or with interrupts disabled.
+static volatile uint8_t serial_tx_head = 0;
+/// \private Write position of the transmit ring buffer.
+static volatile uint8_t serial_tx_tail = 0;
+/// \private Policy if the transmit ring buffer is full, one of SERIAL_TX_*.
+static volatile uint8_t serial_tx_policy = SERIAL_TX_BLOCK;
+/// \private Statistics of the transmit ring buffer.
+static volatile serial_tx_stats serial_tx_statistics = {0, 0};
+/// \private Receive ring buffer, filled by the receive interrupt.
+static serial_ring serial_rx_ring;
+
+/// \private Registered command handler.
+typedef struct {
+	/// Command byte.
+	unsigned char command;
+	/// Handler of the command.
+	serial_command_handler handler;
+} serial_command_entry;
+
+/// \private Registered command handlers, only used in the main program.
+static serial_command_entry serial_commands[SERIAL_MAX_COMMANDS];
+/// \private Number of registered command handlers.
+static uint8_t serial_command_count = 0;
+
+/// \cond Ignore this part of the documentation
+
 int std_putchar(char c);
 int std_getchar(void);
 
@@ -61,8 +89,8 @@ void serial_initialize(long ubrr)
 
 	// initialize
 	UDR1 = 0xFF;
-	gbSerialBufferHead = 0;
-	gbSerialBufferTail = 0;
+	serial_ring_init(&serial_rx_ring);
+	serial_tx_head = serial_tx_tail = 0;
 
 	// set baudrate
 	UBRR1H = (unsigned char)(baud>>8);
@@ -71,85 +99,149 @@ void serial_initialize(long ubrr)
 	device = fdevopen( std_putchar, std_getchar );
 }
 
-void serial_write( unsigned char *pData, int numbyte )
+/// \endcond
+
+/// \private Function to send the next byte of the transmit ring by polling, used while interrupts are disabled.
+static void serial_tx_poll(void)
+{
+	if (serial_tx_head != serial_tx_tail && bit_is_set(UCSR1A, UDRE1))
+	{
+		UDR1 = serial_tx_buffer[serial_tx_head];
+		serial_tx_head = (serial_tx_head + 1) & SERIAL_TX_MASK;
+	}
+}
+
+/// \private Function to queue one byte according to the transmit policy, returns 1 if it has been queued.
+static uint8_t serial_tx_put(const unsigned char data)
+{
+	uint8_t next, used, queued = 0, waiting = 1;
+	while (waiting)
+	{
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+		{
+			next = (serial_tx_tail + 1) & SERIAL_TX_MASK;
+			if (next == serial_tx_head && serial_tx_policy == SERIAL_TX_OVERWRITE)
+			{
+				// Make room by discarding the oldest byte
+				serial_tx_head = (serial_tx_head + 1) & SERIAL_TX_MASK;
+				serial_tx_statistics.dropped++;
+			}
+			else if (next == serial_tx_head && serial_tx_policy == SERIAL_TX_DROP)
+				waiting = 0;
+			if (waiting && next != serial_tx_head)
+			{
+				serial_tx_buffer[serial_tx_tail] = data;
+				serial_tx_tail = next;
+				used = (next - serial_tx_head) & SERIAL_TX_MASK;
+				if (used > serial_tx_statistics.high_water)
+					serial_tx_statistics.high_water = used;
+				// Start transmission
+				UCSR1B |= _BV(UDRIE1);
+				queued = 1;
+				waiting = 0;
+			}
+		}
+		// Buffer full, the interrupt cannot drain it while interrupts are disabled
+		if (waiting && !bit_is_set(SREG, SREG_I))
+			serial_tx_poll();
+	}
+	return queued;
+}
+
+int serial_write(const unsigned char *pData, int numbyte)
 {
 	int count;
+	for (count = 0; count < numbyte; count++)
+		if (!serial_tx_put(pData[count]))
+			break;
+	// The rest is discarded, so the output has no gaps in the middle
+	if (count < numbyte)
+	{
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+		{
+			serial_tx_statistics.dropped += numbyte - count;
+		}
+	}
+	return count;
+}
+
+void serial_set_tx_policy(const uint8_t policy)
+{
+	serial_tx_policy = policy;
+}
 
-	for( count=0; count<numbyte; count++ )
+void serial_get_tx_stats(serial_tx_stats * stats)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
 	{
-		while(!bit_is_set(UCSR1A,5));
-		UDR1 = pData[count];
+		*stats = *(serial_tx_stats *)&serial_tx_statistics;
 	}
 }
 
-unsigned char serial_read( unsigned char *pData, int numbyte )
+void serial_reset_tx_stats(void)
 {
-	int count, numgetbyte;
-	
-	if( gbSerialBufferHead == gbSerialBufferTail )
-		return 0;
-	
-	numgetbyte = serial_get_qstate();
-	if( numgetbyte > numbyte )
-		numgetbyte = numbyte;
-	
-	for( count=0; count<numgetbyte; count++ )
-		pData[count] = serial_get_queue();
-	
-	return numgetbyte;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		serial_tx_statistics.high_water = 0;
+		serial_tx_statistics.dropped = 0;
+	}
 }
 
-int serial_get_qstate(void)
+uint16_t serial_get_rx_overflows(void)
 {
-	short NumByte;
-	
-	if( gbSerialBufferHead == gbSerialBufferTail )
-		NumByte = 0;
-	else if( gbSerialBufferHead < gbSerialBufferTail )
-		NumByte = gbSerialBufferTail - gbSerialBufferHead;
-	else
-		NumByte = MAXNUM_SERIALBUFF - (gbSerialBufferHead - gbSerialBufferTail);
-	
-	return (int)NumByte;
+	uint16_t overflows;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		overflows = serial_rx_ring.overflows;
+	}
+	return overflows;
 }
 
-void serial_put_queue( unsigned char data )
+void serial_reset_rx_overflows(void)
 {
-	if( serial_get_qstate() == (MAXNUM_SERIALBUFF-1) )
-		return;
-	
-	gbSerialBuffer[gbSerialBufferTail] = data;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		serial_rx_ring.overflows = 0;
+	}
+}
 
-	if( gbSerialBufferTail == (MAXNUM_SERIALBUFF-1) )
-		gbSerialBufferTail = 0;
-	else
-		gbSerialBufferTail++;
+/// \cond Ignore this part of the documentation
+
+unsigned char serial_read( unsigned char *pData, int numbyte )
+{
+	if( numbyte <= 0 )
+		return 0;
+	return serial_ring_read(&serial_rx_ring, pData, numbyte);
 }
 
-unsigned char serial_get_queue(void)
+int serial_get_qstate(void)
 {
-	unsigned char data;
-	
-	if( gbSerialBufferHead == gbSerialBufferTail )
-		return 0xff;
-		
-	data = gbSerialBuffer[gbSerialBufferHead];
-		
-	if( gbSerialBufferHead == (MAXNUM_SERIALBUFF-1) )
-		gbSerialBufferHead = 0;
-	else
-		gbSerialBufferHead++;
-		
-	return data;
+	return serial_ring_count(&serial_rx_ring);
 }
 
 SIGNAL(USART1_RX_vect)
 {
-	serial_put_queue( UDR1 );
+	serial_ring_put(&serial_rx_ring, UDR1);
 	if (rx_callback != NULL)
 		rx_callback();
 }
 
+/// \endcond
+
+/// \private Data register empty interrupt: send next byte of the transmit ring.
+ISR(USART1_UDRE_vect)
+{
+	if (serial_tx_head != serial_tx_tail)
+	{
+		UDR1 = serial_tx_buffer[serial_tx_head];
+		serial_tx_head = (serial_tx_head + 1) & SERIAL_TX_MASK;
+	}
+	else
+		UCSR1B &= ~_BV(UDRIE1);
+}
+
+/// \cond Ignore this part of the documentation
+
 int std_putchar(char c)
 {
 	char tx[2];
@@ -171,10 +263,9 @@ int std_putchar(char c)
 
 int std_getchar(void)
 {
-    char rx;
+    unsigned char rx;
 	
-	while( serial_get_qstate() == 0 );
-	rx = serial_get_queue();
+	while( !serial_ring_get(&serial_rx_ring, &rx) );
 	
 	if( rx == '\r' )
 		rx = '\n';
@@ -190,4 +281,52 @@ void serial_set_rx_callback(const serial_rx_callback callback)
 	{
 		rx_callback = callback;
 	}
-}
\ No newline at end of file
+}
+
+int serial_set_command_handler(const unsigned char command, const serial_command_handler handler)
+{
+	uint8_t i;
+	for (i = 0; i < serial_command_count; i++)
+		if (serial_commands[i].command == command)
+			break;
+	if (handler == NULL)
+	{
+		// Move the last entry into the gap
+		if (i < serial_command_count)
+			serial_commands[i] = serial_commands[--serial_command_count];
+		return 1;
+	}
+	if (i == serial_command_count)
+	{
+		if (serial_command_count >= SERIAL_MAX_COMMANDS)
+			return 0;
+		serial_commands[i].command = command;
+		serial_command_count++;
+	}
+	serial_commands[i].handler = handler;
+	return 1;
+}
+
+uint8_t serial_poll(void)
+{
+	uint8_t pending = serial_ring_count(&serial_rx_ring);
+	uint8_t handled = 0, head, taken, i;
+	unsigned char data;
+	// Only the bytes received so far
+	while (pending > 0 && serial_ring_get(&serial_rx_ring, &data))
+	{
+		pending--;
+		for (i = 0; i < serial_command_count; i++)
+			if (serial_commands[i].command == data)
+			{
+				head = serial_rx_ring.head;
+				serial_commands[i].handler(data);
+				handled++;
+				// Parameter bytes removed by the handler are not pending anymore
+				taken = (serial_rx_ring.head - head) & SERIAL_RING_MASK;
+				pending = taken < pending ? pending - taken : 0;
+				break;
+			}
+	}
+	return handled;
+}
@@ -10,24 +10,92 @@
 	The source code including documentation can be found in their <a href="http://support.robitis.com/en/">e-manual</a>. Additionally,
 	we have added the possibility to register a callback function which is called whenever a char is received over
 	the serial interface. This function #serial_set_rx_callback is described here.
+
+	The transmission has been changed to be interrupt-driven: #serial_write (and thus _printf()_) only copies the
+	bytes into a transmit ring buffer of #SERIAL_TX_BUFFER_SIZE bytes, which is drained by the data register empty
+	interrupt of UART1. What happens if the buffer is full is selected by #serial_set_tx_policy. Received bytes are
+	stored by the receive interrupt in a lock-free ring buffer (see serial_ring.h), lost bytes are counted (see
+	#serial_get_rx_overflows).
+
+	Commands should not be handled in the receive callback, since it runs in the receive interrupt and blocks all
+	other interrupts meanwhile. Instead handlers are registered for command bytes by #serial_set_command_handler and
+	called by #serial_poll from the main loop (deferred dispatch), the receive interrupt then only stores the bytes.
  */
 #ifndef _SERIAL_HEADER
 #define _SERIAL_HEADER
 
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/// Size of the transmit ring buffer in bytes. Must be a power of two.
+#define SERIAL_TX_BUFFER_SIZE	128
+
+/// Transmit policy: bytes which do not fit into the full transmit buffer are discarded.
+#define SERIAL_TX_DROP			0
+/// Transmit policy: wait until the bytes fit into the transmit buffer (default).
+#define SERIAL_TX_BLOCK			1
+/// Transmit policy: the oldest bytes in the full transmit buffer are discarded to make room for the new ones.
+#define SERIAL_TX_OVERWRITE		2
+
+/// Maximum number of command handlers, see #serial_set_command_handler.
+#define SERIAL_MAX_COMMANDS		16
+
 /// Receive callback function definition.
 typedef void (*serial_rx_callback)(void);
 
+/// Command handler function definition, the parameter is the received command byte.
+typedef void (*serial_command_handler)(const unsigned char command);
+
+/// Statistics of the transmit buffer, see #serial_get_tx_stats.
+typedef struct {
+	/// Maximum number of bytes which have been waiting in the transmit buffer.
+	uint8_t high_water;
+	/// Number of bytes discarded since the transmit buffer was full.
+	uint16_t dropped;
+} serial_tx_stats;
+
 /// \cond Ignore this part from documentation.
 void serial_initialize(long ubrr);
-void serial_write( unsigned char *pData, int numbyte );
 unsigned char serial_read( unsigned char *pData, int numbyte );
 int serial_get_qstate(void);
 /// \endcond
 
+/** Function to send data over the serial connection.
+	The bytes are copied into the transmit ring buffer and sent by the transmit interrupt, the function only waits
+	if the buffer is full and the policy is #SERIAL_TX_BLOCK. With disabled interrupts (e.g. in a callback) the
+	waiting bytes are sent by polling instead.
+	\param[in]	pData		Bytes to send.
+	\param[in]	numbyte		Number of bytes to send.
+	\returns The number of bytes queued. It is less than _numbyte_ only with the policy #SERIAL_TX_DROP.
+ */
+int serial_write(const unsigned char *pData, int numbyte);
+
+/** Function to select what happens if the transmit buffer is full.
+	\param[in]	policy		One of #SERIAL_TX_DROP, #SERIAL_TX_BLOCK or #SERIAL_TX_OVERWRITE.
+ */
+void serial_set_tx_policy(const uint8_t policy);
+
+/** Function to read the statistics of the transmit buffer.
+	The high water mark tells how large #SERIAL_TX_BUFFER_SIZE has to be so no output waits or gets lost.
+	\param[out]	stats		Pointer to the statistics to fill.
+ */
+void serial_get_tx_stats(serial_tx_stats * stats);
+
+/// Function to reset the statistics of the transmit buffer.
+void serial_reset_tx_stats(void);
+
+/** Function to get the number of received bytes which have been lost since the receive buffer was full.
+	The receive buffer is a ring of #SERIAL_RX_BUFFER_SIZE bytes, see serial_ring.h.
+	\returns The number of lost bytes since #serial_initialize or #serial_reset_rx_overflows.
+ */
+uint16_t serial_get_rx_overflows(void);
+
+/// Function to reset the counter of lost received bytes.
+void serial_reset_rx_overflows(void);
+
 /** Function to register a data receive callback function.
 	This function registers a callback function to be called in case one character is received over the
 	serial connection. The received character can be read by calling _serial_read()_.
@@ -39,6 +107,40 @@ int serial_get_qstate(void);
  */
 void serial_set_rx_callback(const serial_rx_callback callback);
 
+/** Function to register a handler for a command byte.
+	The handler is not called by the receive interrupt but by #serial_poll in the main loop, so it may print,
+	access the motors or read sensors without holding off other interrupts. The same handler may be registered
+	for several commands. This function must not be called from an interrupt.
+	\param[in]	command				Received byte which triggers the handler.
+	\param[in]	handler				Handler to be called, it replaces a handler registered before for the same command.
+	Assign this parameter to _NULL_ to remove the handler.
+	\returns The function returns 1 in case of success and 0 if #SERIAL_MAX_COMMANDS handlers are registered already.
+	\par Example:
+\code
+void command_received(const unsigned char command)
+{
+	printf("Command %c received.\n", command);
+}
+
+serial_set_command_handler('p', &command_received);
+while (1)
+{
+	serial_poll();
+	// ...
+}
+\endcode
+ */
+int serial_set_command_handler(const unsigned char command, const serial_command_handler handler);
+
+/** Function to dispatch the received commands to their handlers.
+	This function is to be called regularly from the main loop. It removes the bytes which have been received up to
+	the call from the receive buffer and calls the registered handler of each of them, bytes without a handler are
+	discarded. Bytes received meanwhile are left for the next call, so a steady stream of commands does not stall
+	the main loop. A handler may read parameter bytes following its command with _serial_read()_.
+	\returns The number of handlers called.
+ */
+uint8_t serial_poll(void);
+
 #ifdef __cplusplus
 }
 #endif
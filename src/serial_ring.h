@@ -0,0 +1,158 @@
+/*! \file serial_ring.h
+    \brief Lock-free single-producer/single-consumer ring buffer for the serial connection.
+	\author Team Kick-Ass
+	\copyright GNU Public License V3
+	\date 2012
+
+	\file serial_ring.h
+	\details This file implements the receive buffer of the serial connection (serial.c) as a ring of
+	#SERIAL_RX_BUFFER_SIZE bytes. Exactly one producer (the receive interrupt) calls #serial_ring_put and exactly one
+	consumer (the main program) calls #serial_ring_get and #serial_ring_read, so no locking is needed: the producer
+	only writes the tail and the consumer only writes the head, each after the data it publishes or releases. The
+	order of the data and index accesses is enforced by compiler barriers (#SERIAL_RING_BARRIER), since the data is
+	not volatile. The indices are 8 bit wide and thus read and written atomically on the AVR. The size is a power of two, so the
+	indices wrap with a mask instead of a branch. One byte of the ring always stays free to tell a full ring from an
+	empty one.
+
+	All functions are inline and free of hardware dependencies, so the ring also builds on a Linux host, e.g.:
+\code
+gcc -I src my_benchmark.c
+\endcode
+
+	\par Example:
+\code
+static serial_ring ring;
+unsigned char data[16];
+serial_ring_init(&ring);
+serial_ring_put(&ring, 'a');
+uint8_t count = serial_ring_read(&ring, data, sizeof(data));
+\endcode
+ */
+#ifndef _SERIAL_RING_HEADER
+#define _SERIAL_RING_HEADER
+
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef SERIAL_RX_BUFFER_SIZE
+/// Size of the receive ring buffer in bytes. Must be a power of two in the range [2:256], can be set by the compiler flags.
+#define SERIAL_RX_BUFFER_SIZE	128
+#endif
+
+/// Mask for the ring buffer indices.
+#define SERIAL_RING_MASK		(SERIAL_RX_BUFFER_SIZE - 1)
+
+/// Compiler barrier: memory accesses are not moved across it, so the data is copied between the index accesses.
+#define SERIAL_RING_BARRIER()	__asm__ __volatile__("" ::: "memory")
+
+/// \private Compile time check of #SERIAL_RX_BUFFER_SIZE, the array size is negative if it is invalid.
+typedef char serial_ring_size_check[(SERIAL_RX_BUFFER_SIZE >= 2 && SERIAL_RX_BUFFER_SIZE <= 256
+	&& (SERIAL_RX_BUFFER_SIZE & SERIAL_RING_MASK) == 0) ? 1 : -1];
+
+/// Single-producer/single-consumer ring buffer.
+typedef struct {
+	/// Read position, only changed by the consumer.
+	volatile uint8_t head;
+	/// Write position, only changed by the producer.
+	volatile uint8_t tail;
+	/// Number of bytes discarded since the ring was full, only changed by the producer.
+	volatile uint16_t overflows;
+	/// Stored bytes.
+	unsigned char data[SERIAL_RX_BUFFER_SIZE];
+} serial_ring;
+
+/** Function to empty a ring and reset its overflow counter.
+	Neither producer nor consumer may use the ring meanwhile.
+	\param[out]	ring	The ring.
+ */
+static inline void serial_ring_init(serial_ring * ring)
+{
+	ring->head = 0;
+	ring->tail = 0;
+	ring->overflows = 0;
+}
+
+/** Function to append a byte, called by the producer only.
+	\param[in,out]	ring	The ring.
+	\param[in]		value	The byte to append.
+	\returns 1 in case of success, 0 if the ring is full. The byte is discarded and counted then.
+ */
+static inline uint8_t serial_ring_put(serial_ring * ring, const unsigned char value)
+{
+	uint8_t tail = ring->tail;
+	uint8_t next = (tail + 1) & SERIAL_RING_MASK;
+	if (next == ring->head)
+	{
+		ring->overflows++;
+		return 0;
+	}
+	ring->data[tail] = value;
+	// Publish the byte after it has been stored
+	SERIAL_RING_BARRIER();
+	ring->tail = next;
+	return 1;
+}
+
+/** Function to get the number of stored bytes.
+	\param[in]	ring	The ring.
+	\returns The number of bytes the consumer can read. The producer may append further bytes meanwhile.
+ */
+static inline uint8_t serial_ring_count(const serial_ring * ring)
+{
+	return (ring->tail - ring->head) & SERIAL_RING_MASK;
+}
+
+/** Function to remove the oldest byte, called by the consumer only.
+	\param[in,out]	ring	The ring.
+	\param[out]		value	The removed byte.
+	\returns 1 in case of success, 0 if the ring is empty.
+ */
+static inline uint8_t serial_ring_get(serial_ring * ring, unsigned char * value)
+{
+	uint8_t head = ring->head;
+	if (head == ring->tail)
+		return 0;
+	// Read the byte only after the tail has been checked
+	SERIAL_RING_BARRIER();
+	*value = ring->data[head];
+	// Release the byte after it has been copied
+	SERIAL_RING_BARRIER();
+	ring->head = (head + 1) & SERIAL_RING_MASK;
+	return 1;
+}
+
+/** Function to remove up to _length_ of the oldest bytes, called by the consumer only.
+	The bytes are copied in at most two contiguous spans (before and after the wrap-around) and released at once.
+	\param[in,out]	ring	The ring.
+	\param[out]		buffer	Buffer for the removed bytes.
+	\param[in]		length	Size of the buffer.
+	\returns The number of removed bytes.
+ */
+static inline uint8_t serial_ring_read(serial_ring * ring, unsigned char * buffer, const uint16_t length)
+{
+	uint8_t head = ring->head;
+	uint16_t count = (ring->tail - head) & SERIAL_RING_MASK;
+	uint16_t span = SERIAL_RX_BUFFER_SIZE - head;
+	if (count > length)
+		count = length;
+	if (span > count)
+		span = count;
+	// Read the bytes only after the tail has been read
+	SERIAL_RING_BARRIER();
+	memcpy(buffer, &ring->data[head], span);
+	memcpy(buffer + span, &ring->data[0], count - span);
+	// Release the bytes after they have been copied
+	SERIAL_RING_BARRIER();
+	ring->head = (head + count) & SERIAL_RING_MASK;
+	return (uint8_t)count;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
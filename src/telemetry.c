@@ -0,0 +1,151 @@
+/*! \file telemetry.c
+    \brief Binary telemetry stream of the robot state over the serial connection (declaration part, see telemetry.h for an interface description).
+ */
+
+#include <stddef.h>
+#include <string.h>
+#include <util/atomic.h>
+#include "telemetry.h"
+
+/// \private Mask for the record queue indices.
+#define TELEMETRY_QUEUE_MASK	(TELEMETRY_QUEUE_SIZE - 1)
+
+/// \private Sampled record.
+typedef struct {
+	/// Sequence number.
+	uint16_t sequence;
+	/// Bytes of the signals.
+	uint8_t data[TELEMETRY_MAX_RECORD];
+} telemetry_record;
+
+/// \private Addresses of the signals.
+static const volatile uint8_t * telemetry_address[TELEMETRY_MAX_SIGNALS];
+/// \private Sizes of the signals.
+static uint8_t telemetry_size[TELEMETRY_MAX_SIGNALS];
+/// \private Number of signals.
+static uint8_t telemetry_count = 0;
+/// \private Number of bytes of all signals.
+static uint8_t telemetry_length = 0;
+
+/// \private Set while the stream is running.
+static volatile uint8_t telemetry_running = 0;
+/// \private Time between two records in ms.
+static uint16_t telemetry_period = 1;
+/// \private Time since the last record in ms.
+static uint16_t telemetry_elapsed = 0;
+/// \private Function to send the records.
+static frame_write_function telemetry_write = NULL;
+/// \private Function called before the signals are sampled.
+static telemetry_callback telemetry_sample_callback = NULL;
+/// \private Sequence number of the next record.
+static uint16_t telemetry_sequence = 0;
+/// \private Number of dropped records.
+static volatile uint16_t telemetry_dropped = 0;
+
+/// \private Queue of the sampled records.
+static telemetry_record telemetry_queue[TELEMETRY_QUEUE_SIZE];
+/// \private Index of the oldest record, only changed by #telemetry_poll.
+static volatile uint8_t telemetry_head = 0;
+/// \private Index of the next free record, only changed by #telemetry_tick.
+static volatile uint8_t telemetry_tail = 0;
+
+int telemetry_add(const volatile void * address, const uint8_t size)
+{
+	if (telemetry_running || telemetry_count >= TELEMETRY_MAX_SIGNALS || size == 0
+		|| telemetry_length + size > TELEMETRY_MAX_RECORD)
+		return 0;
+	telemetry_address[telemetry_count] = (const volatile uint8_t *)address;
+	telemetry_size[telemetry_count] = size;
+	telemetry_count++;
+	telemetry_length += size;
+	return 1;
+}
+
+void telemetry_clear(void)
+{
+	telemetry_stop();
+	telemetry_count = 0;
+	telemetry_length = 0;
+}
+
+int telemetry_start(const uint16_t period_ms, const frame_write_function write, const telemetry_callback callback)
+{
+	if (telemetry_count == 0 || period_ms == 0)
+		return 0;
+	telemetry_stop();
+	telemetry_period = period_ms;
+	telemetry_elapsed = 0;
+	telemetry_write = write;
+	telemetry_sample_callback = callback;
+	telemetry_sequence = 0;
+	telemetry_dropped = 0;
+	telemetry_head = telemetry_tail = 0;
+	telemetry_running = 1;
+	return 1;
+}
+
+void telemetry_stop(void)
+{
+	telemetry_running = 0;
+}
+
+void telemetry_tick(void)
+{
+	telemetry_record * record;
+	const volatile uint8_t * source;
+	uint8_t next, i, j, k = 0;
+	if (!telemetry_running || ++telemetry_elapsed < telemetry_period)
+		return;
+	telemetry_elapsed = 0;
+	if (telemetry_sample_callback != NULL)
+		telemetry_sample_callback();
+	next = (telemetry_tail + 1) & TELEMETRY_QUEUE_MASK;
+	// The sequence number is used anyway, so the receiver sees the gap
+	if (next == telemetry_head)
+	{
+		telemetry_sequence++;
+		telemetry_dropped++;
+		return;
+	}
+	record = &telemetry_queue[telemetry_tail];
+	record->sequence = telemetry_sequence++;
+	for (i = 0; i < telemetry_count; i++)
+	{
+		source = telemetry_address[i];
+		for (j = 0; j < telemetry_size[i]; j++)
+			record->data[k++] = source[j];
+	}
+	telemetry_tail = next;
+}
+
+uint8_t telemetry_poll(void)
+{
+	uint8_t payload[FRAME_MAX_PAYLOAD];
+	uint8_t encoded[FRAME_MAX_ENCODED];
+	uint8_t length, sent = 0;
+	telemetry_record * record;
+	while (telemetry_running && telemetry_head != telemetry_tail)
+	{
+		record = &telemetry_queue[telemetry_head];
+		payload[0] = record->sequence & 0xFF;
+		payload[1] = record->sequence >> 8;
+		memcpy(&payload[2], record->data, telemetry_length);
+		// Release the record before it is sent, sending may take a while
+		telemetry_head = (telemetry_head + 1) & TELEMETRY_QUEUE_MASK;
+		length = frame_encode(0, FRAME_COMMAND_TELEMETRY | FRAME_REPLY, payload, telemetry_length + 2, encoded);
+		if (telemetry_write != NULL)
+			telemetry_write(encoded, length);
+		sent++;
+	}
+	return sent;
+}
+
+uint16_t telemetry_get_dropped(void)
+{
+	uint16_t dropped;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		dropped = telemetry_dropped;
+	}
+	return dropped;
+}
@@ -0,0 +1,117 @@
+/*! \file telemetry.h
+    \brief Binary telemetry stream of the robot state over the serial connection.
+	\author Team Kick-Ass
+	\copyright GNU Public License V3
+	\date 2012
+
+	\file telemetry.h
+	\details This file implements a telemetry stream which samples a configurable set of signals at a fixed rate and
+	sends them as binary records instead of formatted text. The signals are variables of the application registered
+	with #telemetry_add. A record consists of a 16 bit sequence number followed by the raw bytes of all signals in the
+	order of registration, so its layout is fixed and known to the receiver. It is sent as a frame of the protocol of
+	frame.h with the command #FRAME_COMMAND_TELEMETRY, thus it is protected by a CRC and the stream can share the
+	connection with requests and replies. A receiver detects lost records by gaps in the sequence numbers. The host
+	tool tools/telemetry_decode.c turns the stream into CSV.
+
+	Sampling and sending are separated: #telemetry_tick is called by a 1 kHz timer interrupt of the application and
+	copies the signals into a queue of #TELEMETRY_QUEUE_SIZE records every period. #telemetry_poll is called from the
+	main loop and sends the queued records. If the main loop does not keep up, records are dropped but their sequence
+	numbers are used nevertheless.
+
+	The signals are copied byte by byte in the timer interrupt. Variables changed by other interrupts are consistent,
+	but variables of more than one byte changed by the main program have to be updated in an atomic block.
+
+	\par Example:
+\code
+static volatile uint32_t elapsed_time;
+static volatile uint16_t distance;
+
+void timer_tick(void)
+{
+	elapsed_time++;
+	telemetry_tick();
+}
+
+telemetry_add(&elapsed_time, sizeof(elapsed_time));
+telemetry_add(&distance, sizeof(distance));
+// Stream 20 records per second
+telemetry_start(50, &serial_write, NULL);
+while (1)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		distance = sensor_read(1, SENSOR_DISTANCE);
+	}
+	telemetry_poll();
+}
+\endcode
+	The stream is decoded on the PC with:
+\code
+telemetry_decode -d /dev/ttyUSB0 -l time:u32,distance:u16
+\endcode
+ */
+#ifndef _TELEMETRY_HEADER
+#define _TELEMETRY_HEADER
+
+#include <stdint.h>
+#include "frame.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Maximum number of signals, see #telemetry_add.
+#define TELEMETRY_MAX_SIGNALS	16
+/// Maximum number of bytes of all signals of a record.
+#define TELEMETRY_MAX_RECORD	(FRAME_MAX_PAYLOAD - 2)
+/// Number of records which can wait to be sent. Must be a power of two.
+#define TELEMETRY_QUEUE_SIZE	4
+
+/// Callback function definition, see #telemetry_start.
+typedef void (*telemetry_callback)(void);
+
+/** Function to add a signal to the records.
+	The signals can only be added while the stream is stopped.
+	\param[in]	address		Address of the variable.
+	\param[in]	size		Size of the variable in bytes.
+	\returns 1 in case of success, 0 if the stream is running, #TELEMETRY_MAX_SIGNALS signals have been added already
+	or the record would be longer than #TELEMETRY_MAX_RECORD bytes.
+ */
+int telemetry_add(const volatile void * address, const uint8_t size);
+
+/// Function to remove all signals, the stream is stopped.
+void telemetry_clear(void);
+
+/** Function to start the stream.
+	The sequence numbers start at 0. A running stream is restarted.
+	\param[in]	period_ms	Time between two records in ms (calls of #telemetry_tick).
+	\param[in]	write		Function to send the records, e.g. _serial_write()_.
+	\param[in]	callback	Function called by #telemetry_tick right before the signals are sampled, e.g. to copy values
+	which are not stored in variables. Assign this parameter to _NULL_ if not needed.
+	\returns 1 in case of success, 0 if no signal has been added or the period is 0.
+ */
+int telemetry_start(const uint16_t period_ms, const frame_write_function write, const telemetry_callback callback);
+
+/// Function to stop the stream, queued records are discarded.
+void telemetry_stop(void);
+
+/** Function to sample the signals, to be called by a 1 kHz timer interrupt.
+	Every period the signals are copied into a new record.
+ */
+void telemetry_tick(void);
+
+/** Function to send the sampled records, to be called from the main loop.
+	\returns The number of records sent.
+ */
+uint8_t telemetry_poll(void);
+
+/** Function to get the number of records which have been dropped since the queue was full.
+	\returns The number of dropped records since #telemetry_start.
+ */
+uint16_t telemetry_get_dropped(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,168 @@
+/*! \file dxl_packet_bench.c
+    \brief Benchmark of building instruction packets on a Linux host.
+	\author Team Kick-Ass
+	\copyright GNU Public License V3
+	\date 2012
+
+	\file dxl_packet_bench.c
+	\details This program compares the two ways of building a goal position sync write for 6 and 18 motors: the
+	per-byte methods (_dxl_set_txpacket_parameter()_ and _dxl_tx_packet()_, which sums up the packet for the checksum)
+	and the packet builder (_dxl_packet_begin()_, _dxl_packet_put()_ and _dxl_packet_tx()_). The bus driver is linked
+	against the hardware abstraction layer below, which completes every transmission at once, so only the work of
+	the driver is measured. The time stamp counter of the CPU (x86 only) is read before and after 200000 packets and
+	the average cycles per packet are printed.
+
+	The cycles are those of the host CPU, not of the ATmega2561. They show the ratio of the two methods, not their
+	duration on the robot.
+
+	Build and run, e.g.:
+\code
+gcc -std=gnu99 -Os -I include -I src src/dynamixel.c tools/dxl_packet_bench.c -o dxl_packet_bench
+./dxl_packet_bench
+\endcode
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+#include <x86intrin.h>
+#include "dynamixel.h"
+#include "dxl_hal.h"
+
+/// Number of packets per measurement.
+#define BENCH_PACKETS		200000
+/// Maximum number of motors of a packet.
+#define BENCH_MAX_MOTORS	18
+
+/// Transmit complete callback of the driver.
+static dxl_hal_callback bench_tx_callback = NULL;
+/// Last byte sent, keeps the compiler from dropping the packet.
+volatile unsigned char bench_sink;
+
+int dxl_hal_open(int devIndex, float baudrate)
+{
+	(void)devIndex;
+	(void)baudrate;
+	return 1;
+}
+
+void dxl_hal_close(void)
+{
+}
+
+void dxl_hal_clear(void)
+{
+}
+
+int dxl_hal_tx(const unsigned char *pPacket, int numPacket)
+{
+	// The transmission is complete at once, a broadcast expects no status packet
+	bench_sink = pPacket[numPacket - 1];
+	if (bench_tx_callback != NULL)
+		bench_tx_callback();
+	return numPacket;
+}
+
+int dxl_hal_rx(unsigned char *pPacket, int numPacket)
+{
+	(void)pPacket;
+	(void)numPacket;
+	return 0;
+}
+
+void dxl_hal_set_tx_callback(const dxl_hal_callback callback)
+{
+	bench_tx_callback = callback;
+}
+
+void dxl_hal_set_rx_callback(const dxl_hal_callback callback)
+{
+	(void)callback;
+}
+
+void dxl_hal_set_timeout(uint16_t time_us, const dxl_hal_callback callback)
+{
+	(void)time_us;
+	(void)callback;
+}
+
+void dxl_hal_cancel_timeout(void)
+{
+}
+
+void dxl_hal_poll(void)
+{
+}
+
+uint32_t dxl_hal_get_time(void)
+{
+	return 0;
+}
+
+/// Function to send a goal position sync write with the per-byte methods.
+static void bench_per_byte(const int size, const uint8_t * id, const uint16_t * position)
+{
+	int i;
+	dxl_set_txpacket_id(BROADCAST_ID);
+	dxl_set_txpacket_instruction(INST_SYNC_WRITE);
+	dxl_set_txpacket_parameter(0, 30);
+	dxl_set_txpacket_parameter(1, 2);
+	for (i = 0; i < size; i++)
+	{
+		dxl_set_txpacket_parameter(2 + 3 * i, id[i]);
+		dxl_set_txpacket_parameter(2 + 3 * i + 1, dxl_get_lowbyte(position[i]));
+		dxl_set_txpacket_parameter(2 + 3 * i + 2, dxl_get_highbyte(position[i]));
+	}
+	dxl_set_txpacket_length(3 * size + 4);
+	dxl_txrx_packet();
+}
+
+/// Function to send a goal position sync write with the packet builder.
+static void bench_builder(const int size, const uint8_t * id, const uint16_t * position)
+{
+	int i;
+	dxl_packet packet;
+	dxl_packet_begin(&packet, BROADCAST_ID, INST_SYNC_WRITE);
+	dxl_packet_put(&packet, 30);
+	dxl_packet_put(&packet, 2);
+	for (i = 0; i < size; i++)
+	{
+		dxl_packet_put(&packet, id[i]);
+		dxl_packet_put_word(&packet, position[i]);
+	}
+	dxl_packet_txrx(&packet);
+}
+
+int main(void)
+{
+	const int sizes[] = {6, BENCH_MAX_MOTORS};
+	uint8_t id[BENCH_MAX_MOTORS];
+	uint16_t position[BENCH_MAX_MOTORS];
+	uint64_t start, per_byte, builder;
+	int i, n;
+
+	for (i = 0; i < BENCH_MAX_MOTORS; i++)
+	{
+		id[i] = i + 1;
+		position[i] = 100 + i * 37;
+	}
+	dxl_initialize(0, 1);
+
+	for (i = 0; i < (int)(sizeof(sizes) / sizeof(sizes[0])); i++)
+	{
+		start = __rdtsc();
+		for (n = 0; n < BENCH_PACKETS; n++)
+			bench_per_byte(sizes[i], id, position);
+		per_byte = (__rdtsc() - start) / BENCH_PACKETS;
+		start = __rdtsc();
+		for (n = 0; n < BENCH_PACKETS; n++)
+			bench_builder(sizes[i], id, position);
+		builder = (__rdtsc() - start) / BENCH_PACKETS;
+		printf("%2d motors: per-byte %4lu cycles, builder %4lu cycles\n", sizes[i], (unsigned long)per_byte, (unsigned long)builder);
+	}
+	if (dxl_get_result() != COMM_RXSUCCESS)
+	{
+		printf("Packets failed with result %d\n", dxl_get_result());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,170 @@
+/*! \file frame_client.c
+    \brief Linux client of the binary framed command protocol (declaration part, see frame_client.h for an interface description).
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "frame_client.h"
+
+/// \private Function to convert a baudrate to its termios constant, returns 0 if it is not supported.
+static speed_t frame_client_speed(const long baudrate)
+{
+	switch (baudrate)
+	{
+		case 9600:		return B9600;
+		case 19200:		return B19200;
+		case 38400:		return B38400;
+		case 57600:		return B57600;
+		case 115200:	return B115200;
+		case 230400:	return B230400;
+		default:		return 0;
+	}
+}
+
+/// \private Function to get a monotonic time in ms.
+static long frame_client_now(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+int frame_client_open(frame_client * client, const char * path, const long baudrate)
+{
+	struct termios settings;
+	speed_t speed = frame_client_speed(baudrate);
+	memset(client, 0, sizeof(*client));
+	client->timeout_ms = FRAME_CLIENT_TIMEOUT_MS;
+	frame_decoder_init(&client->decoder);
+	client->fd = open(path, O_RDWR | O_NOCTTY);
+	if (client->fd < 0 || speed == 0)
+		goto error;
+	if (tcgetattr(client->fd, &settings) != 0)
+		goto error;
+	cfmakeraw(&settings);
+	settings.c_cflag |= CLOCAL | CREAD;
+	settings.c_cflag &= ~(CSTOPB | PARENB);
+	cfsetispeed(&settings, speed);
+	cfsetospeed(&settings, speed);
+	if (tcsetattr(client->fd, TCSANOW, &settings) != 0)
+		goto error;
+	tcflush(client->fd, TCIOFLUSH);
+	return 0;
+error:
+	if (client->fd >= 0)
+		close(client->fd);
+	client->fd = -1;
+	return FRAME_CLIENT_ERROR_IO;
+}
+
+void frame_client_close(frame_client * client)
+{
+	if (client->fd >= 0)
+		close(client->fd);
+	client->fd = -1;
+}
+
+int frame_client_request(frame_client * client, const uint8_t command, const uint8_t * payload, const uint8_t length, uint8_t * reply)
+{
+	uint8_t encoded[FRAME_MAX_ENCODED];
+	uint8_t received[64];
+	int size, sent = 0, count, i;
+	long deadline;
+	struct pollfd event;
+	size = frame_encode(++client->request_id, command, payload, length, encoded);
+	if (size == 0)
+		return FRAME_CLIENT_ERROR_LENGTH;
+	while (sent < size)
+	{
+		count = write(client->fd, &encoded[sent], size - sent);
+		if (count < 0 && errno != EINTR)
+			return FRAME_CLIENT_ERROR_IO;
+		if (count > 0)
+			sent += count;
+	}
+	client->stats.requests++;
+	client->stats.tx_bytes += size;
+	// Wait for the reply with the same request id
+	deadline = frame_client_now() + client->timeout_ms;
+	event.fd = client->fd;
+	event.events = POLLIN;
+	while (frame_client_now() < deadline)
+	{
+		if (poll(&event, 1, (int)(deadline - frame_client_now())) <= 0)
+			continue;
+		count = read(client->fd, received, sizeof(received));
+		if (count < 0 && errno != EINTR && errno != EAGAIN)
+			return FRAME_CLIENT_ERROR_IO;
+		for (i = 0; i < count; i++)
+		{
+			size = frame_decoder_put(&client->decoder, received[i]);
+			if (size == 0 || client->decoder.data[0] != client->request_id
+				|| client->decoder.data[1] != (command | FRAME_REPLY))
+				continue;
+			client->stats.replies++;
+			client->stats.rx_bytes += count;
+			memcpy(reply, &client->decoder.data[2], size - 2);
+			return size - 2;
+		}
+		if (count > 0)
+			client->stats.rx_bytes += count;
+	}
+	client->stats.timeouts++;
+	return FRAME_CLIENT_ERROR_TIMEOUT;
+}
+
+int frame_client_ping(frame_client * client, const uint8_t length)
+{
+	uint8_t payload[FRAME_MAX_PAYLOAD], reply[FRAME_MAX_PAYLOAD];
+	int size;
+	uint8_t i;
+	for (i = 0; i < length && i < sizeof(payload); i++)
+		payload[i] = i;
+	size = frame_client_request(client, FRAME_COMMAND_PING, payload, length, reply);
+	if (size < 0)
+		return size;
+	if (size < 1 || (reply[0] == FRAME_STATUS_OK && (size != length + 1 || memcmp(&reply[1], payload, length) != 0)))
+		return FRAME_CLIENT_ERROR_LENGTH;
+	return reply[0];
+}
+
+int frame_client_get(frame_client * client, const uint8_t count, const uint8_t * id, int16_t * value)
+{
+	uint8_t reply[FRAME_MAX_PAYLOAD];
+	int size, i;
+	if (count == 0 || count > FRAME_MAX_GET)
+		return FRAME_CLIENT_ERROR_LENGTH;
+	size = frame_client_request(client, FRAME_COMMAND_GET, id, count, reply);
+	if (size < 0)
+		return size;
+	if (size < 2 || reply[1] > count || size != 2 + 2 * reply[1])
+		return FRAME_CLIENT_ERROR_LENGTH;
+	for (i = 0; i < reply[1]; i++)
+		value[i] = (int16_t)(reply[2 + 2 * i] | (reply[3 + 2 * i] << 8));
+	return reply[0];
+}
+
+int frame_client_set(frame_client * client, const uint8_t count, const uint8_t * id, const int16_t * value)
+{
+	uint8_t payload[FRAME_MAX_PAYLOAD], reply[FRAME_MAX_PAYLOAD];
+	int size, i;
+	if (count == 0 || count > FRAME_MAX_SET)
+		return FRAME_CLIENT_ERROR_LENGTH;
+	for (i = 0; i < count; i++)
+	{
+		payload[3 * i] = id[i];
+		payload[3 * i + 1] = (uint16_t)value[i] & 0xFF;
+		payload[3 * i + 2] = (uint16_t)value[i] >> 8;
+	}
+	size = frame_client_request(client, FRAME_COMMAND_SET, payload, 3 * count, reply);
+	if (size < 0)
+		return size;
+	if (size != 2)
+		return FRAME_CLIENT_ERROR_LENGTH;
+	return reply[0];
+}
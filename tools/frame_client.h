@@ -0,0 +1,132 @@
+/*! \file frame_client.h
+    \brief Linux client of the binary framed command protocol.
+	\author Team Kick-Ass
+	\copyright GNU Public License V3
+	\date 2012
+
+	\file frame_client.h
+	\details This file implements the PC side of the protocol described in frame.h. The client talks to a robot over a
+	serial device (the ZigBee dongle or a cable), or to a simulated device over a pseudo terminal (see
+	frame_loadtest.c). Each request gets a new request id, replies to an older request which arrive after its timeout
+	are discarded.
+
+	The client is built together with the encoding functions of the firmware, e.g.:
+\code
+gcc -I src src/frame.c tools/frame_client.c my_program.c
+\endcode
+
+	\par Example:
+\code
+frame_client client;
+const uint8_t ids[3] = {20, 21, 22};
+int16_t values[3];
+if (frame_client_open(&client, "/dev/ttyUSB0", 57600) == 0)
+{
+	if (frame_client_get(&client, 3, ids, values) == FRAME_STATUS_OK)
+		printf("Sensors: %d %d %d\n", values[0], values[1], values[2]);
+	frame_client_close(&client);
+}
+\endcode
+ */
+#ifndef _FRAME_CLIENT_HEADER
+#define _FRAME_CLIENT_HEADER
+
+#include <stdint.h>
+#include "frame.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Default time in ms to wait for a reply.
+#define FRAME_CLIENT_TIMEOUT_MS		200
+
+/// Error: no valid reply has been received in time.
+#define FRAME_CLIENT_ERROR_TIMEOUT	-1
+/// Error: the serial device could not be read or written.
+#define FRAME_CLIENT_ERROR_IO		-2
+/// Error: the request or the reply has an invalid length.
+#define FRAME_CLIENT_ERROR_LENGTH	-3
+
+/// Statistics of a client.
+typedef struct {
+	/// Number of requests sent.
+	uint32_t requests;
+	/// Number of replies received.
+	uint32_t replies;
+	/// Number of requests without reply in time.
+	uint32_t timeouts;
+	/// Number of bytes sent.
+	uint32_t tx_bytes;
+	/// Number of bytes received.
+	uint32_t rx_bytes;
+} frame_client_stats;
+
+/// Connection of a client.
+typedef struct {
+	/// File descriptor of the serial device.
+	int fd;
+	/// Request id of the last request.
+	uint8_t request_id;
+	/// Time in ms to wait for a reply.
+	int timeout_ms;
+	/// Receiver of the replies, counts the invalid frames.
+	frame_decoder decoder;
+	/// Statistics.
+	frame_client_stats stats;
+} frame_client;
+
+/** Function to open a connection.
+	The device is set to raw mode with 8 data bits, no parity and one stop bit.
+	\param[out]	client		The connection.
+	\param[in]	path		Path of the serial device or pseudo terminal.
+	\param[in]	baudrate	Baudrate, e.g. 57600.
+	\returns 0 in case of success, #FRAME_CLIENT_ERROR_IO otherwise.
+ */
+int frame_client_open(frame_client * client, const char * path, const long baudrate);
+
+/** Function to close a connection.
+	\param[in,out]	client		The connection.
+ */
+void frame_client_close(frame_client * client);
+
+/** Function to send a request and wait for its reply.
+	\param[in,out]	client		The connection.
+	\param[in]		command		Command of the request, one of FRAME_COMMAND_*.
+	\param[in]		payload		Payload of the request.
+	\param[in]		length		Number of payload bytes.
+	\param[out]		reply		Buffer of #FRAME_MAX_PAYLOAD bytes for the reply payload.
+	\returns The length of the reply payload or a negative FRAME_CLIENT_ERROR_* value.
+ */
+int frame_client_request(frame_client * client, const uint8_t command, const uint8_t * payload, const uint8_t length, uint8_t * reply);
+
+/** Function to test the connection.
+	\param[in,out]	client		The connection.
+	\param[in]		length		Number of bytes sent forth and back in the range [0:#FRAME_MAX_PAYLOAD - 1].
+	\returns The status of the device (FRAME_STATUS_*) or a negative FRAME_CLIENT_ERROR_* value.
+ */
+int frame_client_ping(frame_client * client, const uint8_t length);
+
+/** Function to read several values with one request.
+	\param[in,out]	client		The connection.
+	\param[in]		count		Number of values in the range [1:#FRAME_MAX_GET].
+	\param[in]		id			Ids of the values.
+	\param[out]		value		The values. In case of an error only those before the failing one are valid.
+	\returns The status of the device (FRAME_STATUS_*) or a negative FRAME_CLIENT_ERROR_* value.
+ */
+int frame_client_get(frame_client * client, const uint8_t count, const uint8_t * id, int16_t * value);
+
+/** Function to write several values with one request.
+	\param[in,out]	client		The connection.
+	\param[in]		count		Number of values in the range [1:#FRAME_MAX_SET].
+	\param[in]		id			Ids of the values.
+	\param[in]		value		The values. In case of an error only those before the failing one have been written.
+	\returns The status of the device (FRAME_STATUS_*) or a negative FRAME_CLIENT_ERROR_* value.
+ */
+int frame_client_set(frame_client * client, const uint8_t count, const uint8_t * id, const int16_t * value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,252 @@
+/*! \file frame_loadtest.c
+    \brief Load test of the binary framed command protocol over a pseudo terminal.
+	\author Team Kick-Ass
+	\copyright GNU Public License V3
+	\date 2012
+
+	\file frame_loadtest.c
+	\details This program tests the protocol of frame.h without a robot. A child process runs the device side of the
+	firmware (_frame_poll()_ with a table of #LOADTEST_VALUES values) on the master side of a pseudo terminal, the
+	client (frame_client.h) talks to it over the slave side like to a serial device. The device delays its replies by
+	the transmission time of the bytes at the given baudrate and corrupts received bytes at the given rate, so the
+	round trips and the recovery from transmission errors are close to those of the real link.
+
+	Values with an id below #LOADTEST_WRITABLE can be written, the others are read-only, ids from #LOADTEST_VALUES on are
+	unknown. The test sends pings, batched writes and batched reads of 1 to #FRAME_MAX_GET values, checks the read
+	values and prints the round trip times and the bytes per request.
+
+	Build and run, e.g.:
+\code
+gcc -I src -I tools src/frame.c tools/frame_client.c tools/frame_loadtest.c -o frame_loadtest
+./frame_loadtest -n 1000 -b 57600 -e 1
+\endcode
+ */
+
+#define _XOPEN_SOURCE 600
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include "frame.h"
+#include "frame_client.h"
+
+/// Number of values of the simulated device.
+#define LOADTEST_VALUES			64
+/// Number of values of the simulated device which can be written.
+#define LOADTEST_WRITABLE		32
+
+/// Master side of the pseudo terminal, used by the device.
+static int loadtest_fd = -1;
+/// Simulated baudrate, 0 to send without delay.
+static long loadtest_baudrate = 0;
+/// Rate of corrupted bytes in 1/1000.
+static int loadtest_error_rate = 0;
+/// Values of the simulated device.
+static int16_t loadtest_values[LOADTEST_VALUES];
+
+/// Function to wait for the transmission time of _count_ bytes (10 bits each).
+static void loadtest_delay(const int count)
+{
+	if (loadtest_baudrate > 0 && count > 0)
+		usleep((useconds_t)(count * 10000000ll / loadtest_baudrate));
+}
+
+/// Read function of the device, corrupts bytes at the error rate.
+static unsigned char loadtest_read(unsigned char * data, int length)
+{
+	int count = read(loadtest_fd, data, length), i;
+	if (count <= 0)
+		return 0;
+	for (i = 0; i < count; i++)
+		if (loadtest_error_rate > 0 && rand() % 1000 < loadtest_error_rate)
+			data[i] ^= 1 << (rand() % 8);
+	loadtest_delay(count);
+	return (unsigned char)count;
+}
+
+/// Write function of the device.
+static int loadtest_write(const unsigned char * data, int length)
+{
+	loadtest_delay(length);
+	return write(loadtest_fd, data, length);
+}
+
+/// Read handler of the device.
+static uint8_t loadtest_get(const uint8_t id, int16_t * value)
+{
+	if (id >= LOADTEST_VALUES)
+		return FRAME_STATUS_UNKNOWN;
+	*value = loadtest_values[id];
+	return FRAME_STATUS_OK;
+}
+
+/// Write handler of the device.
+static uint8_t loadtest_set(const uint8_t id, const int16_t value)
+{
+	if (id >= LOADTEST_VALUES)
+		return FRAME_STATUS_UNKNOWN;
+	if (id >= LOADTEST_WRITABLE)
+		return FRAME_STATUS_READ_ONLY;
+	loadtest_values[id] = value;
+	return FRAME_STATUS_OK;
+}
+
+/// Main loop of the simulated device.
+static void loadtest_device(void)
+{
+	struct pollfd event = {loadtest_fd, POLLIN, 0};
+	int i;
+	for (i = 0; i < LOADTEST_VALUES; i++)
+		loadtest_values[i] = (int16_t)(i * 1000 - 32000);
+	fcntl(loadtest_fd, F_SETFL, fcntl(loadtest_fd, F_GETFL) | O_NONBLOCK);
+	frame_init(&loadtest_read, &loadtest_write, &loadtest_get, &loadtest_set);
+	while (1)
+	{
+		if (poll(&event, 1, -1) < 0 && errno != EINTR)
+			exit(1);
+		if (event.revents & (POLLHUP | POLLERR))
+			exit(0);
+		frame_poll();
+	}
+}
+
+/// Function to get a monotonic time in us.
+static double loadtest_now(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1e6 + now.tv_nsec / 1e3;
+}
+
+/// Round trip statistics of one kind of request.
+typedef struct {
+	const char * name;
+	long count, failed;
+	double total_us, max_us;
+	uint32_t bytes;
+} loadtest_result;
+
+/// Function to add a round trip to the statistics.
+static void loadtest_account(loadtest_result * result, const double start, const int ok, const frame_client_stats * before, const frame_client_stats * after)
+{
+	double time = loadtest_now() - start;
+	result->count++;
+	if (!ok)
+		result->failed++;
+	result->total_us += time;
+	if (time > result->max_us)
+		result->max_us = time;
+	result->bytes += (after->tx_bytes - before->tx_bytes) + (after->rx_bytes - before->rx_bytes);
+}
+
+int main(int argc, char * argv[])
+{
+	long requests = 1000, n;
+	int option, i, status;
+	frame_client client;
+	frame_client_stats before;
+	loadtest_result results[5] = {{.name = "ping 16 bytes"}, {.name = "get 1 value"}, {.name = "get 8 values"},
+		{.name = "get 31 values"}, {.name = "set+get 8 values"}};
+	uint8_t id[FRAME_MAX_GET];
+	int16_t value[FRAME_MAX_GET], written[FRAME_MAX_SET];
+	pid_t device;
+	double start;
+
+	while ((option = getopt(argc, argv, "n:b:e:")) != -1)
+	{
+		switch (option)
+		{
+			case 'n': requests = atol(optarg); break;
+			case 'b': loadtest_baudrate = atol(optarg); break;
+			case 'e': loadtest_error_rate = atoi(optarg); break;
+			default:
+				fprintf(stderr, "Usage: %s [-n requests] [-b baudrate] [-e corrupted bytes per 1000]\n", argv[0]);
+				return 1;
+		}
+	}
+
+	// Device on the master side, client on the slave side of a pseudo terminal
+	loadtest_fd = posix_openpt(O_RDWR | O_NOCTTY);
+	if (loadtest_fd < 0 || grantpt(loadtest_fd) != 0 || unlockpt(loadtest_fd) != 0)
+	{
+		perror("posix_openpt");
+		return 1;
+	}
+	if (frame_client_open(&client, ptsname(loadtest_fd), 57600) != 0)
+	{
+		perror("frame_client_open");
+		return 1;
+	}
+	device = fork();
+	if (device == 0)
+	{
+		frame_client_close(&client);
+		loadtest_device();
+	}
+	close(loadtest_fd);
+
+	srand(1);
+	for (n = 0; n < requests; n++)
+	{
+		// Ping
+		before = client.stats;
+		start = loadtest_now();
+		status = frame_client_ping(&client, 16);
+		loadtest_account(&results[0], start, status == FRAME_STATUS_OK, &before, &client.stats);
+		// Batched reads of all, some and one value
+		for (i = 0; i < FRAME_MAX_GET; i++)
+			id[i] = (uint8_t)((n + i) % LOADTEST_VALUES);
+		before = client.stats;
+		start = loadtest_now();
+		status = frame_client_get(&client, 1, id, value);
+		loadtest_account(&results[1], start, status == FRAME_STATUS_OK, &before, &client.stats);
+		before = client.stats;
+		start = loadtest_now();
+		status = frame_client_get(&client, 8, id, value);
+		loadtest_account(&results[2], start, status == FRAME_STATUS_OK, &before, &client.stats);
+		before = client.stats;
+		start = loadtest_now();
+		status = frame_client_get(&client, FRAME_MAX_GET, id, value);
+		loadtest_account(&results[3], start, status == FRAME_STATUS_OK, &before, &client.stats);
+		// Batched write of writable values, checked by reading them back
+		for (i = 0; i < 8; i++)
+		{
+			id[i] = (uint8_t)((n + i) % LOADTEST_WRITABLE);
+			written[i] = (int16_t)(rand() - RAND_MAX / 2);
+		}
+		before = client.stats;
+		start = loadtest_now();
+		status = frame_client_set(&client, 8, id, written);
+		if (status == FRAME_STATUS_OK)
+			status = frame_client_get(&client, 8, id, value);
+		if (status == FRAME_STATUS_OK && memcmp(value, written, 8 * sizeof(int16_t)) != 0)
+			status = FRAME_STATUS_RANGE;
+		loadtest_account(&results[4], start, status == FRAME_STATUS_OK, &before, &client.stats);
+	}
+	// Error replies
+	id[0] = LOADTEST_WRITABLE;
+	written[0] = 1;
+	status = frame_client_set(&client, 1, id, written);
+	printf("Write of read-only value: status %d (expected %d)\n", status, FRAME_STATUS_READ_ONLY);
+	id[0] = LOADTEST_VALUES;
+	status = frame_client_get(&client, 1, id, value);
+	printf("Read of unknown value: status %d (expected %d)\n", status, FRAME_STATUS_UNKNOWN);
+
+	printf("%-18s %8s %8s %12s %12s %10s\n", "Request", "Count", "Failed", "Mean [us]", "Max [us]", "Bytes");
+	for (i = 0; i < 5; i++)
+		printf("%-18s %8ld %8ld %12.0f %12.0f %10.1f\n", results[i].name, results[i].count, results[i].failed,
+			results[i].total_us / results[i].count, results[i].max_us, (double)results[i].bytes / results[i].count);
+	printf("Requests %u, replies %u, timeouts %u, invalid frames %u\n", client.stats.requests, client.stats.replies,
+		client.stats.timeouts, client.decoder.errors);
+
+	frame_client_close(&client);
+	kill(device, SIGTERM);
+	waitpid(device, NULL, 0);
+	return 0;
+}
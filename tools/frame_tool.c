@@ -0,0 +1,101 @@
+/*! \file frame_tool.c
+    \brief Command line tool to read and write values of a robot with the binary framed command protocol.
+	\author Team Kick-Ass
+	\copyright GNU Public License V3
+	\date 2012
+
+	\file frame_tool.c
+	\details This program sends one request of the protocol of frame.h and prints the reply. The ids of the values are
+	defined by the application, e.g. CONF_VALUE_* in 2-nonwheeled-rob/main.c.
+
+	Build and use, e.g.:
+\code
+gcc -I src -I tools src/frame.c tools/frame_client.c tools/frame_tool.c -o frame_tool
+./frame_tool -d /dev/ttyUSB0 set 1=0 0=1
+./frame_tool -d /dev/ttyUSB0 get 10 11 12 13 14 15
+./frame_tool -d /dev/ttyUSB0 ping
+\endcode
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "frame.h"
+#include "frame_client.h"
+
+/// Names of the FRAME_STATUS_* values.
+static const char * const tool_status_names[] = {"ok", "unknown value", "read-only value", "value out of range",
+	"invalid length", "unknown command"};
+
+/// Function to print the result of a request, returns the exit code.
+static int tool_report(const int status)
+{
+	if (status == FRAME_CLIENT_ERROR_TIMEOUT)
+		fprintf(stderr, "No reply.\n");
+	else if (status < 0)
+		fprintf(stderr, "Communication error %d.\n", status);
+	else if (status != FRAME_STATUS_OK)
+		fprintf(stderr, "Device error: %s.\n", status < 6 ? tool_status_names[status] : "?");
+	return status == FRAME_STATUS_OK ? 0 : 1;
+}
+
+int main(int argc, char * argv[])
+{
+	const char * device = "/dev/ttyUSB0";
+	long baudrate = 57600;
+	int option, count, i, status;
+	uint8_t id[FRAME_MAX_GET];
+	int16_t value[FRAME_MAX_GET];
+	char * separator;
+	frame_client client;
+
+	while ((option = getopt(argc, argv, "d:b:")) != -1)
+	{
+		switch (option)
+		{
+			case 'd': device = optarg; break;
+			case 'b': baudrate = atol(optarg); break;
+			default: goto usage;
+		}
+	}
+	if (optind >= argc)
+		goto usage;
+	if (frame_client_open(&client, device, baudrate) != 0)
+	{
+		perror(device);
+		return 1;
+	}
+
+	count = argc - optind - 1;
+	if (strcmp(argv[optind], "ping") == 0)
+		status = frame_client_ping(&client, 16);
+	else if (strcmp(argv[optind], "get") == 0 && count > 0 && count <= FRAME_MAX_GET)
+	{
+		for (i = 0; i < count; i++)
+			id[i] = (uint8_t)atoi(argv[optind + 1 + i]);
+		status = frame_client_get(&client, count, id, value);
+		for (i = 0; status == FRAME_STATUS_OK && i < count; i++)
+			printf("%u=%d\n", id[i], value[i]);
+	}
+	else if (strcmp(argv[optind], "set") == 0 && count > 0 && count <= FRAME_MAX_SET)
+	{
+		for (i = 0; i < count; i++)
+		{
+			separator = strchr(argv[optind + 1 + i], '=');
+			if (separator == NULL)
+				goto usage;
+			id[i] = (uint8_t)atoi(argv[optind + 1 + i]);
+			value[i] = (int16_t)atoi(separator + 1);
+		}
+		status = frame_client_set(&client, count, id, value);
+	}
+	else
+		goto usage;
+	frame_client_close(&client);
+	return tool_report(status);
+
+usage:
+	fprintf(stderr, "Usage: %s [-d device] [-b baudrate] ping | get ID... | set ID=VALUE...\n", argv[0]);
+	return 1;
+}
@@ -0,0 +1,10 @@
+/*! \file tools/host/avr/interrupt.h
+    \brief Host replacement of the AVR interrupt functions for motor_hosttest.c, there are no interrupts.
+ */
+#ifndef _HOST_AVR_INTERRUPT_HEADER
+#define _HOST_AVR_INTERRUPT_HEADER
+
+#define sei()
+#define cli()
+
+#endif
@@ -0,0 +1,9 @@
+/*! \file tools/host/avr/io.h
+    \brief Host replacement of the AVR register definitions for motor_hosttest.c, the motor layer uses none of them.
+ */
+#ifndef _HOST_AVR_IO_HEADER
+#define _HOST_AVR_IO_HEADER
+
+#include <stdint.h>
+
+#endif
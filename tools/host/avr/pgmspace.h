@@ -0,0 +1,18 @@
+/*! \file tools/host/avr/pgmspace.h
+    \brief Host replacement of the AVR flash access functions for motor_hosttest.c, flash data is ordinary data.
+ */
+#ifndef _HOST_AVR_PGMSPACE_HEADER
+#define _HOST_AVR_PGMSPACE_HEADER
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PSTR(s)				(s)
+#define pgm_read_byte(a)	(*(const uint8_t *)(a))
+#define pgm_read_word(a)	(*(const uint16_t *)(a))
+#define pgm_read_dword(a)	(*(const uint32_t *)(a))
+#define memcpy_P			memcpy
+#define strncpy_P			strncpy
+
+#endif
@@ -0,0 +1,12 @@
+/*! \file tools/host/util/atomic.h
+    \brief Host replacement of the AVR atomic blocks for motor_hosttest.c, the interrupts are called by the test itself.
+ */
+#ifndef _HOST_UTIL_ATOMIC_HEADER
+#define _HOST_UTIL_ATOMIC_HEADER
+
+#define ATOMIC_RESTORESTATE
+#define ATOMIC_FORCEON
+#define ATOMIC_BLOCK(type)		for (int _atomic_once = 1; _atomic_once; _atomic_once = 0)
+#define NONATOMIC_BLOCK(type)	for (int _atomic_once = 1; _atomic_once; _atomic_once = 0)
+
+#endif
@@ -0,0 +1,19 @@
+/*! \file tools/host/util/delay.h
+    \brief Host replacement of the AVR busy waits for motor_hosttest.c, they advance the clock of the virtual bus.
+ */
+#ifndef _HOST_UTIL_DELAY_HEADER
+#define _HOST_UTIL_DELAY_HEADER
+
+#include "dxl_hal_host.h"
+
+static inline void _delay_ms(double ms)
+{
+	dxl_hal_host_advance((uint32_t)(ms * 1000));
+}
+
+static inline void _delay_us(double us)
+{
+	dxl_hal_host_advance((uint32_t)us);
+}
+
+#endif
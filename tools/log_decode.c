@@ -0,0 +1,194 @@
+/*! \file log_decode.c
+    \brief Decoder of the tokenized log messages into text.
+	\author Team Kick-Ass
+	\copyright GNU Public License V3
+	\date 2012
+
+	\file log_decode.c
+	\details This program reads the log messages of a robot (see log.h) from a serial device, a file or the standard
+	input and prints one line per message. The format strings are taken from src/log_messages.h at build time, so the
+	decoder has to be rebuilt whenever messages are added. Messages with an unknown id or a wrong number of arguments
+	are printed with their raw values instead, so nothing is lost with an outdated decoder.
+
+	Frames which are not log messages, e.g. replies and telemetry records, are skipped, text and corrupted frames are
+	counted. A summary is printed to the standard error at the end of the input (or on Ctrl-C).
+
+	Build and use, e.g.:
+\code
+gcc -I src -I tools src/frame.c tools/frame_client.c tools/log_decode.c -o log_decode
+./log_decode -d /dev/ttyUSB0
+./log_decode capture.bin
+\endcode
+ */
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "frame.h"
+#include "frame_client.h"
+
+/// Message of the dictionary.
+typedef struct {
+	/// Name of the message in log_messages.h.
+	const char * name;
+	/// Format string of the message.
+	const char * format;
+} decode_message;
+
+/// Dictionary of the messages, the index is the id.
+static const decode_message decode_messages[] = {
+#define LOG_MESSAGE(name, format)	{#name, format},
+#include "log_messages.h"
+#undef LOG_MESSAGE
+};
+
+/// Number of messages of the dictionary.
+#define DECODE_MESSAGES		(sizeof(decode_messages) / sizeof(decode_messages[0]))
+
+/// Set by Ctrl-C.
+static volatile sig_atomic_t decode_stop = 0;
+
+/// Signal handler of Ctrl-C.
+static void decode_interrupt(int signal)
+{
+	(void)signal;
+	decode_stop = 1;
+}
+
+/// Function to count the arguments of a format string, -1 if it contains an unsupported conversion.
+static int decode_count(const char * format)
+{
+	int count = 0;
+	for (; *format != '\0'; format++)
+	{
+		if (*format != '%')
+			continue;
+		format += strspn(format + 1, "-+ #0123456789.") + 1;
+		if (*format == '%')
+			continue;
+		if (*format == '\0' || strchr("diuxXoc", *format) == NULL)
+			return -1;
+		count++;
+	}
+	return count;
+}
+
+/// Function to print a message with its arguments, which are 16 bit integers in little endian byte order.
+static void decode_print(const char * format, const uint8_t * data)
+{
+	char specifier[16];
+	const char * start;
+	size_t length;
+	int16_t value;
+	for (; *format != '\0'; format++)
+	{
+		if (*format != '%')
+		{
+			putchar(*format);
+			continue;
+		}
+		start = format;
+		format += strspn(format + 1, "-+ #0123456789.") + 1;
+		if (*format == '%')
+		{
+			putchar('%');
+			continue;
+		}
+		length = (size_t)(format - start) + 1;
+		if (length >= sizeof(specifier))
+			length = sizeof(specifier) - 1;
+		memcpy(specifier, start, length);
+		specifier[length] = '\0';
+		value = (int16_t)(data[0] | (data[1] << 8));
+		data += 2;
+		if (*format == 'd' || *format == 'i')
+			printf(specifier, (int)value);
+		else if (*format == 'c')
+			printf(specifier, (int)(uint8_t)value);
+		else
+			printf(specifier, (unsigned int)(uint16_t)value);
+	}
+	putchar('\n');
+}
+
+int main(int argc, char * argv[])
+{
+	const char * device = NULL;
+	long baudrate = 57600;
+	int option, fd = STDIN_FILENO, count, i, j;
+	uint8_t buffer[256], length, id;
+	unsigned long messages = 0, unknown = 0, skipped = 0;
+	frame_decoder decoder;
+	frame_client client;
+
+	while ((option = getopt(argc, argv, "d:b:")) != -1)
+	{
+		switch (option)
+		{
+			case 'd': device = optarg; break;
+			case 'b': baudrate = atol(optarg); break;
+			default: goto usage;
+		}
+	}
+	// The firmware is not allowed to use unsupported conversions
+	for (i = 0; i < (int)DECODE_MESSAGES; i++)
+		if (decode_count(decode_messages[i].format) < 0)
+		{
+			fprintf(stderr, "Unsupported format of %s: \"%s\"\n", decode_messages[i].name, decode_messages[i].format);
+			return 1;
+		}
+	if (device != NULL)
+	{
+		// The client only configures the serial device
+		if (frame_client_open(&client, device, baudrate) != 0)
+		{
+			perror(device);
+			return 1;
+		}
+		fd = client.fd;
+	}
+	else if (optind < argc && freopen(argv[optind], "rb", stdin) == NULL)
+	{
+		perror(argv[optind]);
+		return 1;
+	}
+	signal(SIGINT, &decode_interrupt);
+
+	frame_decoder_init(&decoder);
+	while (!decode_stop && (count = read(fd, buffer, sizeof(buffer))) > 0)
+	{
+		for (i = 0; i < count; i++)
+		{
+			length = frame_decoder_put(&decoder, buffer[i]);
+			if (length == 0)
+				continue;
+			if (decoder.data[1] != (FRAME_COMMAND_LOG | FRAME_REPLY) || length < 3 || (length - 3) % 2 != 0)
+			{
+				skipped++;
+				continue;
+			}
+			messages++;
+			id = decoder.data[2];
+			if (id < DECODE_MESSAGES && decode_count(decode_messages[id].format) * 2 == length - 3)
+			{
+				decode_print(decode_messages[id].format, &decoder.data[3]);
+				continue;
+			}
+			// Outdated dictionary
+			unknown++;
+			printf("<message %u", id);
+			for (j = 3; j < length; j += 2)
+				printf(" %d", (int16_t)(decoder.data[j] | (decoder.data[j + 1] << 8)));
+			printf(">\n");
+		}
+		fflush(stdout);
+	}
+	fprintf(stderr, "Messages %lu, unknown %lu, other frames %lu, invalid frames %u\n", messages, unknown, skipped, decoder.errors);
+	return 0;
+
+usage:
+	fprintf(stderr, "Usage: %s [-d device] [-b baudrate] [file]\n", argv[0]);
+	return 1;
+}
@@ -0,0 +1,251 @@
+/*! \file motor_hosttest.c
+    \brief Test of the motor layer on a Linux host with the virtual motor bus.
+	\author Team Kick-Ass
+	\copyright GNU Public License V3
+	\date 2012
+
+	\file motor_hosttest.c
+	\details This program runs the motor layer (motor.c) with the bus driver (dynamixel.c) on the virtual bus of
+	dxl_hal_host.h. The AVR headers used by the motor layer are replaced by those in tools/host, the 1 kHz timer of the
+	motor layer is called by the test itself, each call advances the virtual clock by 1 ms. The test checks the
+	suppression of redundant writes, the trajectory streamer, the odometry, the load monitor and the error report
+	over the tokenized logging (log.h). It prints one line per check and returns 0 if all checks passed.
+
+	Build and run, e.g.:
+\code
+gcc -std=gnu99 -DF_CPU=16000000 -I tools/host -I include -I src src/dynamixel.c src/dxl_hal_host.c src/motor.c src/log.c src/frame.c tools/motor_hosttest.c -lm -o motor_hosttest
+./motor_hosttest
+\endcode
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "motor.h"
+#include "timer.h"
+#include "dxl_hal.h"
+#include "dxl_hal_host.h"
+#include "frame.h"
+#include "log.h"
+
+/// Timer interrupt of the motor layer.
+static timer_callback hosttest_tick = NULL;
+/// Number of failed checks.
+static int hosttest_failures = 0;
+/// Receiver of the log messages.
+static frame_decoder hosttest_log;
+/// Id of the last log message, -1 if none has been received.
+static int hosttest_log_id = -1;
+/// Arguments of the last log message.
+static int16_t hosttest_log_argument[LOG_MAX_ARGUMENTS];
+/// Events of the last call of the load monitor callback.
+static uint8_t hosttest_load_events = 0;
+
+/// Timer replacement, the motor layer runs its 1 kHz tick on timer 2.
+int timer_set_interrupt(const uint8_t timer, const timer_interrupt_types type, const timer_callback callback)
+{
+	(void)type;
+	if (timer == 2)
+		hosttest_tick = callback;
+	return 0;
+}
+
+/// Timer replacement, the value is not needed.
+int timer_set_value(const uint8_t timer, const timer_value_type type, const uint16_t value)
+{
+	(void)timer;
+	(void)type;
+	(void)value;
+	return 0;
+}
+
+/// Timer replacement, the timer is simulated by #hosttest_run.
+int timer_init(const uint8_t timer, const timer_operation_mode mode, const timer_prescaler prescaler, const uint16_t value)
+{
+	(void)timer;
+	(void)mode;
+	(void)prescaler;
+	(void)value;
+	return 0;
+}
+
+/// Function to run the motor layer for _ms_ ms.
+static void hosttest_run(const int ms)
+{
+	int i;
+	for (i = 0; i < ms; i++)
+	{
+		dxl_hal_host_advance(1000);
+		if (hosttest_tick != NULL)
+			hosttest_tick();
+	}
+}
+
+/// Function to print the result of a check.
+static void hosttest_check(const char * name, const int ok)
+{
+	printf("%-48s %s\n", name, ok ? "ok" : "FAILED");
+	if (!ok)
+		hosttest_failures++;
+}
+
+/// Write function of the logging, decodes the messages.
+static int hosttest_log_write(const unsigned char * data, int length)
+{
+	int i, j;
+	uint8_t size;
+	for (i = 0; i < length; i++)
+	{
+		size = frame_decoder_put(&hosttest_log, data[i]);
+		if (size < 3 || hosttest_log.data[1] != (FRAME_COMMAND_LOG | FRAME_REPLY))
+			continue;
+		hosttest_log_id = hosttest_log.data[2];
+		for (j = 0; j < LOG_MAX_ARGUMENTS && 3 + 2 * j < size; j++)
+			hosttest_log_argument[j] = (int16_t)(hosttest_log.data[3 + 2 * j] | (hosttest_log.data[4 + 2 * j] << 8));
+	}
+	return length;
+}
+
+/// Callback of the load monitor.
+static void hosttest_load(const uint8_t index, const uint8_t events)
+{
+	(void)index;
+	hosttest_load_events |= events;
+}
+
+/// Function to set the present load of a simulated motor, negative values are clockwise.
+static void hosttest_set_load(const uint8_t id, const int load)
+{
+	unsigned char * table = dxl_hal_host_get_table(id);
+	uint16_t value = load < 0 ? (uint16_t)(-load) | 0x0400 : (uint16_t)load;
+	table[PRESENT_LOAD_L] = value & 0xFF;
+	table[PRESENT_LOAD_H] = value >> 8;
+}
+
+/// Test of the suppression of writes of values the motor already has.
+static void hosttest_shadow(void)
+{
+	motor_write_stats before, after;
+	unsigned char * table = dxl_hal_host_get_table(1);
+	uint8_t data[2];
+	motor_get_write_stats(&before);
+	motor_write_byte(1, TORQUE_ENABLE, 1);
+	motor_write_byte(1, TORQUE_ENABLE, 1);
+	motor_get_write_stats(&after);
+	hosttest_check("shadow: repeated write is suppressed", after.sent - before.sent == 1
+		&& after.suppressed - before.suppressed == 1);
+	// The angle limits are not shadowed, so they are always sent
+	before = after;
+	motor_write_word(1, CW_ANGLE_LIMIT_L, 0);
+	motor_write_word(1, CW_ANGLE_LIMIT_L, 0);
+	motor_get_write_stats(&after);
+	hosttest_check("shadow: write outside the shadow is sent", after.sent - before.sent == 2
+		&& after.suppressed == before.suppressed && table[CW_ANGLE_LIMIT_L] == 0 && table[CW_ANGLE_LIMIT_H] == 0);
+	// Deferred writes outside the shadow are sent at once
+	before = after;
+	data[0] = 10;
+	data[1] = 0;
+	hosttest_check("shadow: deferred write outside the shadow is sent", motor_shadow_set(1, CW_ANGLE_LIMIT_L, data, 2)
+		== COMM_RXSUCCESS && table[CW_ANGLE_LIMIT_L] == 10);
+	motor_get_write_stats(&after);
+	hosttest_check("shadow: deferred write is not suppressed", after.sent - before.sent == 1
+		&& after.suppressed == before.suppressed);
+	motor_write_word(1, CW_ANGLE_LIMIT_L, 0);
+}
+
+/// Test of the trajectory streamer.
+static void hosttest_stream(void)
+{
+	uint8_t ids[2] = {1, 2};
+	unsigned char * table = dxl_hal_host_get_table(1);
+	uint16_t time, position;
+	motor_set_mode(MOTOR_BROADCAST_ID, MOTOR_JOINT_MODE);
+	hosttest_check("stream: start", motor_stream_start(2, ids, 20) == 1);
+	hosttest_check("stream: invalid index is rejected", motor_stream_push(200, 0, 512) == 0
+		&& motor_stream_free(200) == 0);
+	time = motor_stream_time();
+	motor_stream_push(0, time, 512);
+	motor_stream_push(1, time, 512);
+	motor_stream_push(0, time + 500, 700);
+	motor_stream_push(1, time + 500, 300);
+	hosttest_run(250);
+	position = table[GOAL_POSITION_L] | (table[GOAL_POSITION_H] << 8);
+	hosttest_check("stream: goal is interpolated", position > 560 && position < 660);
+	hosttest_run(500);
+	position = table[GOAL_POSITION_L] | (table[GOAL_POSITION_H] << 8);
+	hosttest_check("stream: last keyframe is reached", position == 700);
+	motor_stream_stop();
+}
+
+/// Test of the odometry of two wheels driving straight.
+static void hosttest_odometry(void)
+{
+	motor_pose pose;
+	// Travel of 1 s at speed 50 (511 units) of a wheel of 52 mm
+	double expected = 511 * MOTOR_RPM_PER_SPEED_UNIT * M_PI * 52 / 60.0;
+	motor_set_mode(MOTOR_BROADCAST_ID, MOTOR_WHEEL_MODE);
+	hosttest_check("odometry: start", motor_odometry_start(1, 2, 52, 120, 20) == 1);
+	motor_set_speed_dir(1, 50, MOTOR_CCW);
+	motor_set_speed_dir(2, 50, MOTOR_CW);
+	hosttest_run(1000);
+	motor_odometry_get(&pose);
+	hosttest_check("odometry: straight travel", fabs(pose.x / 1000.0 - expected) < expected * 0.02
+		&& abs((int)pose.y) < 1000 && pose.failures == 0);
+	motor_set_speed_dir(1, 0, MOTOR_CCW);
+	motor_set_speed_dir(2, 0, MOTOR_CW);
+	motor_odometry_stop();
+	motor_set_mode(MOTOR_BROADCAST_ID, MOTOR_JOINT_MODE);
+}
+
+/// Test of the load monitor.
+static void hosttest_load_monitor(void)
+{
+	uint8_t ids[2] = {1, 2};
+	hosttest_set_load(1, 100);
+	hosttest_set_load(2, -100);
+	hosttest_check("load: start", motor_load_start(2, ids, 10, 600, 200, &hosttest_load) == 1);
+	hosttest_run(200);
+	hosttest_check("load: no event at constant load", hosttest_load_events == 0 && motor_load_event(0) == 0);
+	hosttest_set_load(2, -450);
+	hosttest_run(50);
+	hosttest_check("load: collision is detected", (hosttest_load_events & MOTOR_LOAD_EVENT_COLLISION) != 0
+		&& (motor_load_event(1) & MOTOR_LOAD_EVENT_COLLISION) != 0);
+	hosttest_set_load(1, 700);
+	hosttest_run(50);
+	hosttest_check("load: stall is detected", (motor_load_event(0) & MOTOR_LOAD_EVENT_STALL) != 0);
+	motor_load_stop();
+}
+
+/// Test of the error report over the tokenized logging.
+static void hosttest_report(void)
+{
+	uint16_t position;
+	frame_decoder_init(&hosttest_log);
+	log_init(&hosttest_log_write);
+	motor_reset_errors();
+	dxl_hal_host_remove_device(2);
+	motor_read_word(2, PRESENT_POSITION_L, &position);
+	hosttest_check("report: errors are logged", motor_report_errors(0) == 1
+		&& hosttest_log_id == LOG_MOTOR_ERROR_RXTIMEOUT && hosttest_log_argument[0] == 2 && hosttest_log_argument[1] >= 1);
+	hosttest_log_id = -1;
+	hosttest_check("report: nothing new, nothing logged", motor_report_errors(0) == 0 && hosttest_log_id == -1);
+	dxl_hal_host_add_device(2);
+	log_init(NULL);
+}
+
+int main(void)
+{
+	dxl_hal_host_add_device(1);
+	dxl_hal_host_add_device(2);
+	dxl_initialize(0, 1);
+	motor_init();
+
+	hosttest_shadow();
+	hosttest_stream();
+	hosttest_odometry();
+	hosttest_load_monitor();
+	hosttest_report();
+
+	printf("%d checks failed\n", hosttest_failures);
+	return hosttest_failures == 0 ? 0 : 1;
+}
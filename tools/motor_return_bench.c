@@ -0,0 +1,108 @@
+/*! \file motor_return_bench.c
+    \brief Benchmark of the status return level and return delay on a Linux host with the virtual motor bus.
+	\author Team Kick-Ass
+	\copyright GNU Public License V3
+	\date 2012
+
+	\file motor_return_bench.c
+	\details This program measures the bus throughput of one simulated motor on the virtual bus of dxl_hal_host.h
+	(1 Mbps) for the combinations of the status return level (_motor_set_status_return_level()_) and the return delay
+	(_motor_set_return_delay()_). For each combination it sends 1000 goal position writes with alternating values
+	and 1000 reads of the present position and prints the transactions per second of the virtual time. The motor
+	starts with the AX-12 defaults, status return level 2 and a return delay of 500 us.
+
+	Build and run, e.g.:
+\code
+gcc -std=gnu99 -DF_CPU=16000000 -I tools/host -I include -I src src/dynamixel.c src/dxl_hal_host.c src/motor.c src/log.c src/frame.c tools/motor_return_bench.c -lm -o motor_return_bench
+./motor_return_bench
+\endcode
+ */
+
+#include <stdio.h>
+#include "motor.h"
+#include "timer.h"
+#include "dxl_hal.h"
+#include "dxl_hal_host.h"
+
+/// Number of writes and of reads per combination.
+#define BENCH_TRANSACTIONS	1000
+/// Id of the simulated motor.
+#define BENCH_ID			1
+
+/// Number of failed transactions.
+static int bench_failures = 0;
+
+/// Timer replacement, the background tasks of the motor layer are not used.
+int timer_set_interrupt(const uint8_t timer, const timer_interrupt_types type, const timer_callback callback)
+{
+	(void)timer;
+	(void)type;
+	(void)callback;
+	return 0;
+}
+
+/// Timer replacement, the value is not needed.
+int timer_set_value(const uint8_t timer, const timer_value_type type, const uint16_t value)
+{
+	(void)timer;
+	(void)type;
+	(void)value;
+	return 0;
+}
+
+/// Timer replacement, the background tasks of the motor layer are not used.
+int timer_init(const uint8_t timer, const timer_operation_mode mode, const timer_prescaler prescaler, const uint16_t value)
+{
+	(void)timer;
+	(void)mode;
+	(void)prescaler;
+	(void)value;
+	return 0;
+}
+
+/// Function to measure the writes and reads per second with the current configuration of the motor.
+static void bench_run(const uint8_t level, const uint16_t delay_us)
+{
+	uint32_t start, write_us, read_us;
+	uint16_t position;
+	int i;
+
+	start = dxl_hal_get_time();
+	for (i = 0; i < BENCH_TRANSACTIONS; i++)
+		if (motor_write_word(BENCH_ID, GOAL_POSITION_L, 300 + (i & 1)) != COMM_RXSUCCESS)
+			bench_failures++;
+	write_us = dxl_hal_get_time() - start;
+
+	start = dxl_hal_get_time();
+	for (i = 0; i < BENCH_TRANSACTIONS; i++)
+		if (motor_read_word(BENCH_ID, PRESENT_POSITION_L, &position) != COMM_RXSUCCESS)
+			bench_failures++;
+	read_us = dxl_hal_get_time() - start;
+
+	printf("level %u, delay %3u us: writes %5.0f/s, reads %5.0f/s\n", level, delay_us,
+		BENCH_TRANSACTIONS * 1e6 / write_us, BENCH_TRANSACTIONS * 1e6 / read_us);
+}
+
+/// Function to configure the motor and measure.
+static void bench_configure(const uint8_t level, const uint16_t delay_us)
+{
+	if (motor_set_status_return_level(BENCH_ID, level) != COMM_RXSUCCESS
+		|| motor_set_return_delay(BENCH_ID, delay_us) != COMM_RXSUCCESS)
+		bench_failures++;
+	bench_run(level, delay_us);
+}
+
+int main(void)
+{
+	dxl_hal_host_add_device(BENCH_ID);
+	dxl_initialize(0, 1);
+
+	bench_run(STATUS_RETURN_ALL, 500);
+	bench_configure(STATUS_RETURN_READ, 500);
+	bench_configure(STATUS_RETURN_READ, 0);
+	bench_configure(STATUS_RETURN_ALL, 0);
+
+	if (bench_failures != 0)
+		printf("%d transactions failed\n", bench_failures);
+	return bench_failures == 0 ? 0 : 1;
+}
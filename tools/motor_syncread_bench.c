@@ -0,0 +1,111 @@
+/*! \file motor_syncread_bench.c
+    \brief Benchmark of the batched reads of motor groups on a Linux host with the virtual motor bus.
+	\author Team Kick-Ass
+	\copyright GNU Public License V3
+	\date 2012
+
+	\file motor_syncread_bench.c
+	\details This program reads the present position of six simulated motors (the legs of the Squid) on the virtual
+	bus of dxl_hal_host.h and prints the reads per second of the virtual time for three variants:
+	- the former per-motor loop, one _motor_get_position()_ per motor followed by a sleep of 5 ms,
+	- the per-motor loop without the sleep,
+	- _motor_sync_read()_ for the whole group.
+
+	The virtual bus runs at 1 Mbps and the simulated motors answer after the AX-12 default return delay of 500 us.
+	The AVR headers used by the motor layer are replaced by those in tools/host.
+
+	Build and run, e.g.:
+\code
+gcc -std=gnu99 -DF_CPU=16000000 -I tools/host -I include -I src src/dynamixel.c src/dxl_hal_host.c src/motor.c src/log.c src/frame.c tools/motor_syncread_bench.c -lm -o motor_syncread_bench
+./motor_syncread_bench
+\endcode
+ */
+
+#include <stdio.h>
+#include <util/delay.h>
+#include "motor.h"
+#include "timer.h"
+#include "dxl_hal.h"
+#include "dxl_hal_host.h"
+
+/// Number of passes over the group per variant.
+#define BENCH_PASSES		100
+/// Sleep after each read of the former per-motor loop in ms.
+#define BENCH_COMMAND_DELAY	5
+
+/// Ids of the motors, in the order of the Squid.
+static const uint8_t bench_ids[] = {6, 1, 3, 8, 2, 5};
+/// Number of motors.
+#define BENCH_MOTORS		(sizeof(bench_ids) / sizeof(bench_ids[0]))
+
+/// Timer replacement, the background tasks of the motor layer are not used.
+int timer_set_interrupt(const uint8_t timer, const timer_interrupt_types type, const timer_callback callback)
+{
+	(void)timer;
+	(void)type;
+	(void)callback;
+	return 0;
+}
+
+/// Timer replacement, the value is not needed.
+int timer_set_value(const uint8_t timer, const timer_value_type type, const uint16_t value)
+{
+	(void)timer;
+	(void)type;
+	(void)value;
+	return 0;
+}
+
+/// Timer replacement, the background tasks of the motor layer are not used.
+int timer_init(const uint8_t timer, const timer_operation_mode mode, const timer_prescaler prescaler, const uint16_t value)
+{
+	(void)timer;
+	(void)mode;
+	(void)prescaler;
+	(void)value;
+	return 0;
+}
+
+/// Function to print the reads per second of a variant which took _time_us_ us.
+static void bench_print(const char * name, const uint32_t time_us)
+{
+	printf("%-32s %8.0f reads/s\n", name, BENCH_PASSES * BENCH_MOTORS * 1e6 / time_us);
+}
+
+int main(void)
+{
+	uint8_t data[2 * BENCH_MOTORS];
+	uint32_t start;
+	int pass, failures = 0;
+	unsigned int i;
+
+	for (i = 0; i < BENCH_MOTORS; i++)
+		dxl_hal_host_add_device(bench_ids[i]);
+	dxl_initialize(0, 1);
+
+	start = dxl_hal_get_time();
+	for (pass = 0; pass < BENCH_PASSES; pass++)
+		for (i = 0; i < BENCH_MOTORS; i++)
+		{
+			if (motor_get_position(bench_ids[i]) == (uint16_t)MOTOR_READ_ERROR)
+				failures++;
+			_delay_ms(BENCH_COMMAND_DELAY);
+		}
+	bench_print("per-motor loop with 5 ms sleep", dxl_hal_get_time() - start);
+
+	start = dxl_hal_get_time();
+	for (pass = 0; pass < BENCH_PASSES; pass++)
+		for (i = 0; i < BENCH_MOTORS; i++)
+			if (motor_get_position(bench_ids[i]) == (uint16_t)MOTOR_READ_ERROR)
+				failures++;
+	bench_print("per-motor loop without sleep", dxl_hal_get_time() - start);
+
+	start = dxl_hal_get_time();
+	for (pass = 0; pass < BENCH_PASSES; pass++)
+		failures += BENCH_MOTORS - motor_sync_read(BENCH_MOTORS, bench_ids, PRESENT_POSITION_L, 2, data);
+	bench_print("motor_sync_read", dxl_hal_get_time() - start);
+
+	if (failures != 0)
+		printf("%d reads failed\n", failures);
+	return failures == 0 ? 0 : 1;
+}
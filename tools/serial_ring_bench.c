@@ -0,0 +1,170 @@
+/*! \file serial_ring_bench.c
+    \brief Benchmark of the receive ring of the serial connection on a Linux host.
+	\author Team Kick-Ass
+	\copyright GNU Public License V3
+	\date 2012
+
+	\file serial_ring_bench.c
+	\details This program compares the receive ring of serial_ring.h with the former receive queue of serial.c, a
+	copy of which is kept below. Both receive bursts of 48 bytes, which are then read at once by the consumer, as
+	_serial_read()_ does. The time per byte (put and read) is printed for both. The functions of the former queue are
+	kept out of line, as they were called by the receive interrupt.
+
+	Afterwards the ring is checked: bursts of varying length are put and read with varying buffer sizes across the
+	wrap-around, every byte has to arrive in order. A full ring has to count the discarded bytes.
+
+	The times are those of the host CPU, not of the ATmega2561. The program returns 0 if the checks passed.
+
+	Build and run, e.g.:
+\code
+gcc -std=gnu99 -O2 -I src tools/serial_ring_bench.c -o serial_ring_bench
+./serial_ring_bench
+\endcode
+ */
+
+#include <stdio.h>
+#include <time.h>
+#include "serial_ring.h"
+
+/// Number of bytes per measurement.
+#define BENCH_BYTES			20000000
+/// Number of bytes received between two reads.
+#define BENCH_BURST			48
+
+/// \cond Former receive queue of serial.c.
+#define MAXNUM_SERIALBUFF	128
+
+volatile unsigned char gbSerialBuffer[MAXNUM_SERIALBUFF] = {0};
+volatile unsigned char gbSerialBufferHead = 0;
+volatile unsigned char gbSerialBufferTail = 0;
+
+__attribute__((noinline)) int serial_get_qstate(void)
+{
+	short NumByte;
+
+	if( gbSerialBufferHead == gbSerialBufferTail )
+		NumByte = 0;
+	else if( gbSerialBufferHead < gbSerialBufferTail )
+		NumByte = gbSerialBufferTail - gbSerialBufferHead;
+	else
+		NumByte = MAXNUM_SERIALBUFF - (gbSerialBufferHead - gbSerialBufferTail);
+
+	return (int)NumByte;
+}
+
+__attribute__((noinline)) void serial_put_queue( unsigned char data )
+{
+	if( serial_get_qstate() == (MAXNUM_SERIALBUFF-1) )
+		return;
+
+	gbSerialBuffer[gbSerialBufferTail] = data;
+
+	if( gbSerialBufferTail == (MAXNUM_SERIALBUFF-1) )
+		gbSerialBufferTail = 0;
+	else
+		gbSerialBufferTail++;
+}
+
+__attribute__((noinline)) unsigned char serial_get_queue(void)
+{
+	unsigned char data;
+
+	if( gbSerialBufferHead == gbSerialBufferTail )
+		return 0xff;
+
+	data = gbSerialBuffer[gbSerialBufferHead];
+
+	if( gbSerialBufferHead == (MAXNUM_SERIALBUFF-1) )
+		gbSerialBufferHead = 0;
+	else
+		gbSerialBufferHead++;
+
+	return data;
+}
+
+unsigned char serial_read( unsigned char *pData, int numbyte )
+{
+	int count, numgetbyte;
+
+	if( gbSerialBufferHead == gbSerialBufferTail )
+		return 0;
+
+	numgetbyte = serial_get_qstate();
+	if( numgetbyte > numbyte )
+		numgetbyte = numbyte;
+
+	for( count=0; count<numgetbyte; count++ )
+		pData[count] = serial_get_queue();
+
+	return numgetbyte;
+}
+/// \endcond
+
+/// Ring under test.
+static serial_ring bench_ring;
+/// Sum of the bytes read, keeps the compiler from dropping the reads.
+volatile unsigned int bench_sink;
+
+/// Function to get a monotonic time stamp in nanoseconds.
+static double bench_now(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+/// Function to check the order of the bytes across the wrap-around and the overflow counter, returns 1 if passed.
+static int bench_check(void)
+{
+	unsigned char data[64], written = 0, expected = 0;
+	int round, i, count, ok = 1;
+
+	serial_ring_init(&bench_ring);
+	for (round = 0; round < 1000; round++)
+	{
+		for (i = 0; i < round % 50; i++)
+			if (serial_ring_put(&bench_ring, written))
+				written++;
+		count = serial_ring_read(&bench_ring, data, round % 7 + 30);
+		for (i = 0; i < count; i++)
+			if (data[i] != expected++)
+				ok = 0;
+	}
+	// Overfill an empty ring, one byte always stays free
+	serial_ring_init(&bench_ring);
+	for (i = 0; i < SERIAL_RX_BUFFER_SIZE + 10; i++)
+		serial_ring_put(&bench_ring, (unsigned char)i);
+	return ok && serial_ring_count(&bench_ring) == SERIAL_RX_BUFFER_SIZE - 1 && bench_ring.overflows == 11;
+}
+
+int main(void)
+{
+	unsigned char data[64];
+	unsigned int sum = 0;
+	double start;
+	int i, j, ok;
+
+	start = bench_now();
+	for (i = 0; i < BENCH_BYTES; i += BENCH_BURST)
+	{
+		for (j = 0; j < BENCH_BURST; j++)
+			serial_put_queue((unsigned char)j);
+		sum += serial_read(data, sizeof(data));
+	}
+	printf("former queue: %.1f ns/byte\n", (bench_now() - start) / BENCH_BYTES);
+
+	serial_ring_init(&bench_ring);
+	start = bench_now();
+	for (i = 0; i < BENCH_BYTES; i += BENCH_BURST)
+	{
+		for (j = 0; j < BENCH_BURST; j++)
+			serial_ring_put(&bench_ring, (unsigned char)j);
+		sum += serial_ring_read(&bench_ring, data, sizeof(data));
+	}
+	printf("ring:         %.1f ns/byte\n", (bench_now() - start) / BENCH_BYTES);
+	bench_sink = sum;
+
+	ok = bench_check();
+	printf("wrap-around and overflow check: %s\n", ok ? "ok" : "FAILED");
+	return ok ? 0 : 1;
+}
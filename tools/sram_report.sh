@@ -0,0 +1,83 @@
+#!/bin/sh
+# sram_report.sh - Static SRAM usage per module of an AVR build.
+#
+# Prints for each object file the bytes which are placed in SRAM: initialized data including const data which is not
+# declared PROGMEM (.data and .rodata, copied from flash at startup), zero-initialized data (.bss) and their sum, and
+# the constant data kept in flash (.progmem). The stack and the heap are not included. With -b the same modules of an
+# older build are listed next to them, e.g. to compare the builds before and after moving tables to flash.
+#
+# Usage, e.g. with the object files of the Atmel Studio projects:
+#   tools/sram_report.sh src/2-nonwheeled-rob/Debug/*.o
+#   tools/sram_report.sh -b old/Debug src/2-nonwheeled-rob/Debug/*.o
+#
+# The tool avr-size is taken from the path, another one is given by the variable AVR_SIZE.
+
+AVR_SIZE=${AVR_SIZE:-avr-size}
+BEFORE=
+
+usage() {
+	echo "Usage: $0 [-b before_directory] object..." >&2
+	exit 1
+}
+
+while getopts b: option; do
+	case $option in
+		b) BEFORE=$OPTARG ;;
+		*) usage ;;
+	esac
+done
+shift $((OPTIND - 1))
+[ $# -gt 0 ] || usage
+
+# Prints "data bss progmem" of an object file, "- - -" if it does not exist
+sections() {
+	if [ ! -f "$1" ]; then
+		echo "- - -"
+		return
+	fi
+	"$AVR_SIZE" -A "$1" | awk '
+		$1 ~ /^\.(data|rodata)/ { data += $2 }
+		$1 ~ /^\.bss/ { bss += $2 }
+		$1 ~ /^\.progmem/ { progmem += $2 }
+		END { printf "%d %d %d\n", data, bss, progmem }'
+}
+
+if [ -z "$BEFORE" ]; then
+	printf "%-24s %8s %8s %8s %8s\n" "Module" ".data" ".bss" "SRAM" "PROGMEM"
+else
+	printf "%-24s %8s %8s %8s %8s %8s\n" "Module" "SRAM" "PROGMEM" "SRAM" "PROGMEM" "Saved"
+	printf "%-24s %17s %17s\n" "" "(before)" "(after)"
+fi
+for object in "$@"; do
+	set -- $(sections "$object")
+	data=$1 bss=$2 progmem=$3
+	name=$(basename "$object")
+	if [ -z "$BEFORE" ]; then
+		echo "$name $data $bss $progmem"
+	else
+		echo "$name $data $bss $progmem $(sections "$BEFORE/$name")"
+	fi
+done | awk -v compare="$BEFORE" '
+	{
+		sram = $2 + $3
+		total += sram
+		flash += $4
+		if (compare == "") {
+			printf "%-24s %8d %8d %8d %8d\n", $1, $2, $3, sram, $4
+			next
+		}
+		if ($5 == "-") {
+			printf "%-24s %8s %8s %8d %8d %8s\n", $1, "-", "-", sram, $4, "-"
+			next
+		}
+		old = $5 + $6
+		total_old += old
+		flash_old += $7
+		printf "%-24s %8d %8d %8d %8d %8d\n", $1, old, $7, sram, $4, old - sram
+	}
+	END {
+		if (compare == "")
+			printf "%-24s %8s %8s %8d %8d\n", "Total", "", "", total, flash
+		else
+			printf "%-24s %8d %8d %8d %8d %8d\n", "Total", total_old, flash_old, total, flash, total_old - total
+	}'
@@ -0,0 +1,215 @@
+/*! \file telemetry_decode.c
+    \brief Decoder of the binary telemetry stream into CSV.
+	\author Team Kick-Ass
+	\copyright GNU Public License V3
+	\date 2012
+
+	\file telemetry_decode.c
+	\details This program reads the telemetry stream of a robot (see telemetry.h) from a serial device, a file or the
+	standard input and prints one CSV line per record. The layout of the records is given as a comma separated list
+	of _name:type_ pairs in the order the signals have been added by the firmware. The types are _u8_, _i8_, _u16_,
+	_i16_, _u32_, _i32_ and _f32_ (float, which is also the size of a double on the AVR). A signal of _n_ values of the
+	same type is given as _name:type*n_, its columns are named _name0_, _name1_, ...
+
+	The first two columns are the sequence number and the number of records lost right before the record. Frames
+	which are not telemetry records, e.g. replies, are skipped, text and corrupted frames are counted. A summary is
+	printed to the standard error at the end of the input (or on Ctrl-C).
+
+	Build and use, e.g.:
+\code
+gcc -I src -I tools src/frame.c tools/frame_client.c tools/telemetry_decode.c -o telemetry_decode
+./telemetry_decode -d /dev/ttyUSB0 -l time:u32,front:u16,left:u16,right:u16,setpoint:u16*6 > run.csv
+./telemetry_decode -l time:u32,front:u16 capture.bin
+\endcode
+ */
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "frame.h"
+#include "frame_client.h"
+
+/// Maximum number of columns of a record.
+#define TELEMETRY_DECODE_MAX_COLUMNS	64
+
+/// Column of a record.
+typedef struct {
+	/// Name of the column.
+	char name[32];
+	/// Type of the column, one of "u8", "i8", "u16", "i16", "u32", "i32" and "f32".
+	char type[4];
+	/// Size of the column in bytes.
+	uint8_t size;
+} decode_column;
+
+/// Columns of the records.
+static decode_column decode_columns[TELEMETRY_DECODE_MAX_COLUMNS];
+/// Number of columns.
+static int decode_count = 0;
+/// Number of bytes of a record without the sequence number.
+static int decode_length = 0;
+/// Set by Ctrl-C.
+static volatile sig_atomic_t decode_stop = 0;
+
+/// Signal handler of Ctrl-C.
+static void decode_interrupt(int signal)
+{
+	(void)signal;
+	decode_stop = 1;
+}
+
+/// Function to get the size of a type, 0 if it is unknown.
+static uint8_t decode_size(const char * type)
+{
+	if (strcmp(type, "u8") == 0 || strcmp(type, "i8") == 0)
+		return 1;
+	if (strcmp(type, "u16") == 0 || strcmp(type, "i16") == 0)
+		return 2;
+	if (strcmp(type, "u32") == 0 || strcmp(type, "i32") == 0 || strcmp(type, "f32") == 0)
+		return 4;
+	return 0;
+}
+
+/// Function to parse the layout, returns 0 in case of success.
+static int decode_parse(char * layout)
+{
+	char * entry, * type, * repeat;
+	uint8_t size;
+	int count, i;
+	for (entry = strtok(layout, ","); entry != NULL; entry = strtok(NULL, ","))
+	{
+		type = strchr(entry, ':');
+		if (type == NULL)
+			return -1;
+		*type++ = '\0';
+		repeat = strchr(type, '*');
+		count = 1;
+		if (repeat != NULL)
+		{
+			*repeat++ = '\0';
+			count = atoi(repeat);
+		}
+		size = decode_size(type);
+		if (size == 0 || count < 1 || decode_count + count > TELEMETRY_DECODE_MAX_COLUMNS || strlen(entry) > 24)
+			return -1;
+		for (i = 0; i < count; i++)
+		{
+			decode_column * column = &decode_columns[decode_count++];
+			if (repeat != NULL)
+				snprintf(column->name, sizeof(column->name), "%s%d", entry, i);
+			else
+				snprintf(column->name, sizeof(column->name), "%s", entry);
+			snprintf(column->type, sizeof(column->type), "%s", type);
+			column->size = size;
+			decode_length += size;
+		}
+	}
+	return decode_count > 0 && decode_length <= FRAME_MAX_PAYLOAD - 2 ? 0 : -1;
+}
+
+/// Function to print a record, the data starts after the sequence number.
+static void decode_print(const uint16_t sequence, const uint16_t lost, const uint8_t * data)
+{
+	int i;
+	uint32_t raw;
+	float real;
+	printf("%u,%u", sequence, lost);
+	for (i = 0; i < decode_count; i++)
+	{
+		const decode_column * column = &decode_columns[i];
+		raw = 0;
+		// Little endian like the AVR
+		for (int j = column->size - 1; j >= 0; j--)
+			raw = (raw << 8) | data[j];
+		if (strcmp(column->type, "f32") == 0)
+		{
+			memcpy(&real, &raw, sizeof(real));
+			printf(",%g", real);
+		}
+		else if (column->type[0] == 'i')
+			printf(",%ld", column->size == 1 ? (long)(int8_t)raw : column->size == 2 ? (long)(int16_t)raw : (long)(int32_t)raw);
+		else
+			printf(",%lu", (unsigned long)raw);
+		data += column->size;
+	}
+	printf("\n");
+}
+
+int main(int argc, char * argv[])
+{
+	const char * device = NULL;
+	char * layout = NULL;
+	long baudrate = 57600;
+	int option, fd = STDIN_FILENO, count, i;
+	uint8_t buffer[256], length;
+	uint16_t sequence, expected = 0;
+	unsigned long records = 0, lost = 0, skipped = 0, gap;
+	int started = 0;
+	frame_decoder decoder;
+	frame_client client;
+
+	while ((option = getopt(argc, argv, "d:b:l:")) != -1)
+	{
+		switch (option)
+		{
+			case 'd': device = optarg; break;
+			case 'b': baudrate = atol(optarg); break;
+			case 'l': layout = optarg; break;
+			default: goto usage;
+		}
+	}
+	if (layout == NULL || decode_parse(layout) != 0)
+		goto usage;
+	if (device != NULL)
+	{
+		// The client only configures the serial device
+		if (frame_client_open(&client, device, baudrate) != 0)
+		{
+			perror(device);
+			return 1;
+		}
+		fd = client.fd;
+	}
+	else if (optind < argc && freopen(argv[optind], "rb", stdin) == NULL)
+	{
+		perror(argv[optind]);
+		return 1;
+	}
+	signal(SIGINT, &decode_interrupt);
+
+	printf("sequence,lost");
+	for (i = 0; i < decode_count; i++)
+		printf(",%s", decode_columns[i].name);
+	printf("\n");
+	frame_decoder_init(&decoder);
+	while (!decode_stop && (count = read(fd, buffer, sizeof(buffer))) > 0)
+	{
+		for (i = 0; i < count; i++)
+		{
+			length = frame_decoder_put(&decoder, buffer[i]);
+			if (length == 0)
+				continue;
+			if (decoder.data[1] != (FRAME_COMMAND_TELEMETRY | FRAME_REPLY) || length != decode_length + 4)
+			{
+				skipped++;
+				continue;
+			}
+			sequence = decoder.data[2] | (decoder.data[3] << 8);
+			gap = started ? (uint16_t)(sequence - expected) : 0;
+			started = 1;
+			expected = sequence + 1;
+			records++;
+			lost += gap;
+			decode_print(sequence, (uint16_t)gap, &decoder.data[4]);
+		}
+		fflush(stdout);
+	}
+	fprintf(stderr, "Records %lu, lost %lu, other frames %lu, invalid frames %u\n", records, lost, skipped, decoder.errors);
+	return 0;
+
+usage:
+	fprintf(stderr, "Usage: %s [-d device] [-b baudrate] -l name:type[*count],... [file]\n", argv[0]);
+	return 1;
+}